@@ -0,0 +1,91 @@
+// Copyright (c) 2015 The Bitcoin developers
+// Copyright (c) 2017-2019 The WaykiChain Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef COIN_MEMUSAGE_H
+#define COIN_MEMUSAGE_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * Estimates of the heap memory held by objects and containers, as the glibc allocator would
+ * hand it out, to budget memory by what the process actually uses rather than by serialized sizes.
+ */
+namespace memusage {
+
+// Compute the total memory used by allocating alloc bytes.
+static inline size_t MallocUsage(size_t alloc) {
+    // Measured on libc6 2.19 on Linux.
+    if (alloc == 0) {
+        return 0;
+    } else if (sizeof(void *) == 8) {
+        return ((alloc + 31) >> 4) << 4;
+    } else if (sizeof(void *) == 4) {
+        return ((alloc + 15) >> 3) << 3;
+    } else {
+        assert(0);
+    }
+}
+
+// Nodes of the red-black trees of std::set and std::map
+struct stl_tree_node {
+private:
+    int color;
+    void *parent;
+    void *left;
+    void *right;
+};
+
+// Control block of a std::shared_ptr made by std::make_shared
+struct stl_shared_counter {
+    size_t use_count;
+    size_t weak_count;
+};
+
+template <typename X>
+static inline size_t DynamicUsage(const std::vector<X> &v) {
+    return MallocUsage(v.capacity() * sizeof(X));
+}
+
+// the usage of the std::string small buffer is part of the enclosing object
+static inline size_t DynamicUsage(const std::string &s) {
+    return s.capacity() > 15 ? MallocUsage(s.capacity() + 1) : 0;
+}
+
+template <typename X, typename Y>
+static inline size_t DynamicUsage(const std::set<X, Y> &s) {
+    return MallocUsage(sizeof(stl_tree_node) + sizeof(X)) * s.size();
+}
+
+template <typename X, typename Y>
+static inline size_t IncrementalDynamicUsage(const std::set<X, Y> &s) {
+    return MallocUsage(sizeof(stl_tree_node) + sizeof(X));
+}
+
+template <typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const std::map<X, Y, Z> &m) {
+    return MallocUsage(sizeof(stl_tree_node) + sizeof(std::pair<const X, Y>)) * m.size();
+}
+
+template <typename X, typename Y, typename Z>
+static inline size_t IncrementalDynamicUsage(const std::map<X, Y, Z> &m) {
+    return MallocUsage(sizeof(stl_tree_node) + sizeof(std::pair<const X, Y>));
+}
+
+template <typename X>
+static inline size_t DynamicUsage(const std::shared_ptr<X> &p) {
+    return p ? MallocUsage(sizeof(X)) + MallocUsage(sizeof(stl_shared_counter)) : 0;
+}
+
+}  // namespace memusage
+
+#endif  // COIN_MEMUSAGE_H
@@ -778,6 +778,25 @@ int RaiseFileDescriptorLimit(int nMinFD) {
 #endif
 }
 
+// returns the amount of physical memory in bytes, or 0 if it can't be determined
+int64_t GetTotalPhysicalMemory() {
+#if defined(WIN32)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status))
+        return status.ullTotalPhys;
+    return 0;
+#elif defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+    long nPages    = sysconf(_SC_PHYS_PAGES);
+    long nPageSize = sysconf(_SC_PAGESIZE);
+    if (nPages <= 0 || nPageSize <= 0)
+        return 0;
+    return (int64_t)nPages * nPageSize;
+#else
+    return 0;
+#endif
+}
+
 // this function tries to make a particular range of a file allocated (corresponding to disk space)
 // it is advisory, and the range specified in the arguments will never contain live data
 void AllocateFileRange(FILE* file, unsigned int offset, unsigned int length) {
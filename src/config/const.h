@@ -97,6 +97,12 @@ static const int64_t MIN_FUEL_RATES           = 1;    // 1 unit / 100 step
 
 /** Fees smaller than this (in sawi) are considered zero fee (for relaying and mining) */
 static const uint64_t MIN_RELAY_TX_FEE = 1000;
+/** Default for -maxmempool, the memory budget of the mempool in megabytes */
+static const uint32_t DEFAULT_MAX_MEMPOOL_SIZE = 300;
+/** Fee per KB (in sawi) added on top of the fee rate of the txs evicted from a full mempool */
+static const uint64_t INCREMENTAL_RELAY_FEE_PER_KB = 1000;
+/** Half-life (in seconds) of the rolling minimum fee rate of a full mempool */
+static const int64_t ROLLING_FEE_HALFLIFE = 60 * 60 * 12;
 /** Amount smaller than this (in sawi) is considered dust amount */
 static const uint64_t DUST_AMOUNT_THRESHOLD = 10000;
 
@@ -113,6 +119,48 @@ static const uint32_t MAX_ORPHAN_BLOCKS = 750;
 static const int32_t MAX_BLOCKS_IN_TRANSIT_PER_PEER = 128;
 /** Timeout in seconds before considering a block download peer unresponsive. */
 static const uint32_t BLOCK_DOWNLOAD_TIMEOUT  = 60;
+/** Number of blocks a peer is asked for at a time at first, raised by each block it delivers */
+static const int32_t INITIAL_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** The number of blocks in transit a peer stalling the block download is cut down to at least */
+static const int32_t MIN_BLOCKS_IN_TRANSIT_PER_PEER = 2;
+/** Seconds the block above the tip may stay in flight before it's asked for from another peer */
+static const int64_t BLOCK_STALLING_TIMEOUT = 5;
+/** Blocks above the tip downloaded at the same time in the headers-first sync, bounded by MAX_ORPHAN_BLOCKS
+ * as the blocks arriving ahead of their parents are kept as orphans */
+static const int32_t BLOCK_DOWNLOAD_WINDOW = 512;
+/** The maximum number of headers in a "headers" message */
+static const uint32_t MAX_HEADERS_RESULTS = 2000;
+/** Number of validated headers kept ahead of the tip, more are asked for below it */
+static const uint32_t MAX_HEADERS_AHEAD = 20000;
+/** -headerssync default (fetch and validate the headers before downloading the blocks in the initial sync) */
+static const bool DEFAULT_HEADERS_SYNC = true;
+
+/** Maximum number of signature-checking threads allowed */
+static const int32_t MAX_SIGCHECK_THREADS = 16;
+/** -par default (number of signature-checking threads, 0 = auto) */
+static const int32_t DEFAULT_SIGCHECK_THREADS = 0;
+/** Maximum number of threads executing txs ahead of their turn in block production */
+static const int32_t MAX_PACK_THREADS = 16;
+/** -packthreads default (number of threads executing txs in block production, 0 = auto) */
+static const int32_t DEFAULT_PACK_THREADS = 0;
+/** -blocktemplate default (keep the next block of this node packed ahead of its slot) */
+static const bool DEFAULT_BLOCK_TEMPLATE = true;
+/** Interval in milliseconds the block template packs the new mempool txs at */
+static const int64_t BLOCK_TEMPLATE_REFRESH_INTERVAL_MS = 250;
+/** Maximum number of message handler threads */
+static const int32_t MAX_MSGHAND_THREADS = 16;
+/** -msghandthreads default (number of threads processing peer messages, each peer is served by one of them) */
+static const int32_t DEFAULT_MSGHAND_THREADS = 4;
+/** Byte budget of the recently served blocks kept ready to be sent */
+static const size_t RAW_BLOCK_CACHE_SIZE = 32 * 1024 * 1024;
+/** -compactblocks default (relay blocks to the peers supporting it as compact blocks) */
+static const bool DEFAULT_COMPACT_BLOCKS = true;
+/** Blocks deeper than this below the tip are served in full when asked for as compact blocks */
+static const int32_t MAX_CMPCTBLOCK_DEPTH = 10;
+/** -sigcachemaxmb default (memory budget of the signature cache in MiB) */
+static const int64_t DEFAULT_MAX_SIG_CACHE_SIZE = 32;
+/** Maximum memory budget of the signature cache in MiB */
+static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
 
 /** Minimum disk space required */
 static const uint64_t MIN_DISK_SPACE = 52428800;
@@ -128,6 +176,22 @@ static const int64_t DEFAULT_DB_CACHE = 100;
 static const int64_t MAX_DB_CACHE = sizeof(void *) > 4 ? 4096 : 1024;
 /** min. -dbcache in (MiB) */
 static const int64_t MIN_DB_CACHE = 4;
+/** min. cache of a single state db (MiB) */
+static const int64_t MIN_DB_CACHE_PER_DB = 1;
+/** -dbbloombits default (bits per key of the LevelDB bloom filters, 0 = off) */
+static const int64_t DEFAULT_DB_BLOOM_BITS = 10;
+/** -dbcompression default (snappy compression of LevelDB blocks) */
+static const int64_t DEFAULT_DB_COMPRESSION = 0;
+/** -dbmaxopenfiles default (open files per LevelDB) */
+static const int64_t DEFAULT_DB_MAX_OPEN_FILES = 64;
+/** min. -dbmaxopenfiles */
+static const int64_t MIN_DB_MAX_OPEN_FILES = 16;
+/** -statecache default (MiB of clean chain state kept in memory across flushes) */
+static const int64_t DEFAULT_STATE_CACHE = 64;
+/** max. -statecache (MiB) */
+static const int64_t MAX_STATE_CACHE = sizeof(void *) > 4 ? 4096 : 512;
+/** clean chain state kept for a single state db (MiB), also the min. share of -statecache */
+static const int64_t DEFAULT_STATE_CACHE_PER_DB = 1;
 
 /** Coinbase transaction outputs can only be spent after this number of new blocks (network rule) */
 static const int32_t BLOCK_REWARD_MATURITY = 100;
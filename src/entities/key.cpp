@@ -209,6 +209,72 @@ bool CPubKey::Verify(const uint256 &hash, const vector<uint8_t> &vchSig) const {
     return secp256k1_ecdsa_verify(secp256k1_context_verify, &sig, hash.begin(), &pubkey);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// class CSignatureBatch
+
+size_t CSignatureBatch::Add(const uint256 &hash, const vector<uint8_t> &signature, const CPubKey &pubKey) {
+    items.push_back({hash, signature, pubKey, PENDING});
+    return items.size() - 1;
+}
+
+bool CSignatureBatch::Verify() {
+    // parsed public keys and verified items shared by the whole batch
+    map<CPubKey, std::pair<bool, secp256k1_pubkey>> parsedPubKeys;
+    map<std::tuple<uint256, vector<uint8_t>, CPubKey>, ItemStatus> verified;
+
+    bool fAllValid = true;
+    for (auto &item : items) {
+        if (item.status == PENDING) {
+            auto key   = std::make_tuple(item.hash, item.signature, item.pubKey);
+            auto itDup = verified.find(key);
+            if (itDup != verified.end()) {
+                item.status = itDup->second;
+            } else {
+                auto itKey = parsedPubKeys.find(item.pubKey);
+                if (itKey == parsedPubKeys.end()) {
+                    secp256k1_pubkey pubkey;
+                    bool fParsed = item.pubKey.IsValid() &&
+                                   secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, item.pubKey.begin(),
+                                                             item.pubKey.size());
+                    itKey = parsedPubKeys.emplace(item.pubKey, std::make_pair(fParsed, pubkey)).first;
+                }
+
+                secp256k1_ecdsa_signature sig;
+                bool fValid = itKey->second.first &&
+                              ecdsa_signature_parse_der_lax(secp256k1_context_verify, &sig, item.signature.data(),
+                                                            item.signature.size());
+                if (fValid) {
+                    // same lower-S normalization as CPubKey::Verify()
+                    secp256k1_ecdsa_signature_normalize(secp256k1_context_verify, &sig, &sig);
+                    fValid = secp256k1_ecdsa_verify(secp256k1_context_verify, &sig, item.hash.begin(),
+                                                    &itKey->second.second);
+                }
+
+                item.status = fValid ? VALID : INVALID;
+                verified.emplace(std::move(key), item.status);
+            }
+        }
+
+        fAllValid &= (item.status == VALID);
+    }
+
+    return fAllValid;
+}
+
+void CSignatureBatch::Split(size_t n, vector<CSignatureBatch> &batches) {
+    if (n == 0 || items.empty())
+        return;
+
+    size_t nPerBatch = (items.size() + n - 1) / n;
+    for (size_t begin = 0; begin < items.size(); begin += nPerBatch) {
+        size_t end = std::min(begin + nPerBatch, items.size());
+        batches.emplace_back();
+        batches.back().items.assign(std::make_move_iterator(items.begin() + begin),
+                                    std::make_move_iterator(items.begin() + end));
+    }
+    items.clear();
+}
+
 bool CPubKey::RecoverCompact(const uint256 &hash, const vector<uint8_t> &vchSig) {
     if (vchSig.size() != COMPACT_SIGNATURE_SIZE) return false;
 
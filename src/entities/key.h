@@ -216,6 +216,45 @@ public:
     bool Derive(CPubKey &pubkeyChild, uint8_t ccChild[32], uint32_t nChild, const uint8_t cc[32]) const;
 };
 
+/** A batch of (hash, signature, public key) items to be verified together.
+ *
+ *  libsecp256k1 has no ECDSA batch equation, so the batch amortizes what can be shared: one verify
+ *  context with its precomputed tables, each distinct public key parsed only once, and duplicated
+ *  items verified only once. Results are reported per item.
+ */
+class CSignatureBatch {
+public:
+    enum ItemStatus : uint8_t { PENDING = 0, VALID = 1, INVALID = 2 };
+
+    struct Item {
+        uint256 hash;
+        vector<uint8_t> signature;
+        CPubKey pubKey;
+        ItemStatus status;
+    };
+
+private:
+    vector<Item> items;
+
+public:
+    // Queue an item, return its index in the batch.
+    size_t Add(const uint256 &hash, const vector<uint8_t> &signature, const CPubKey &pubKey);
+    // Mark an item as known valid (e.g. found in the signature cache), so Verify() skips it.
+    void SetValid(size_t index) { items[index].status = VALID; }
+    // Verify all pending items, return true if every item of the batch is valid.
+    bool Verify();
+    // Move the items out into (at most) n batches of contiguous items.
+    void Split(size_t n, vector<CSignatureBatch> &batches);
+
+    bool IsValid(size_t index) const { return items[index].status == VALID; }
+    const Item &operator[](size_t index) const { return items[index]; }
+    size_t size() const { return items.size(); }
+    bool empty() const { return items.empty(); }
+    void reserve(size_t n) { items.reserve(n); }
+    void clear() { items.clear(); }
+    void swap(CSignatureBatch &other) { items.swap(other.items); }
+};
+
 // secure_allocator is defined in allocators.h
 // CPrivKey is a serialized private key, with all parameters included (279 bytes)
 typedef vector<uint8_t, secure_allocator<uint8_t> > CPrivKey;
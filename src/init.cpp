@@ -47,6 +47,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <thread>
 
 #ifndef WIN32
 #include <signal.h>
@@ -212,10 +213,19 @@ string HelpMessage() {
     strUsage += "  -daemon                " + _("Run in the background as a daemon and accept commands") + "\n";
 #endif
     strUsage += "  -datadir=<dir>         " + _("Specify data directory") + "\n";
-    strUsage += "  -dbcache=<n>           " + strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), MIN_DB_CACHE, MAX_DB_CACHE, DEFAULT_DB_CACHE) + "\n";
+    strUsage += "  -dbcache=<n>           " + strprintf(_("Set database cache size in megabytes (%d to %d, default: 1/32 of the physical memory, at least %d)"), MIN_DB_CACHE, MAX_DB_CACHE, DEFAULT_DB_CACHE) + "\n";
+    strUsage += "  -dbbloombits=<n>       " + strprintf(_("Bits per key of the database bloom filters, 0 to disable them (default: %d)"), DEFAULT_DB_BLOOM_BITS) + "\n";
+    strUsage += "  -dbcompression=<n>     " + strprintf(_("Compress database blocks with snappy (default: %d)"), DEFAULT_DB_COMPRESSION) + "\n";
+    strUsage += "  -dbmaxopenfiles=<n>    " + strprintf(_("Maximum number of open files per database (default: %d)"), DEFAULT_DB_MAX_OPEN_FILES) + "\n";
+    strUsage += "  -dbwritebuffer=<n>     " + _("Size of a database write buffer in megabytes (default: a quarter of its cache)") + "\n";
+    strUsage += "  -<db>.<option>=<n>     " + _("Override cache, bloombits, compression, maxopenfiles or writebuffer for the database <db> (e.g. -receipts.cache=64)") + "\n";
+    strUsage += "  -statecache=<n>        " + strprintf(_("Megabytes of clean chain state kept in memory across flushes (0 to %d, default: %d)"), MAX_STATE_CACHE, DEFAULT_STATE_CACHE) + "\n";
+    strUsage += "  -maxmempool=<n>        " + strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE) + "\n";
+    strUsage += "  -par=<n>               " + strprintf(_("Set the number of signature verification and block tx execution threads (%d to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), -(int32_t)std::thread::hardware_concurrency(), MAX_SIGCHECK_THREADS, DEFAULT_SIGCHECK_THREADS) + "\n";
     strUsage += "  -loadblock=<file>      " + _("Imports blocks from external blk000??.dat file") + " " + _("on startup") + "\n";
     strUsage += "  -pid=<file>            " + _("Specify pid file (default: coin.pid)") + "\n";
     strUsage += "  -reindex               " + _("Rebuild block chain index from current blk000??.dat files") + " " + _("on startup") + "\n";
+    strUsage += "  -unifieddb             " + _("Keep all the chain state in a single database instead of one database per kind of state (default: 0)") + "\n";
     strUsage += "  -txindex               " + _("Maintain a full transaction index (default: 0)") + "\n";
     strUsage += "  -logfailures           " + _("Log failures into level db in detail (default: 0)") + "\n";
     strUsage += "  -genreceipt               " + _("Whether generate receipt(default: 0)") + "\n";
@@ -225,16 +235,19 @@ string HelpMessage() {
     strUsage += "  -banscore=<n>          " + _("Threshold for disconnecting misbehaving peers (default: 100)") + "\n";
     strUsage += "  -bantime=<n>           " + _("Number of seconds to keep misbehaving peers from reconnecting (default: 86400)") + "\n";
     strUsage += "  -bind=<addr>           " + _("Bind to given address and always listen on it. Use [host]:port notation for IPv6") + "\n";
+    strUsage += "  -compactblocks         " + strprintf(_("Relay new blocks as header and short transaction ids, rebuilt from the memory pool (default: %u)"), DEFAULT_COMPACT_BLOCKS) + "\n";
     strUsage += "  -connect=<ip>          " + _("Connect only to the specified node(s)") + "\n";
     strUsage += "  -discover              " + _("Discover own IP address (default: 1 when listening and no -externalip)") + "\n";
     strUsage += "  -dns                   " + _("Allow DNS lookups for -addnode, -seednode and -connect") + " " + _("(default: 1)") + "\n";
     strUsage += "  -dnsseed               " + _("Query for peer addresses via DNS lookup, if low on addresses (default: 1 unless -connect)") + "\n";
     strUsage += "  -forcednsseed          " + _("Always query for peer addresses via DNS lookup (default: 0)") + "\n";
     strUsage += "  -externalip=<ip>       " + _("Specify your own public address") + "\n";
+    strUsage += "  -headerssync           " + strprintf(_("Fetch and validate the block headers first in the initial sync, then download the blocks from many peers at once (default: %u)"), DEFAULT_HEADERS_SYNC) + "\n";
     strUsage += "  -listen                " + _("Accept connections from outside (default: 1 if no -proxy or -connect)") + "\n";
     strUsage += "  -maxconnections=<n>    " + _("Maintain at most <n> connections to peers (default: 125)") + "\n";
     strUsage += "  -maxreceivebuffer=<n>  " + _("Maximum per-connection receive buffer, <n>*1000 bytes (default: 5000)") + "\n";
     strUsage += "  -maxsendbuffer=<n>     " + _("Maximum per-connection send buffer, <n>*1000 bytes (default: 1000)") + "\n";
+    strUsage += "  -msghandthreads=<n>    " + strprintf(_("Number of threads processing peer messages, the messages of a peer are processed in order by one of them (1 to %d, default: %d)"), MAX_MSGHAND_THREADS, DEFAULT_MSGHAND_THREADS) + "\n";
     strUsage += "  -onion=<ip:port>       " + _("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: -proxy)") + "\n";
     strUsage += "  -onlynet=<net>         " + _("Only connect to nodes in network <net> (IPv4, IPv6 or Tor)") + "\n";
     strUsage += "  -port=<port>           " + _("Listen for connections on <port> (default: 8333 or testnet: 18333)") + "\n";
@@ -284,7 +297,7 @@ string HelpMessage() {
     strUsage += "  -logtimestamps         " + _("Prepend debug output with timestamp (default: 1)") + "\n";
     if (SysCfg().GetBoolArg("-help-debug", false)) {
         strUsage += "  -limitfreerelay=<n>    " + _("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default:15)") + "\n";
-        strUsage += "  -maxsigcachesize=<n>   " + _("Limit size of signature cache to <n> entries (default: 50000)") + "\n";
+        strUsage += "  -sigcachemaxmb=<n>     " + strprintf(_("Limit the signature cache to <n> megabytes (default: %d)"), DEFAULT_MAX_SIG_CACHE_SIZE) + "\n";
     }
     strUsage += "  -logprinttoconsole     " + _("Send trace/debug info to console instead of debug.log file") + "\n";
     if (SysCfg().GetBoolArg("-help-debug", false)) {
@@ -301,6 +314,8 @@ string HelpMessage() {
 
     strUsage += "\n" + _("Block creation options:") + "\n";
     strUsage += "  -blockmaxsize=<n>      " + strprintf(_("Set maximum block size in bytes (default: %d)"), DEFAULT_BLOCK_MAX_SIZE) + "\n";
+    strUsage += "  -packthreads=<n>       " + strprintf(_("Set the number of threads executing transactions in block production (%d to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), -(int32_t)std::thread::hardware_concurrency(), MAX_PACK_THREADS, DEFAULT_PACK_THREADS) + "\n";
+    strUsage += "  -blocktemplate         " + strprintf(_("Keep the next block packed ahead of the slot of this node, with the transactions packed as they arrive (default: %u)"), DEFAULT_BLOCK_TEMPLATE) + "\n";
 
     strUsage += "\n" + _("RPC server options:") + "\n";
     strUsage += "  -rpcserver             " + _("Accept command line and JSON-RPC commands") + "\n";
@@ -503,6 +518,15 @@ bool AppInit(boost::thread_group &threadGroup) {
     if (nFD - MIN_CORE_FILEDESCRIPTORS < nMaxConnections)
         nMaxConnections = nFD - MIN_CORE_FILEDESCRIPTORS;
 
+    // -par=0 means autodetect, but nSigCheckThreads==0 means no concurrency
+    nSigCheckThreads = SysCfg().GetArg("-par", DEFAULT_SIGCHECK_THREADS);
+    if (nSigCheckThreads <= 0)
+        nSigCheckThreads += std::thread::hardware_concurrency();
+    if (nSigCheckThreads <= 1)
+        nSigCheckThreads = 0;
+    else if (nSigCheckThreads > MAX_SIGCHECK_THREADS)
+        nSigCheckThreads = MAX_SIGCHECK_THREADS;
+
     SysCfg().SetBenchMark(SysCfg().GetBoolArg("-benchmark", false));
     mempool.SetSanityCheck(SysCfg().GetBoolArg("-checkmempool", RegTest()));
 
@@ -554,6 +578,20 @@ bool AppInit(boost::thread_group &threadGroup) {
     LogPrint(BCLog::INFO, "Using data directory %s\n", strDataDir);
     LogPrint(BCLog::INFO, "Using at most %i connections (%i file descriptors available)\n", nMaxConnections, nFD);
 
+    if (nSigCheckThreads) {
+        LogPrint(BCLog::INFO, "Using %u threads for signature verification and block tx execution\n", nSigCheckThreads);
+        // the thread running ConnectBlock() joins the queue as the last worker
+        for (int32_t i = 0; i < nSigCheckThreads - 1; i++) {
+            threadGroup.create_thread(&ThreadSigCheck);
+            threadGroup.create_thread(&ThreadTxGroupCheck);
+        }
+    }
+
+    int64_t nSigCacheMaxMB = SysCfg().GetArg("-sigcachemaxmb", DEFAULT_MAX_SIG_CACHE_SIZE);
+    nSigCacheMaxMB         = std::max<int64_t>(0, std::min(nSigCacheMaxMB, MAX_MAX_SIG_CACHE_SIZE));
+    signatureCache.Setup((size_t)nSigCacheMaxMB << 20);
+    LogPrint(BCLog::INFO, "Using %d MiB for signature cache\n", nSigCacheMaxMB);
+
     RegisterNodeSignals(GetNodeSignals());
 
     int32_t nSocksVersion = SysCfg().GetArg("-socks", 5);
@@ -623,6 +661,9 @@ bool AppInit(boost::thread_group &threadGroup) {
     fDiscover   = SysCfg().GetBoolArg("-discover", true);
     fNameLookup = SysCfg().GetBoolArg("-dns", true);
 
+    if (SysCfg().GetBoolArg("-compactblocks", DEFAULT_COMPACT_BLOCKS))
+        nLocalServices |= NODE_COMPACT_BLOCKS;
+
     bool fBound = false;
     if (!fNoListen) {
         if (SysCfg().IsArgCount("-bind")) {
@@ -693,8 +734,14 @@ bool AppInit(boost::thread_group &threadGroup) {
                 UnloadBlockIndex();
                 delete pCdMan;
 
-                bool fReIndex = SysCfg().IsReindex();
-                pCdMan = new CCacheDBManager(fReIndex, false);
+                bool fReIndex   = SysCfg().IsReindex();
+                bool fUnifiedDb = SysCfg().GetBoolArg("-unifieddb", false);
+                if (!fReIndex && CCacheDBManager::IsStorageModeChanged(fUnifiedDb)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -unifieddb");
+                    break;
+                }
+
+                pCdMan = new CCacheDBManager(fReIndex, false, fUnifiedDb);
                 if (fReIndex)
                     pCdMan->pBlockCache->WriteReindexing(true);
 
@@ -799,6 +846,7 @@ bool AppInit(boost::thread_group &threadGroup) {
 
         if (!pCdMan->pTxCache->AddBlockTx(block))
             return InitError("Failed to add block to transaction memory cache");
+        CacheBlockSummary(block);
 
         pBlockIndex = pBlockIndex->pprev;
         ++nCount;
@@ -28,9 +28,11 @@
 #include "chain/blockdelegates.h"
 #include "persistence/blockundo.h"
 #include "tx/txserializer.h"
+#include "checkqueue.h"
 
 #include <sstream>
 #include <algorithm>
+#include <atomic>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -58,8 +60,11 @@ int32_t nSyncTipHeight = 0;
 string publicIp;
 map<uint256/* blockhash */, std::shared_ptr<CCacheWrapper>> mapForkCache;
 CSignatureCache signatureCache;
+int32_t nSigCheckThreads = 0;
 CChain chainActive;
 CChain chainMostWork;
+// block time of the chainActive tip, for the message handlers which don't take cs_main
+static std::atomic<int64_t> nTipBlockTime(0);
 bool mining;        // could change from time to time due to vote change
 CKeyID minerKeyId;  // miner accout keyId
 CKeyID nodeKeyId;   // 1st keyId of the node
@@ -68,6 +73,7 @@ extern CPBFTMan pbftMan;
 map<uint256/* blockhash */, COrphanBlock *> mapOrphanBlocks;
 multimap<uint256/* blockhash */, COrphanBlock *> mapOrphanBlocksByPrev;
 map<uint256/* blockhash */, std::shared_ptr<CBaseTx> > mapOrphanTransactions;
+CHeaderChain headerChain;
 extern CPBFTContext pbftContext ;
 const string strMessageMagic = "Coin Signed Message:\n";
 
@@ -147,6 +153,12 @@ CCriticalSection cs_nBlockSequenceId;
 // Blocks loaded from disk are assigned id 0, so start the counter at 1.
 uint32_t nBlockSequenceId = 1;
 
+// Signature verifications of a block are fanned out to this queue ahead of the serial tx execution.
+CCheckQueue<CSignatureCheck> sigCheckQueue(128);
+
+// State of the last block packed by this node, guarded by cs_main
+std::shared_ptr<CPreExecutedBlock> spPreExecutedBlock;
+
 
 }  // namespace
 
@@ -230,7 +242,7 @@ bool IsStandardTx(CBaseTx *pBaseTx, string &reason) {
     // almost as much to process as they cost the sender in fees, because
     // computing signature hashes is O(ninputs*txsize). Limiting transactions
     // to MAX_STANDARD_TX_SIZE mitigates CPU exhaustion attacks.
-    uint32_t sz = ::GetSerializeSize(pBaseTx->GetNewInstance(), SER_NETWORK, CBaseTx::CURRENT_VERSION);
+    uint32_t sz = pBaseTx->GetSerializedSize() + 1;
     if (sz >= MAX_STANDARD_TX_SIZE) {
         reason = "tx-size";
         return false;
@@ -250,6 +262,38 @@ bool VerifySignature(const uint256 &sigHash, const std::vector<uint8_t> &signatu
     return true;
 }
 
+bool VerifySignatureBatch(CSignatureBatch &batch) {
+    vector<bool> cached(batch.size(), false);
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (signatureCache.Get(batch[i].hash, batch[i].signature, batch[i].pubKey)) {
+            batch.SetValid(i);
+            cached[i] = true;
+        }
+    }
+
+    bool fAllValid = batch.Verify();
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (!cached[i] && batch.IsValid(i))
+            signatureCache.Set(batch[i].hash, batch[i].signature, batch[i].pubKey);
+    }
+    return fAllValid;
+}
+
+void ThreadSigCheck() {
+    RenameThread("coin-sigcheck");
+    sigCheckQueue.Thread();
+}
+
+void SetPreExecutedBlock(std::shared_ptr<CPreExecutedBlock> spBlock) {
+    LOCK(cs_main);
+    spPreExecutedBlock = spBlock;
+}
+
+size_t GetMaxMempoolSize() {
+    return SysCfg().GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+}
+
 bool AcceptToMemoryPool(CTxMemPool &pool, CValidationState &state, CBaseTx *pBaseTx,
                         bool fLimitFree, bool fRejectInsaneFee) {
     AssertLockHeld(cs_main);
@@ -312,7 +356,27 @@ bool AcceptToMemoryPool(CTxMemPool &pool, CValidationState &state, CBaseTx *pBas
     if (fRejectInsaneFee && nFees > SysCfg().GetMaxFee())
         return ERRORMSG("AcceptToMemoryPool() : txid: %s pay insane fees, %d > %d", hash.GetHex(), nFees, SysCfg().GetMaxFee());
 
-    return pool.AddUnchecked(hash, entry, state);
+    // The txs resurrected from a disconnected block are exempted, the pool is trimmed after them.
+    // The fuel is unknown before the execution, so the fee is checked before deducting it.
+    if (fLimitFree) {
+        double minFeePerKb = pool.GetMinFeePerKb(GetMaxMempoolSize());
+        if (minFeePerKb > 0 && nFees * 1000.0 / nSize < minFeePerKb)
+            return state.DoS(0, ERRORMSG("AcceptToMemoryPool() : txid: %s fee per KB %.0f < mempool min fee %.0f",
+                            hash.GetHex(), nFees * 1000.0 / nSize, minFeePerKb), REJECT_INSUFFICIENTFEE,
+                            "mempool-min-fee-not-met");
+    }
+
+    if (!pool.AddUnchecked(hash, entry, state))
+        return false;
+
+    if (fLimitFree) {
+        pool.TrimToSize(GetMaxMempoolSize());
+        if (!pool.Exists(hash))
+            return state.DoS(0, ERRORMSG("AcceptToMemoryPool() : txid: %s evicted, mempool full", hash.GetHex()),
+                            REJECT_INSUFFICIENTFEE, "mempool-full");
+    }
+
+    return true;
 }
 
 int32_t CMerkleTx::GetDepthInMainChainINTERNAL(CBlockIndex *&pindexRet) const {
@@ -676,7 +740,58 @@ void UpdateTime(CBlockHeader &block, const CBlockIndex *pIndexPrev) {
     block.SetTime(max(pIndexPrev->GetMedianTimePast() + 1, GetAdjustedTime()));
 }
 
-bool DisconnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValidationState &state, bool *pfClean) {
+// What Connect/DisconnectBlock() need from the blocks they look back at: the txids of the block
+// leaving (or re-entering) the tx memory cache and the reward tx of the block reaching maturity.
+struct CBlockSummary {
+    vector<uint256> txids;
+    std::shared_ptr<CBaseTx> pRewardTx;
+};
+
+// Summaries of the recently connected blocks, by (height, hash) so that forks don't collide. Enough
+// heights are kept for steady-state connects to never read a historical block from disk.
+static CCriticalSection cs_blockSummaries;
+static map<pair<int32_t, uint256>, std::shared_ptr<const CBlockSummary>> mapBlockSummaries;
+
+void CacheBlockSummary(const CBlock &block) {
+    auto pSummary = std::make_shared<CBlockSummary>();
+    pSummary->txids.reserve(block.vptx.size());
+    for (const auto &pTx : block.vptx)
+        pSummary->txids.push_back(pTx->GetHash());
+    if (!block.vptx.empty())
+        pSummary->pRewardTx = block.vptx[0]->GetNewInstance();
+
+    // one more than the deepest look back, a few blocks of margin for reorgs
+    int32_t nKeepHeight = std::max(BLOCK_REWARD_MATURITY, std::max(SysCfg().GetTxCacheHeight(), 11)) + 10;
+
+    LOCK(cs_blockSummaries);
+    mapBlockSummaries[make_pair((int32_t)block.GetHeight(), block.GetHash())] = pSummary;
+    while (!mapBlockSummaries.empty() &&
+           mapBlockSummaries.begin()->first.first + nKeepHeight < (int32_t)block.GetHeight())
+        mapBlockSummaries.erase(mapBlockSummaries.begin());
+}
+
+static std::shared_ptr<const CBlockSummary> GetBlockSummary(const CBlockIndex *pIndex) {
+    {
+        LOCK(cs_blockSummaries);
+        auto it = mapBlockSummaries.find(make_pair(pIndex->height, pIndex->GetBlockHash()));
+        if (it != mapBlockSummaries.end())
+            return it->second;
+    }
+
+    CBlock block;
+    if (!ReadBlockFromDisk(pIndex, block))
+        return nullptr;
+
+    LogPrint(BCLog::INFO, "GetBlockSummary() : read block[%d]:%s from disk\n", pIndex->height,
+             pIndex->GetBlockHash().ToString());
+    CacheBlockSummary(block);
+    LOCK(cs_blockSummaries);
+    auto it = mapBlockSummaries.find(make_pair(pIndex->height, pIndex->GetBlockHash()));
+    return it != mapBlockSummaries.end() ? it->second : nullptr;
+}
+
+bool DisconnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValidationState &state, bool *pfClean,
+                     CDbKeySet *pChangedKeys) {
     assert(pIndex->GetBlockHash() == cw.blockCache.GetBestBlockHash());
 
     if (pfClean)
@@ -699,6 +814,11 @@ bool DisconnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CVal
         return ERRORMSG("DisconnectBlock() : Undo all data in block failed");
     }
 
+    if (pChangedKeys != nullptr) {
+        for (const auto &txUndo : blockUndo.vtxundo)
+            pChangedKeys->AddWrites(txUndo.dbOpLogMap);
+    }
+
     // Set previous block as the best block
     cw.blockCache.SetBestBlock(pIndex->pprev->GetBlockHash());
 
@@ -715,12 +835,12 @@ bool DisconnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CVal
             pReLoadBlockIndex = pReLoadBlockIndex->pprev;
         }
 
-        CBlock reLoadblock;
-        if (!ReadBlockFromDisk(pReLoadBlockIndex, reLoadblock)) {
+        auto pReLoadSummary = GetBlockSummary(pReLoadBlockIndex);
+        if (!pReLoadSummary) {
             return state.Abort(_("DisconnectBlock() : failed to read block"));
         }
 
-        if (!cw.txCache.AddBlockTx(reLoadblock)) {
+        if (!cw.txCache.AddBlockTx(pReLoadSummary->txids)) {
             return state.Abort(_("DisconnectBlock() : failed to add block into transaction memory cache"));
         }
     }
@@ -1009,11 +1129,329 @@ static bool ComputeVoteStakingInterestAndRevokeVotes(const int32_t currHeight, c
     return true;
 }
 
-bool ConnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValidationState &state, bool fJustCheck) {
+// Fan the signature batch out to the signature checking threads, leaving the valid signatures in the
+// signature cache so that the serial checks afterwards only hit the cache.
+static void PreVerifySignatures(CSignatureBatch &batch) {
+    if (nSigCheckThreads <= 0 || batch.empty())
+        return;
+
+    int64_t nStart = GetTimeMicros();
+    size_t nItems  = batch.size();
+
+    // a few slices per thread, so that the threads finish at about the same time
+    vector<CSignatureBatch> slices;
+    batch.Split(nSigCheckThreads * 4, slices);
+
+    vector<CSignatureCheck> checks;
+    checks.reserve(slices.size());
+    for (auto &slice : slices) {
+        checks.emplace_back(slice);
+    }
+
+    CCheckQueueControl<CSignatureCheck> control(&sigCheckQueue);
+    control.Add(checks);
+    control.Wait();
+
+    if (SysCfg().IsBenchmark())
+        LogPrint(BCLog::INFO, "- Verify %u signatures: %.2fms\n", nItems, 0.001 * (GetTimeMicros() - nStart));
+}
+
+void PreVerifyTxSignatures(const vector<std::shared_ptr<CBaseTx>> &vptx, CCacheWrapper &cw) {
+    CSignatureBatch batch;
+    batch.reserve(vptx.size());
+    for (const auto &pBaseTx : vptx) {
+        pBaseTx->GetSignatureChecks(cw, batch);
+    }
+
+    PreVerifySignatures(batch);
+}
+
+// Verify all signatures of the block (tx signatures, multi-signatures and the block signature) ahead of the
+// serial CheckTx()/VerifyRewardTx(). Failures are ignored here as the serial validation reports them with the
+// proper reject reason.
+static void PreVerifyBlockSignatures(const CBlock &block, CCacheWrapper &cw) {
+    if (nSigCheckThreads <= 0 || block.vptx.size() <= 1)
+        return;
+
+    CSignatureBatch batch;
+    batch.reserve(block.vptx.size() + 2);
+    for (const auto &pBaseTx : block.vptx) {
+        pBaseTx->GetSignatureChecks(cw, batch);
+    }
+
+    CAccount delegateAccount;
+    const auto &blockSignature = block.GetSignature();
+    if (!blockSignature.empty() && blockSignature.size() <= MAX_SIGNATURE_SIZE &&
+        cw.accountCache.GetAccount(block.vptx[0]->txUid, delegateAccount)) {
+        batch.Add(block.GetHash(), blockSignature, delegateAccount.owner_pubkey);
+        if (delegateAccount.miner_pubkey.IsValid() && delegateAccount.miner_pubkey != delegateAccount.owner_pubkey)
+            batch.Add(block.GetHash(), blockSignature, delegateAccount.miner_pubkey);
+    }
+
+    PreVerifySignatures(batch);
+}
+
+// A group of txs of a block sharing accounts, executed in block order on a cache of its own
+struct CTxGroup {
+    vector<int32_t> indexes;
+    std::shared_ptr<CCacheWrapper> spCW;
+    vector<CTxUndo> txUndos;
+    CDbKeySet readKeys;
+    CDbKeySet writeKeys;
+    bool fExecuted = false;
+};
+
+// The block context the tx groups are executed in
+struct CTxGroupContext {
+    const CBlock *pBlock;
+    CCacheWrapper *pCW;
+    int32_t height;
+    uint32_t fuelRate;
+    uint32_t blockTime;
+    uint32_t prevBlockTime;
+};
+
+class CTxGroupCheck {
+public:
+    CTxGroupCheck() {}
+    CTxGroupCheck(const CTxGroupContext *pContextIn, CTxGroup *pGroupIn) : pContext(pContextIn), pGroup(pGroupIn) {}
+
+    bool operator()() {
+        CTxGroup &group = *pGroup;
+        group.spCW      = std::make_shared<CCacheWrapper>(pContext->pCW);
+        group.txUndos.assign(group.indexes.size(), CTxUndo());
+        group.fExecuted = true;
+
+        try {
+            for (size_t i = 0; i < group.indexes.size() && group.fExecuted; i++) {
+                int32_t index       = group.indexes[i];
+                const auto &pBaseTx = pContext->pBlock->vptx[index];
+                CTxUndo &txUndo     = group.txUndos[i];
+                txUndo.SetTxID(pBaseTx->GetHash());
+                txUndo.dbOpLogMap.SetReadKeys(&group.readKeys);
+                group.spCW->SetDbOpLogMap(&txUndo.dbOpLogMap);
+
+                CValidationState state;
+                CTxExecuteContext context(pContext->height, index, pContext->fuelRate, pContext->blockTime,
+                                          pContext->prevBlockTime, group.spCW.get(), &state);
+                group.fExecuted = pBaseTx->ExecuteTx(context);
+            }
+        } catch (std::exception &e) {
+            group.fExecuted = false;
+        }
+        if (CConcurrentReads::TakeRangeReadRefused())
+            group.fExecuted = false;
+
+        group.spCW->SetDbOpLogMap(nullptr);
+        for (auto &txUndo : group.txUndos) {
+            txUndo.dbOpLogMap.SetReadKeys(nullptr);
+            group.writeKeys.AddWrites(txUndo.dbOpLogMap);
+        }
+        return group.fExecuted;
+    }
+
+    void swap(CTxGroupCheck &check) {
+        std::swap(pContext, check.pContext);
+        std::swap(pGroup, check.pGroup);
+    }
+
+private:
+    const CTxGroupContext *pContext = nullptr;
+    CTxGroup *pGroup = nullptr;
+};
+
+static CCheckQueue<CTxGroupCheck> txGroupCheckQueue(1);
+
+void ThreadTxGroupCheck() {
+    RenameThread("coin-txexec");
+    txGroupCheckQueue.Thread();
+}
+
+static int32_t FindGroupRoot(vector<int32_t> &parents, int32_t i) {
+    while (parents[i] != i) {
+        parents[i] = parents[parents[i]];
+        i          = parents[i];
+    }
+    return i;
+}
+
+static bool UnionGroups(vector<int32_t> &parents, int32_t a, int32_t b) {
+    a = FindGroupRoot(parents, a);
+    b = FindGroupRoot(parents, b);
+    if (a == b)
+        return false;
+
+    parents[std::max(a, b)] = std::min(a, b);
+    return true;
+}
+
+// Execute the run of concurrent txs [beginIndex, endIndex) of the block in groups on the tx execution
+// threads. The txs are grouped by the accounts they declare, the groups are executed concurrently on
+// caches of their own and the keys each group read and wrote are compared afterwards: groups which
+// touched the same keys are merged and executed again, until no two groups overlap, so that the result
+// is the one of executing the txs serially. Returns false, with cw untouched, if the run has to be
+// executed serially instead.
+static bool ExecuteTxGroups(const CBlock &block, int32_t beginIndex, int32_t endIndex, CTxGroupContext &context,
+                            map<int32_t, CTxUndo> &txUndos) {
+    CCacheWrapper &cw   = *context.pCW;
+    int32_t curHeight   = context.height - 1;
+    int32_t validHeight = SysCfg().GetTxCacheHeight();
+    int32_t nTxs        = endIndex - beginIndex;
+
+    // group the txs by the accounts they declare
+    vector<int32_t> parents(nTxs);
+    map<CKeyID, int32_t> keyIdOwners;
+    for (int32_t i = 0; i < nTxs; i++) {
+        parents[i]          = i;
+        const auto &pBaseTx = block.vptx[beginIndex + i];
+        // leave the txs to be rejected to the serial execution
+        if (cw.txCache.HaveTx(pBaseTx->GetHash()) || !pBaseTx->IsValidHeight(curHeight, validHeight))
+            return false;
+
+        set<CKeyID> keyIds;
+        if (!pBaseTx->GetInvolvedKeyIds(cw, keyIds))
+            return false;
+
+        for (const auto &keyId : keyIds) {
+            auto ret = keyIdOwners.emplace(keyId, i);
+            if (!ret.second)
+                UnionGroups(parents, i, ret.first->second);
+        }
+    }
+
+    vector<std::unique_ptr<CTxGroup>> groups;
+    {
+        map<int32_t, CTxGroup *> roots;
+        for (int32_t i = 0; i < nTxs; i++) {
+            auto &pGroup = roots[FindGroupRoot(parents, i)];
+            if (pGroup == nullptr) {
+                groups.emplace_back(new CTxGroup());
+                pGroup = groups.back().get();
+            }
+            pGroup->indexes.push_back(beginIndex + i);
+        }
+    }
+    if (groups.size() < 2)
+        return false;
+
+    int64_t nStart      = GetTimeMicros();
+    uint32_t nRounds    = 0;
+    size_t nFirstGroups = groups.size();
+    while (true) {
+        vector<CTxGroupCheck> checks;
+        for (auto &pGroup : groups) {
+            if (pGroup->spCW == nullptr)
+                checks.emplace_back(&context, pGroup.get());
+        }
+
+        bool fAllOk;
+        {
+            CConcurrentReads concurrentReads;
+            CCheckQueueControl<CTxGroupCheck> control(&txGroupCheckQueue);
+            control.Add(checks);
+            fAllOk = control.Wait();
+        }
+        nRounds++;
+        // a tx failing may be due to a write of another group, let the serial execution tell
+        if (!fAllOk)
+            return false;
+
+        // merge the groups reading or writing the keys written by another group
+        int32_t nGroups = groups.size();
+        map<string, map<string, vector<int32_t>>> writers;
+        for (int32_t g = 0; g < nGroups; g++) {
+            for (const auto &item : groups[g]->writeKeys.GetMap()) {
+                auto &keyWriters = writers[item.first];
+                for (const auto &key : item.second)
+                    keyWriters[key].push_back(g);
+            }
+        }
+
+        vector<int32_t> groupParents(nGroups);
+        for (int32_t g = 0; g < nGroups; g++)
+            groupParents[g] = g;
+
+        bool fMerged = false;
+        for (int32_t g = 0; g < nGroups; g++) {
+            for (const CDbKeySet *pKeys : {&groups[g]->readKeys, &groups[g]->writeKeys}) {
+                for (const auto &item : pKeys->GetMap()) {
+                    auto it = writers.find(item.first);
+                    if (it == writers.end())
+                        continue;
+
+                    // the whole prefix was read
+                    if (item.second.count("")) {
+                        for (const auto &keyWriters : it->second) {
+                            for (int32_t w : keyWriters.second)
+                                fMerged |= UnionGroups(groupParents, g, w);
+                        }
+                        continue;
+                    }
+
+                    for (const auto &key : item.second) {
+                        auto keyIt = it->second.find(key);
+                        if (keyIt == it->second.end())
+                            continue;
+
+                        for (int32_t w : keyIt->second)
+                            fMerged |= UnionGroups(groupParents, g, w);
+                    }
+                }
+            }
+        }
+        if (!fMerged)
+            break;
+
+        // the groups left alone keep their results, the merged ones are executed again
+        map<int32_t, int32_t> rootSizes;
+        for (int32_t g = 0; g < nGroups; g++)
+            rootSizes[FindGroupRoot(groupParents, g)]++;
+
+        vector<std::unique_ptr<CTxGroup>> mergedGroups;
+        map<int32_t, CTxGroup *> roots;
+        for (int32_t g = 0; g < nGroups; g++) {
+            int32_t root = FindGroupRoot(groupParents, g);
+            if (rootSizes[root] == 1) {
+                mergedGroups.push_back(std::move(groups[g]));
+                continue;
+            }
+
+            auto &pGroup = roots[root];
+            if (pGroup == nullptr) {
+                mergedGroups.emplace_back(new CTxGroup());
+                pGroup = mergedGroups.back().get();
+            }
+            pGroup->indexes.insert(pGroup->indexes.end(), groups[g]->indexes.begin(), groups[g]->indexes.end());
+        }
+        for (auto &pGroup : mergedGroups)
+            std::sort(pGroup->indexes.begin(), pGroup->indexes.end());
+
+        groups.swap(mergedGroups);
+        if (groups.size() < 2)
+            return false;
+    }
+
+    // the groups don't overlap, so the order they are flushed in doesn't matter
+    for (auto &pGroup : groups) {
+        pGroup->spCW->Flush();
+        for (size_t i = 0; i < pGroup->indexes.size(); i++)
+            txUndos[pGroup->indexes[i]] = std::move(pGroup->txUndos[i]);
+    }
+
+    LogPrint(BCLog::DEBUG, "ExecuteTxGroups() : executed %d txs in %u groups (%u at first) in %u rounds, %.2fms\n",
+             nTxs, groups.size(), nFirstGroups, nRounds, 0.001 * (GetTimeMicros() - nStart));
+    return true;
+}
+
+bool ConnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValidationState &state, bool fJustCheck,
+                  CDbKeySet *pChangedKeys, const CPreExecutedBlock *pPreExecuted) {
     AssertLockHeld(cs_main);
 
     bool isGensisBlock = block.GetHeight() == 0 && block.GetHash() == SysCfg().GetGenesisBlockHash();
 
+    if (!isGensisBlock && !fJustCheck)
+        PreVerifyBlockSignatures(block, cw);
+
     // Check it again in case a previous version let a bad block in
     if (!isGensisBlock && !CheckBlock(block, state, cw, !fJustCheck, !fJustCheck))
         return state.DoS(100, ERRORMSG("ConnectBlock() : check block error"), REJECT_INVALID, "check-block-error");
@@ -1080,26 +1518,68 @@ bool ConnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValida
         uint32_t fuelRate     = block.GetFuelRate();
         uint64_t totalRunStep = 0;
 
+        uint32_t prevBlockTime = pIndex->pprev != nullptr ? pIndex->pprev->GetBlockTime() : pIndex->GetBlockTime();
+        CTxGroupContext groupContext{&block, &cw, pIndex->height, fuelRate, pIndex->nTime, prevBlockTime};
+        // undo of the txs executed in groups ahead, or when packing the block, by index
+        map<int32_t, CTxUndo> groupTxUndos;
+        int32_t runEnd = 1;
+
+        // the txs of a block packed by this node were executed on the same state already, take their state
+        if (pPreExecuted != nullptr && !fJustCheck && pPreExecuted->blockHash == block.GetHash() &&
+            pPreExecuted->prevBlockHash == block.GetPrevBlockHash() &&
+            pPreExecuted->txUndos.size() == block.vptx.size() - 1 &&
+            pPreExecuted->runSteps.size() == block.vptx.size() - 1) {
+            cw = *pPreExecuted->spCW;
+            for (int32_t index = 1; index < (int32_t)block.vptx.size(); ++index) {
+                block.vptx[index]->nRunStep = pPreExecuted->runSteps[index - 1];
+                groupTxUndos[index]         = pPreExecuted->txUndos[index - 1];
+            }
+            runEnd = block.vptx.size();
+
+            LogPrint(BCLog::INFO, "ConnectBlock() : took the state of %u txs executed when packing block %s\n",
+                     block.vptx.size() - 1, block.GetHash().GetHex());
+        }
+
         for (int32_t index = 1; index < (int32_t)block.vptx.size(); ++index) {
             std::shared_ptr<CBaseTx> &pBaseTx = block.vptx[index];
-            if (cw.txCache.HaveTx((pBaseTx->GetHash())))
-                return state.DoS(100, ERRORMSG("ConnectBlock() : txid=%s duplicated", pBaseTx->GetHash().GetHex()),
-                                 REJECT_INVALID, "tx-duplicated");
+            pBaseTx->nFuelRate = fuelRate;
 
-            if (!pBaseTx->IsValidHeight(curHeight, validHeight))
-                return state.DoS(100, ERRORMSG("ConnectBlock() : txid=%s beyond the scope of valid height",
-                                 pBaseTx->GetHash().GetHex()), REJECT_INVALID, "tx-invalid-height");
+            // execute the next run of consecutive concurrent txs in groups when worthwhile
+            if (index >= runEnd && IsConcurrentTxType(pBaseTx->nTxType)) {
+                runEnd = index + 1;
+                while (runEnd < (int32_t)block.vptx.size() && IsConcurrentTxType(block.vptx[runEnd]->nTxType))
+                    runEnd++;
 
-            pBaseTx->nFuelRate = fuelRate;
-            CTxUndoOpLogger opLogger(cw, pBaseTx->GetHash(), blockUndo);
+                if (nSigCheckThreads > 1 && runEnd - index >= 2) {
+                    for (int32_t i = index; i < runEnd; i++)
+                        block.vptx[i]->nFuelRate = fuelRate;
 
-            uint32_t prevBlockTime = pIndex->pprev != nullptr ? pIndex->pprev->GetBlockTime() : pIndex->GetBlockTime();
-            CTxExecuteContext context(pIndex->height, index, fuelRate, pIndex->nTime, prevBlockTime, &cw, &state);
-            if (!pBaseTx->ExecuteTx(context)) {
-                pCdMan->pLogCache->SetExecuteFail(pIndex->height, pBaseTx->GetHash(), state.GetRejectCode(),
-                                                  state.GetRejectReason());
-                return state.DoS(100, ERRORMSG("ConnectBlock() : txid=%s execute failed, in detail: %s",
-                                 pBaseTx->GetHash().GetHex(), pBaseTx->ToString(cw.accountCache)), REJECT_INVALID, "tx-execute-failed");
+                    ExecuteTxGroups(block, index, runEnd, groupContext, groupTxUndos);
+                }
+            }
+
+            auto undoIt = groupTxUndos.find(index);
+            if (undoIt != groupTxUndos.end()) {
+                blockUndo.vtxundo.push_back(std::move(undoIt->second));
+                groupTxUndos.erase(undoIt);
+            } else {
+                if (cw.txCache.HaveTx((pBaseTx->GetHash())))
+                    return state.DoS(100, ERRORMSG("ConnectBlock() : txid=%s duplicated", pBaseTx->GetHash().GetHex()),
+                                     REJECT_INVALID, "tx-duplicated");
+
+                if (!pBaseTx->IsValidHeight(curHeight, validHeight))
+                    return state.DoS(100, ERRORMSG("ConnectBlock() : txid=%s beyond the scope of valid height",
+                                     pBaseTx->GetHash().GetHex()), REJECT_INVALID, "tx-invalid-height");
+
+                CTxUndoOpLogger opLogger(cw, pBaseTx->GetHash(), blockUndo);
+
+                CTxExecuteContext context(pIndex->height, index, fuelRate, pIndex->nTime, prevBlockTime, &cw, &state);
+                if (!pBaseTx->ExecuteTx(context)) {
+                    pCdMan->pLogCache->SetExecuteFail(pIndex->height, pBaseTx->GetHash(), state.GetRejectCode(),
+                                                      state.GetRejectReason());
+                    return state.DoS(100, ERRORMSG("ConnectBlock() : txid=%s execute failed, in detail: %s",
+                                     pBaseTx->GetHash().GetHex(), pBaseTx->ToString(cw.accountCache)), REJECT_INVALID, "tx-execute-failed");
+                }
             }
 
             vPos.push_back(make_pair(pBaseTx->GetHash(), pos));
@@ -1118,7 +1598,8 @@ bool ConnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValida
             assert(fees >= fuel);
             rewards[fees_symbol] += (fees - fuel);
 
-            pos.nTxOffset += ::GetSerializeSize(pBaseTx, SER_DISK, CLIENT_VERSION);
+            // tx serialization doesn't depend on the stream type, so the cached network size applies on disk too
+            pos.nTxOffset += pBaseTx->GetSerializedSize() + 1;
 
             LogPrint(BCLog::DEBUG, "total fuel fee:%d, tx fuel fee:%d runStep:%d fuelRate:%d txid:%s\n", totalFuel,
                      fuel, pBaseTx->nRunStep, fuelRate, pBaseTx->GetHash().GetHex());
@@ -1204,16 +1685,18 @@ bool ConnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValida
         }
 
         if (nullptr != pMatureIndex) {
-            CBlock matureBlock;
-            if (!ReadBlockFromDisk(pMatureIndex, matureBlock)) {
+            auto pMatureSummary = GetBlockSummary(pMatureIndex);
+            if (!pMatureSummary || !pMatureSummary->pRewardTx) {
                 return state.Abort(_("ConnectBlock() : read mature block error"));
             }
+            // executed on its own copy, the summary may serve other connects of this height
+            auto pMatureRewardTx = pMatureSummary->pRewardTx->GetNewInstance();
 
             uint32_t prevBlockTime = pIndex->pprev != nullptr ? pIndex->pprev->GetBlockTime() : pIndex->GetBlockTime();
             CTxExecuteContext context(pIndex->height, -1, pIndex->nFuelRate, pIndex->nTime, prevBlockTime, &cw, &state);
             CTxUndoOpLogger rewardOpLogger(cw, block.vptx[0]->GetHash(), blockUndo);
-            if (!matureBlock.vptx[0]->ExecuteTx(context)) {
-                pCdMan->pLogCache->SetExecuteFail(pIndex->height, matureBlock.vptx[0]->GetHash(), state.GetRejectCode(),
+            if (!pMatureRewardTx->ExecuteTx(context)) {
+                pCdMan->pLogCache->SetExecuteFail(pIndex->height, pMatureRewardTx->GetHash(), state.GetRejectCode(),
                                                   state.GetRejectReason());
                 return state.DoS(100, ERRORMSG("ConnectBlock() : execute mature block reward tx error"));
             }
@@ -1260,12 +1743,12 @@ bool ConnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValida
             pDeleteBlockIndex = pDeleteBlockIndex->pprev;
         }
 
-        CBlock deleteBlock;
-        if (!ReadBlockFromDisk(pDeleteBlockIndex, deleteBlock)) {
+        auto pDeleteSummary = GetBlockSummary(pDeleteBlockIndex);
+        if (!pDeleteSummary) {
             return state.Abort(_("ConnectBlock() : failed to read block"));
         }
 
-        if (!cw.txCache.RemoveBlockTx(deleteBlock)) {
+        if (!cw.txCache.RemoveBlockTx(pDeleteSummary->txids)) {
             return state.Abort(_("ConnectBlock() : failed delete block from transaction memory cache"));
         }
     }
@@ -1281,12 +1764,8 @@ bool ConnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValida
             pDeleteBlockIndex = pDeleteBlockIndex->pprev;
         }
 
-        CBlock deleteBlock;
-        if (!ReadBlockFromDisk(pDeleteBlockIndex, deleteBlock)) {
-            return state.Abort(_("ConnectBlock() : failed to read block"));
-        }
-
-        if (!cw.ppCache.DeleteBlockFromCache(deleteBlock)) {
+        // only the height of the block is needed
+        if (!cw.ppCache.DeleteBlockFromCache(pDeleteBlockIndex->height)) {
             return state.Abort(_("ConnectBlock() : failed delete block from price point memory cache"));
         }
     }
@@ -1294,6 +1773,14 @@ bool ConnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValida
     // Set best block to current account cache.
     cw.blockCache.SetBestBlock(pIndex->GetBlockHash());
 
+    CacheBlockSummary(block);
+
+    // every state change of the block is in its undo data, as DisconnectBlock() relies on it
+    if (pChangedKeys != nullptr) {
+        for (const auto &txUndo : blockUndo.vtxundo)
+            pChangedKeys->AddWrites(txUndo.dbOpLogMap);
+    }
+
     return true;
 }
 
@@ -1335,6 +1822,7 @@ bool static WriteChainState(CValidationState &state) {
 // Update chainActive and related internal data structures.
 void static UpdateTip(CBlockIndex *pIndexNew, const CBlock &block) {
     chainActive.SetTip(pIndexNew);
+    nTipBlockTime = pIndexNew->GetBlockTime();
 
     SyncTransaction(uint256(), nullptr, &block);
 
@@ -1377,10 +1865,11 @@ bool static DisconnectTip(CValidationState &state) {
         return state.Abort(_("Failed to read blocks from disk."));
     // Apply the block atomically to the chain state.
     int64_t nStart = GetTimeMicros();
+    CDbKeySet changedKeys;
     {
         auto spCW = std::make_shared<CCacheWrapper>(pCdMan);
 
-        if (!DisconnectBlock(block, *spCW, pIndexDelete, state))
+        if (!DisconnectBlock(block, *spCW, pIndexDelete, state, nullptr, &changedKeys))
             return ERRORMSG("DisconnectTip() : DisconnectBlock %s failed", pIndexDelete->GetBlockHash().ToString());
 
         // Need to re-sync all to global cache layer.
@@ -1402,7 +1891,11 @@ bool static DisconnectTip(CValidationState &state) {
         return false;
     // Update chainActive and related variables.
     UpdateTip(pIndexDelete->pprev, block);
+    // Let the resurrected transactions see the restored state, the mempool transactions depending
+    // on it are executed again by ReScanMemPoolTx().
+    mempool.InvalidateKeys(changedKeys);
     // Resurrect mempool transactions from the disconnected block.
+    PreVerifyTxSignatures(block.vptx, *mempool.cw);
     for (const auto &pTx : block.vptx) {
         list<std::shared_ptr<CBaseTx> > removed;
         CValidationState stateDummy;
@@ -1414,6 +1907,7 @@ bool static DisconnectTip(CValidationState &state) {
             EraseTransaction(pTx->GetHash());
         }
     }
+    mempool.TrimToSize(GetMaxMempoolSize());
 
     return true;
 }
@@ -1428,11 +1922,17 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pIndexNew) {
 
     // Apply the block automatically to the chain state.
     int64_t nStart = GetTimeMicros();
+    CDbKeySet changedKeys;
     {
         CInv inv(MSG_BLOCK, pIndexNew->GetBlockHash());
 
+        std::shared_ptr<CPreExecutedBlock> spPreExecuted;
+        if (spPreExecutedBlock != nullptr && spPreExecutedBlock->blockHash == pIndexNew->GetBlockHash())
+            spPreExecuted = spPreExecutedBlock;
+        spPreExecutedBlock.reset();
+
         auto spCW = std::make_shared<CCacheWrapper>(pCdMan);
-        if (!ConnectBlock(block, *spCW, pIndexNew, state)) {
+        if (!ConnectBlock(block, *spCW, pIndexNew, state, false, &changedKeys, spPreExecuted.get())) {
             if (state.IsInvalid()) {
                 InvalidBlockFound(pIndexNew, state);
             }
@@ -1458,9 +1958,9 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pIndexNew) {
     // Update chainActive & related variables.
     UpdateTip(pIndexNew, block);
 
-    for (auto &pTxItem : block.vptx) {
-        mempool.memPoolTxs.erase(pTxItem->GetHash());
-    }
+    mempool.Erase(block.vptx);
+    // the mempool transactions depending on the changed state are executed again by ReScanMemPoolTx()
+    mempool.InvalidateKeys(changedKeys);
     return true;
 }
 
@@ -2236,6 +2736,13 @@ bool ProcessBlock(CValidationState &state, CNode *pFrom, CBlock *pBlock, CDiskBl
                 setOrphanBlock.insert(pblock2);
             }
 
+            // The blocks of the header chain arrive ahead of their parents, which are already being downloaded
+            if (headerChain.Contains(blockHash, blockHeight)) {
+                LogPrint(BCLog::NET, "receive a block of the header chain ahead of its parent height=%d hash=%s, %s it\n",
+                         blockHeight, blockHash.GetHex(), success ? "keep" : "abandon");
+                return true;
+            }
+
             // Ask this guy to fill in what we're missing
             LogPrint(BCLog::NET,
                      "receive an orphan block height=%d hash=%s, %s it, leading to getblocks (current block height=%d, "
@@ -2363,6 +2870,7 @@ bool static LoadBlockIndexDB() {
     }
 
     chainActive.SetTip(it->second);
+    nTipBlockTime = it->second->GetBlockTime();
   //  chainActive.UpdateFinalityBlock();
     LogPrint(BCLog::INFO, "LoadBlockIndexDB(): hashBestChain=%s height=%d date=%s\n",
              chainActive.Tip()->GetBlockHash().ToString(), chainActive.Height(),
@@ -2466,6 +2974,7 @@ void UnloadBlockIndex() {
     mapBlockIndex.clear();
     setBlockIndexValid.clear();
     chainActive.SetTip(nullptr);
+    nTipBlockTime     = 0;
     pIndexBestInvalid = nullptr;
 }
 
@@ -2721,6 +3230,8 @@ bool EraseBlockIndexFromSet(CBlockIndex *pIndex) {
     return setBlockIndexValid.erase(pIndex) > 0;
 }
 
+int64_t GetTipBlockTime() { return nTipBlockTime; }
+
 bool IsInitialBlockDownload() {
     LOCK(cs_main);
     if (SysCfg().IsImporting() ||
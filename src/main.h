@@ -29,6 +29,7 @@
 #include "chain/merkletree.h"
 #include "net.h"
 #include "p2p/node.h"
+#include "persistence/blockundo.h"
 #include "persistence/cachewrapper.h"
 #include "sigcache.h"
 #include "tx/tx.h"
@@ -54,6 +55,7 @@ extern bool ReadBlockFromDisk(const CBlockIndex *pIndex, CBlock &block) ;
 extern bool mining;     // could be changed due to vote change
 extern CKeyID minerKeyId;  // miner accout keyId
 extern CKeyID nodeKeyId;   // first keyId of the node
+extern int32_t nSigCheckThreads;
 
 class CValidationState;
 class CWalletInterface;
@@ -96,8 +98,10 @@ bool CheckDiskSpace(uint64_t nAdditionalBytes = 0);
 /** Verify consistency of the block and coin databases */
 bool VerifyDB(int32_t nCheckLevel, int32_t nCheckDepth);
 
-/** Run an instance of the script checking thread */
-void ThreadScriptCheck();
+/** Run an instance of the signature checking thread */
+void ThreadSigCheck();
+/** Run an instance of the thread executing groups of block txs */
+void ThreadTxGroupCheck();
 
 /** Format a string that describes several potential problems detected by the core */
 string GetWarnings(string strFor);
@@ -115,9 +119,32 @@ void Misbehaving(NodeId nodeid, int32_t howmuch);
 
 bool VerifySignature(const uint256 &sigHash, const std::vector<uint8_t> &signature, const CPubKey &pubKey);
 
+/** Verify a batch of signatures through the signature cache: cached items are skipped, the
+ *  others are verified together and the valid ones are added to the cache. */
+bool VerifySignatureBatch(CSignatureBatch &batch);
+
+/** Pre-verify the signatures of the given txs on the signature checking threads (best effort). */
+void PreVerifyTxSignatures(const vector<std::shared_ptr<CBaseTx>> &vptx, CCacheWrapper &cw);
+
+/** Closure representing a slice of signature verifications, to be run by the signature checking threads. */
+class CSignatureCheck {
+private:
+    CSignatureBatch batch;
+
+public:
+    CSignatureCheck() {}
+    explicit CSignatureCheck(CSignatureBatch &batchIn) { batch.swap(batchIn); }
+
+    bool operator()() { return VerifySignatureBatch(batch); }
+
+    void swap(CSignatureCheck &check) { batch.swap(check.batch); }
+};
+
 /** (try to) add transaction to memory pool **/
 bool AcceptToMemoryPool(CTxMemPool &pool, CValidationState &state, CBaseTx *pBaseTx,
                         bool fLimitFree, bool fRejectInsaneFee = false);
+/** the memory budget of the mempool in bytes, from -maxmempool */
+size_t GetMaxMempoolSize();
 
 struct CNodeStateStats {
     int32_t nMisbehavior;
@@ -129,6 +156,8 @@ struct CNodeStateStats {
 bool IsStandardTx(CBaseTx *pBaseTx, string &reason);
 
 bool IsInitialBlockDownload();
+/** Block time of the active chain tip, readable without cs_main */
+int64_t GetTipBlockTime();
 
 /** Capture information about block/transaction validation */
 class CValidationState {
@@ -209,15 +238,36 @@ protected:
     friend void ::UnregisterAllWallets();
 };
 
+// The state a block packed by this node leaves after its txs but the reward tx, so that connecting the
+// block doesn't execute them again
+struct CPreExecutedBlock {
+    uint256 blockHash;
+    uint256 prevBlockHash;
+    // child of the chain state caches of the tip the block was packed on
+    std::shared_ptr<CCacheWrapper> spCW;
+    // undo and run steps of the txs but the reward tx, in block order
+    vector<CTxUndo> txUndos;
+    vector<uint64_t> runSteps;
+};
+// Hand the state of the block packed by this node to the connect of the block
+void SetPreExecutedBlock(std::shared_ptr<CPreExecutedBlock> spBlock);
+
 /** Functions for validating blocks and updating the block tree */
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  In case pfClean is provided, operation will try to be tolerant about errors, and *pfClean
  *  will be true if no problems were found. Otherwise, the return value will be false in case
- *  of problems. Note that in any case, coins may be modified. */
-bool DisconnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValidationState &state, bool *pfClean = nullptr);
-// Apply the effects of this block (with given index) on the UTXO set represented by coins
-bool ConnectBlock   (CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValidationState &state, bool fJustCheck = false);
+ *  of problems. Note that in any case, coins may be modified. The keys of the state restored by
+ *  the undo data are added to pChangedKeys if provided. */
+bool DisconnectBlock(CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValidationState &state, bool *pfClean = nullptr,
+                     CDbKeySet *pChangedKeys = nullptr);
+// Apply the effects of this block (with given index) on the UTXO set represented by coins, adding the
+// keys of the state it writes to pChangedKeys if provided. When pPreExecuted is the state of the txs of the
+// block, cw must be a child of the same caches, and the txs are not executed again.
+bool ConnectBlock   (CBlock &block, CCacheWrapper &cw, CBlockIndex *pIndex, CValidationState &state, bool fJustCheck = false,
+                     CDbKeySet *pChangedKeys = nullptr, const CPreExecutedBlock *pPreExecuted = nullptr);
+// Keep what later connects need from the block, so they don't read it from disk again
+void CacheBlockSummary(const CBlock &block);
 
 // Add this block to the block index, and if necessary, switch the active block chain to this
 bool AddToBlockIndex(CBlock &block, CValidationState &state, const CDiskBlockPos &pos);
@@ -5,6 +5,7 @@
 
 #include "miner.h"
 
+#include "checkqueue.h"
 #include "pbftcontext.h"
 #include "init.h"
 #include "main.h"
@@ -19,6 +20,8 @@
 #include "p2p/protocol.h"
 
 #include <algorithm>
+#include <deque>
+#include <thread>
 #include <boost/circular_buffer.hpp>
 
 extern CWallet *pWalletMain;
@@ -34,6 +37,12 @@ boost::circular_buffer<MinedBlockInfo> minedBlocks(MAX_MINED_BLOCK_COUNT);
 CCriticalSection csMinedBlocks;
 
 
+// the time left to pack the new block out of the limit time (the block interval less 1s, 1s at least)
+static int64_t GetPackBlockTimeLeftMs(int64_t startMiningMs, int32_t blockHeight) {
+    int64_t limitedTimeMs = std::max(1000L, (int64_t)GetBlockInterval(blockHeight) * 1000L - 1000L);
+    return limitedTimeMs - (GetTimeMillis() - startMiningMs);
+}
+
 // check the time is not exceed the limit time (2s) for packing new block
 static bool CheckPackBlockTime(int64_t startMiningMs, int32_t blockHeight) {
     int64_t nowMs  = GetTimeMillis();
@@ -82,28 +91,272 @@ uint32_t GetElementForBurn(CBlockIndex *pIndex) {
     return newFuelRate;
 }
 
-// Sort transactions by priority and fee to decide priority orders to process transactions.
-void GetPriorityTx(int32_t height, set<TxPriority> &txPriorities, const int32_t nFuelRate) {
-    static TokenSymbol feeSymbol;
-    static uint64_t fee    = 0;
-    static uint32_t txSize = 0;
-    static double feePerKb = 0;
-    static double priority = 0;
-
-    for (map<uint256, CTxMemPoolEntry>::iterator mi = mempool.memPoolTxs.begin(); mi != mempool.memPoolTxs.end(); ++mi) {
-        CBaseTx *pBaseTx = mi->second.GetTransaction().get();
-        if (!pBaseTx->IsBlockRewardTx() && !pCdMan->pTxCache->HaveTx(pBaseTx->GetHash())) {
-            feeSymbol = std::get<0>(mi->second.GetFees());
-            fee       = std::get<1>(mi->second.GetFees());
-            txSize    = mi->second.GetTxSize();
-            feePerKb  = double(fee - pBaseTx->GetFuel(height, nFuelRate)) / txSize * 1000.0;
-            priority  = mi->second.GetPriority();
-
-            txPriorities.emplace(TxPriority(priority, feePerKb, mi->second.GetTransaction()));
+// Hands out the mempool txs by priority and fee, with the txs made by the block producer (e.g. the
+// price median tx) merged in. The mempool keeps its priority index sorted, so only the txs handed out
+// are visited. The earlier txs of the same txUid are handed out first, as a tx may depend on them, and
+// once one of them is not packed (SetPacked() not called) the rest of its chain is skipped.
+// Must be used with mempool.cs held.
+class CPriorityTxQueue {
+public:
+    // the txs of packedTxids are packed already and skipped
+    CPriorityTxQueue(const set<TxPriority> &extraTxsIn, const set<uint256> &packedTxids = set<uint256>())
+        : poolIt(mempool.GetPriorityIndex().rbegin()),
+          extraTxs(extraTxsIn),
+          extraIt(extraTxs.rbegin()),
+          handedOut(packedTxids) {}
+
+    const TxPriority* Next() {
+        if (pLast != nullptr && !fLastPacked) {
+            auto entryIt = mempool.memPoolTxs.find(pLast->txid);
+            if (entryIt != mempool.memPoolTxs.end()) {
+                failedSenders.insert(pLast->baseTx->txUid.ToString());
+                chainTxs.clear();
+            }
+        }
+        fLastPacked = false;
+
+        while (chainTxs.empty()) {
+            const TxPriority *pTxPriority = NextByPriority();
+            if (pTxPriority == nullptr) {
+                pLast.reset();
+                return nullptr;
+            }
+            QueueChain(*pTxPriority);
+        }
+
+        pLast.reset(new TxPriority(chainTxs.front()));
+        chainTxs.pop_front();
+        handedOut.insert(pLast->txid);
+        return pLast.get();
+    }
+
+    void SetPacked() { fLastPacked = true; }
+
+    // append the next count txs to txs without handing them out, to execute them ahead
+    void Peek(uint32_t count, vector<TxPriority> &txs) const {
+        for (auto it = chainTxs.begin(); it != chainTxs.end() && count > 0; it++, count--)
+            txs.push_back(*it);
+
+        for (auto it = poolIt; it != mempool.GetPriorityIndex().rend() && count > 0; it++) {
+            if (it->baseTx->IsBlockRewardTx() || handedOut.count(it->txid) ||
+                failedSenders.count(it->baseTx->txUid.ToString()) || pCdMan->pTxCache->HaveTx(it->txid))
+                continue;
+
+            txs.push_back(*it);
+            count--;
+        }
+    }
+
+private:
+    const TxPriority* NextByPriority() {
+        auto poolEnd = mempool.GetPriorityIndex().rend();
+        while (poolIt != poolEnd) {
+            if (extraIt != extraTxs.rend() && *poolIt < *extraIt)
+                return &*(extraIt++);
+
+            const TxPriority &txPriority = *(poolIt++);
+            if (!txPriority.baseTx->IsBlockRewardTx() && !pCdMan->pTxCache->HaveTx(txPriority.txid))
+                return &txPriority;
+        }
+
+        return extraIt != extraTxs.rend() ? &*(extraIt++) : nullptr;
+    }
+
+    // queue the tx after the earlier txs of its chain not handed out yet
+    void QueueChain(const TxPriority &txPriority) {
+        auto entryIt = mempool.memPoolTxs.find(txPriority.txid);
+        if (entryIt == mempool.memPoolTxs.end()) {
+            chainTxs.push_back(txPriority);
+            return;
+        }
+
+        string sender = txPriority.baseTx->txUid.ToString();
+        if (handedOut.count(txPriority.txid) || failedSenders.count(sender))
+            return;
+
+        auto senderIt = mempool.GetSenderIndex().find(sender);
+        if (senderIt != mempool.GetSenderIndex().end()) {
+            for (const auto &item : senderIt->second) {
+                if (item.first >= entryIt->second.GetSequence())
+                    break;
+                if (handedOut.count(item.second) || pCdMan->pTxCache->HaveTx(item.second))
+                    continue;
+
+                chainTxs.push_back(mempool.memPoolTxs.find(item.second)->second.GetTxPriority());
+            }
+        }
+        chainTxs.push_back(txPriority);
+    }
+
+private:
+    set<TxPriority>::const_reverse_iterator poolIt;
+    set<TxPriority> extraTxs;
+    set<TxPriority>::const_reverse_iterator extraIt;
+
+    deque<TxPriority> chainTxs;
+    set<uint256> handedOut;
+    set<string> failedSenders;
+    std::unique_ptr<TxPriority> pLast;
+    bool fLastPacked = false;
+};
+
+// A tx executed ahead of its turn on its own child of the block cache
+struct CSpeculativeTx {
+    std::shared_ptr<CBaseTx> pTx;
+    std::shared_ptr<CCacheWrapper> spCW;
+    CDBOpLogMap dbOpLogMap;
+    CDbKeySet readKeys;
+    CDbKeySet writeKeys;
+    bool fExecuted = false;
+    int64_t checkTxUs   = 0;
+    int64_t executeTxUs = 0;
+};
+
+// The block context the txs are executed ahead in
+struct CSpeculationContext {
+    CCacheWrapper *pCW;
+    int32_t height;
+    uint32_t fuelRate;
+    uint32_t blockTime;
+    uint32_t prevBlockTime;
+};
+
+class CSpeculativeTxCheck {
+public:
+    CSpeculativeTxCheck() {}
+    CSpeculativeTxCheck(const CSpeculationContext *pContextIn, CSpeculativeTx *pSpecTxIn)
+        : pContext(pContextIn), pSpecTx(pSpecTxIn) {}
+
+    bool operator()() {
+        CSpeculativeTx &specTx = *pSpecTx;
+        specTx.spCW = std::make_shared<CCacheWrapper>(pContext->pCW);
+        specTx.dbOpLogMap.SetReadKeys(&specTx.readKeys);
+        specTx.spCW->SetDbOpLogMap(&specTx.dbOpLogMap);
+
+        try {
+            CValidationState state;
+            // the tx types executed ahead don't depend on their index in the block
+            CTxExecuteContext context(pContext->height, 0, pContext->fuelRate, pContext->blockTime,
+                                      pContext->prevBlockTime, specTx.spCW.get(), &state,
+                                      transaction_status_type::mining);
+            int64_t startUs  = GetTimeMicros();
+            specTx.fExecuted = specTx.pTx->CheckTx(context);
+            specTx.checkTxUs = GetTimeMicros() - startUs;
+            if (specTx.fExecuted) {
+                startUs            = GetTimeMicros();
+                specTx.fExecuted   = specTx.pTx->ExecuteTx(context);
+                specTx.executeTxUs = GetTimeMicros() - startUs;
+            }
+        } catch (std::exception &e) {
+            specTx.fExecuted = false;
         }
+        if (CConcurrentReads::TakeRangeReadRefused())
+            specTx.fExecuted = false;
+
+        specTx.spCW->SetDbOpLogMap(nullptr);
+        specTx.writeKeys.AddWrites(specTx.dbOpLogMap);
+        return true;
     }
+
+    void swap(CSpeculativeTxCheck &check) {
+        std::swap(pContext, check.pContext);
+        std::swap(pSpecTx, check.pSpecTx);
+    }
+
+private:
+    const CSpeculationContext *pContext = nullptr;
+    CSpeculativeTx *pSpecTx = nullptr;
+};
+
+static CCheckQueue<CSpeculativeTxCheck> speculativeTxQueue(4);
+static int32_t nPackThreads = 0;
+
+static void ThreadSpeculativeTx() {
+    RenameThread("Coin-packer");
+    speculativeTxQueue.Thread();
 }
 
+// Executes the next candidate txs of a block concurrently, each on its own child of the block cache,
+// while the txs before them are packed one at a time. The result of a tx is used in its turn if it
+// read and wrote none of the keys written by the txs packed since, otherwise the tx is executed again.
+// Must be used with cs_main held.
+class CTxSpeculator {
+public:
+    CTxSpeculator(CCacheWrapper &cwIn, int32_t height, uint32_t fuelRate, uint32_t blockTime, uint32_t prevBlockTime)
+        : context{&cwIn, height, fuelRate, blockTime, prevBlockTime} {}
+
+    bool IsEnabled() const { return nPackThreads > 1; }
+
+    bool Has(const uint256 &txid) const { return specTxs.count(txid) > 0; }
+
+    // number of txs worth executing ahead, the results of a round are invalidated as txs get packed
+    uint32_t GetRoundSize() const { return nPackThreads * 4; }
+
+    // execute the txs ahead on the current block cache, dropping the results of the last round
+    void Execute(const vector<TxPriority> &txs) {
+        specTxs.clear();
+        packedWrites.Clear();
+
+        vector<CSpeculativeTxCheck> checks;
+        for (const auto &txPriority : txs) {
+            if (!IsConcurrentTxType(txPriority.baseTx->nTxType) || specTxs.count(txPriority.txid))
+                continue;
+
+            auto &pSpecTx = specTxs[txPriority.txid];
+            pSpecTx.reset(new CSpeculativeTx());
+            pSpecTx->pTx            = txPriority.baseTx;
+            pSpecTx->pTx->nFuelRate = context.fuelRate;
+            checks.emplace_back(&context, pSpecTx.get());
+        }
+
+        int64_t startMs = GetTimeMillis();
+        {
+            CConcurrentReads concurrentReads;
+            CCheckQueueControl<CSpeculativeTxCheck> control(&speculativeTxQueue);
+            control.Add(checks);
+            control.Wait();
+        }
+
+        LogPrint(BCLog::MINER, "CTxSpeculator::Execute() : executed %u txs ahead in %lld ms, height=%d\n",
+                 specTxs.size(), GetTimeMillis() - startMs, context.height);
+    }
+
+    // take the result of the tx if it is still valid
+    std::unique_ptr<CSpeculativeTx> Take(const uint256 &txid) {
+        auto it = specTxs.find(txid);
+        if (it == specTxs.end())
+            return nullptr;
+
+        std::unique_ptr<CSpeculativeTx> pSpecTx = std::move(it->second);
+        specTxs.erase(it);
+        if (!pSpecTx->fExecuted || pSpecTx->readKeys.Intersects(packedWrites) ||
+            pSpecTx->writeKeys.Intersects(packedWrites)) {
+            nConflicts++;
+            return nullptr;
+        }
+
+        nHits++;
+        return pSpecTx;
+    }
+
+    // the keys written by a packed tx
+    void AddPackedWrites(const CDbKeySet &writeKeys) {
+        if (!specTxs.empty())
+            packedWrites.Add(writeKeys);
+    }
+
+    uint32_t GetHits() const { return nHits; }
+    uint32_t GetConflicts() const { return nConflicts; }
+
+private:
+    CSpeculationContext context;
+    map<uint256, std::unique_ptr<CSpeculativeTx>> specTxs;
+    // written by the txs packed since the last round
+    CDbKeySet packedWrites;
+    uint32_t nHits      = 0;
+    uint32_t nConflicts = 0;
+};
+
 
 bool GetCurrentDelegate(const int64_t currentTime, const int32_t currHeight, const VoteDelegateVector &delegates,
                                VoteDelegate &delegate) {
@@ -313,18 +566,17 @@ static bool CreateNewBlockPreStableCoinRelease(CCacheWrapper &cwIn, std::unique_
         uint64_t totalFuel      = 0;
         uint64_t reward         = 0;
 
-        // Calculate && sort transactions from memory pool.
-        set<TxPriority> txPriorities;
-        GetPriorityTx(height, txPriorities, fuelRate);
+        // Transactions from memory pool, sorted by priority.
+        CPriorityTxQueue txQueue({});
 
         LogPrint(BCLog::MINER, "CreateNewBlockPreStableCoinRelease() : got %lu transaction(s) sorted by priority rules\n",
-                 txPriorities.size());
+                 mempool.memPoolTxs.size());
 
         // Collect transactions into the block.
-        for (auto itor = txPriorities.rbegin(); itor != txPriorities.rend(); ++itor) {
-            CBaseTx *pBaseTx = itor->baseTx.get();
+        while (const TxPriority *pTxPriority = txQueue.Next()) {
+            CBaseTx *pBaseTx = pTxPriority->baseTx.get();
 
-            uint32_t txSize = pBaseTx->GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION);
+            uint32_t txSize = pBaseTx->GetSerializedSize();
             if (totalBlockSize + txSize >= nBlockMaxSize) {
                 LogPrint(BCLog::MINER, "CreateNewBlockPreStableCoinRelease() : exceed max block size, txid: %s\n",
                          pBaseTx->GetHash().GetHex());
@@ -374,7 +626,8 @@ static bool CreateNewBlockPreStableCoinRelease(CCacheWrapper &cwIn, std::unique_
 
             ++index;
 
-            pBlock->vptx.push_back(itor->baseTx);
+            pBlock->vptx.push_back(pTxPriority->baseTx);
+            txQueue.SetPacked();
 
             LogPrint(BCLog::DEBUG, "miner total fuel fee:%d, tx fuel fee:%d, fuel:%d, fuelRate:%d, txid:%s\n", totalFuel,
                      pBaseTx->GetFuel(height, fuelRate), pBaseTx->nRunStep, fuelRate, pBaseTx->GetHash().GetHex());
@@ -422,9 +675,86 @@ static bool CreateStableCoinGenesisBlock(std::unique_ptr<CBlock> &pBlock) {
     return true;
 }
 
-static bool CreateNewBlockStableCoinRelease(int64_t startMiningMs, CCacheWrapper &cwIn, std::unique_ptr<CBlock> &pBlock) {
-    pBlock->vptx.push_back(std::make_shared<CUCoinBlockRewardTx>());
+// Average time in microseconds it takes to check, execute and flush a tx of the type when packing, so that
+// the types which can't make it in the time left are skipped. Guarded by cs_main.
+static map<TxType, int64_t> txTypePackCosts;
+
+static void UpdateTxTypePackCosts(const BlockPackStats &stats) {
+    for (const auto &item : stats.txTypeStats) {
+        const TxTypePackStats &typeStats = item.second;
+        if (typeStats.executed == 0)
+            continue;
+
+        int64_t cost  = (typeStats.checkTxUs + typeStats.executeTxUs + typeStats.flushUs) / typeStats.executed;
+        auto ret      = txTypePackCosts.emplace(item.first, cost);
+        // the recent blocks weigh more
+        if (!ret.second)
+            ret.first->second = (ret.first->second * 3 + cost) / 4;
+    }
+}
+
+void TxTypePackStats::Add(const TxTypePackStats &other) {
+    considered += other.considered;
+    executed += other.executed;
+    rejected += other.rejected;
+    skipped += other.skipped;
+    packed += other.packed;
+    checkTxUs += other.checkTxUs;
+    executeTxUs += other.executeTxUs;
+    flushUs += other.flushUs;
+}
+
+void BlockPackStats::Add(const BlockPackStats &other) {
+    packTimeUs += other.packTimeUs;
+    packRounds += other.packRounds;
+    timeUsedUp = timeUsedUp || other.timeUsedUp;
+    for (const auto &item : other.txTypeStats)
+        txTypeStats[item.first].Add(item.second);
+}
 
+// A block packed on top of a tip for a block time, with the state after its txs, so that the txs
+// arriving afterwards can be packed into it as well. Must be used with cs_main held.
+struct CBlockTemplate {
+    std::unique_ptr<CBlock> pBlock;
+    std::shared_ptr<CCacheWrapper> spCW;
+    CBlockIndex *pIndexPrev;
+    int32_t height;
+    uint32_t fuelRate;
+    uint64_t totalBlockSize = 0;
+    uint64_t totalRunStep   = 0;
+    uint64_t totalFees      = 0;
+    uint64_t totalFuel      = 0;
+    map<TokenSymbol, uint64_t> rewards = {{SYMB::WICC, 0}, {SYMB::WUSD, 0}};
+    set<uint256> packedTxids;
+    // undo and run steps of the packed txs, in block order
+    vector<CTxUndo> txUndos;
+    vector<uint64_t> runSteps;
+    // the mempool updates the txs were collected at, see CTxMemPool::GetTransactionsUpdated()
+    uint64_t nTransactionsUpdated = 0;
+    uint32_t nPackRounds          = 0;
+    BlockPackStats packStats;
+
+    CBlockTemplate(CBlockIndex *pIndexPrevIn, uint32_t blockTime)
+        : pBlock(new CBlock()),
+          spCW(std::make_shared<CCacheWrapper>(pCdMan)),
+          pIndexPrev(pIndexPrevIn),
+          height(pIndexPrevIn->height + 1),
+          fuelRate(GetElementForBurn(pIndexPrevIn)) {
+        pBlock->SetTime(blockTime);
+        pBlock->vptx.push_back(std::make_shared<CUCoinBlockRewardTx>());
+        totalBlockSize = ::GetSerializeSize(*pBlock, SER_NETWORK, PROTOCOL_VERSION);
+    }
+
+    bool IsFor(const CBlockIndex *pIndex, uint32_t blockTime) const {
+        return pIndex == pIndexPrev && blockTime == pBlock->GetTime();
+    }
+};
+
+// the template the block template builder keeps for the next slot, guarded by cs_main
+static std::unique_ptr<CBlockTemplate> pNextBlockTemplate;
+
+// Pack the mempool txs not in the template yet into it
+static bool PackBlockTemplate(int64_t startMiningMs, CBlockTemplate &tmpl) {
     // Largest block you're willing to create:
     uint32_t nBlockMaxSize = SysCfg().GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE);
     // Limit to between 1K and MAX_BLOCK_SIZE-1K for sanity:
@@ -434,131 +764,248 @@ static bool CreateNewBlockStableCoinRelease(int64_t startMiningMs, CCacheWrapper
     {
         LOCK2(cs_main, mempool.cs);
 
-        CBlockIndex *pIndexPrev            = chainActive.Tip();
-        uint32_t blockTime                 = pBlock->GetTime();
-        int32_t height                     = pIndexPrev->height + 1;
-        int32_t index                      = 0; // 0: block reward tx
-        uint32_t fuelRate                  = GetElementForBurn(pIndexPrev);
-        uint64_t totalBlockSize            = ::GetSerializeSize(*pBlock, SER_NETWORK, PROTOCOL_VERSION);
-        uint64_t totalRunStep              = 0;
-        uint64_t totalFees                 = 0;
-        uint64_t totalFuel                 = 0;
-        map<TokenSymbol, uint64_t> rewards = {{SYMB::WICC, 0}, {SYMB::WUSD, 0}};
+        uint64_t nTransactionsUpdated = mempool.GetTransactionsUpdated();
+        if (tmpl.nPackRounds > 0 && tmpl.nTransactionsUpdated == nTransactionsUpdated)
+            return true;
 
-        // Calculate && sort transactions from memory pool.
-        set<TxPriority> txPriorities;
-        GetPriorityTx(height, txPriorities, fuelRate);
+        CBlockIndex *pIndexPrev = tmpl.pIndexPrev;
+        CBlock *pBlock          = tmpl.pBlock.get();
+        CCacheWrapper &cwIn     = *tmpl.spCW;
+        uint32_t blockTime      = pBlock->GetTime();
+        int32_t height          = tmpl.height;
+        uint32_t fuelRate       = tmpl.fuelRate;
+        int32_t index           = pBlock->vptx.size() - 1; // 0: block reward tx
+        size_t nPackedBefore    = tmpl.packedTxids.size();
+
+        // Transactions from memory pool sorted by priority, with the block price median transaction pushed
+        // into the queue on the first round.
+        set<TxPriority> extraTxs;
+        if (tmpl.nPackRounds == 0)
+            extraTxs.insert(TxPriority(PRICE_MEDIAN_TRANSACTION_PRIORITY, 0, std::make_shared<CBlockPriceMedianTx>(height)));
+        CPriorityTxQueue txQueue(extraTxs, tmpl.packedTxids);
 
-        // Push block price median transaction into queue.
-        txPriorities.emplace(TxPriority(PRICE_MEDIAN_TRANSACTION_PRIORITY, 0, std::make_shared<CBlockPriceMedianTx>(height)));
+        LogPrint(BCLog::MINER, "PackBlockTemplate() : got %lu transaction(s) sorted by priority rules, %lu packed already\n",
+                 mempool.memPoolTxs.size() + extraTxs.size(), tmpl.packedTxids.size());
 
-        LogPrint(BCLog::MINER, "CreateNewBlockStableCoinRelease() : got %lu transaction(s) sorted by priority rules\n",
-                 txPriorities.size());
+        CTxSpeculator speculator(cwIn, height, fuelRate, blockTime, pIndexPrev->GetBlockTime());
+        BlockPackStats roundStats;
+        int64_t roundStartUs = GetTimeMicros();
 
         // Collect transactions into the block.
-        for (auto itor = txPriorities.rbegin(); itor != txPriorities.rend(); ++itor) {
+        while (const TxPriority *pTxPriority = txQueue.Next()) {
 
             if (!CheckPackBlockTime(startMiningMs, height)) {
                 LogPrint(BCLog::MINER, "%s() : no time left to pack more tx, ignore! height=%d, start_ms=%lld, tx_count=%u\n",
                     __FUNCTION__, height, startMiningMs, pBlock->vptx.size());
+                roundStats.timeUsedUp = true;
                 break;
             }
 
-            CBaseTx *pBaseTx = itor->baseTx.get();
+            CBaseTx *pBaseTx = pTxPriority->baseTx.get();
+            TxTypePackStats &typeStats = roundStats.txTypeStats[pBaseTx->nTxType];
+            typeStats.considered++;
 
-            uint32_t txSize = pBaseTx->GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION);
-            if (totalBlockSize + txSize >= nBlockMaxSize) {
-                LogPrint(BCLog::MINER, "CreateNewBlockStableCoinRelease() : exceed max block size, txid: %s\n",
+            uint32_t txSize = pBaseTx->GetSerializedSize();
+            if (tmpl.totalBlockSize + txSize >= nBlockMaxSize) {
+                LogPrint(BCLog::MINER, "PackBlockTemplate() : exceed max block size, txid: %s\n",
                          pBaseTx->GetHash().GetHex());
+                typeStats.rejected++;
                 continue;
             }
 
-            auto spCW = std::make_shared<CCacheWrapper>(&cwIn);
+            // don't try the txs of a type taking longer than the time left, unless executed ahead already
+            auto costIt = txTypePackCosts.find(pBaseTx->nTxType);
+            if (costIt != txTypePackCosts.end() && !speculator.Has(pTxPriority->txid) &&
+                costIt->second / 1000 > GetPackBlockTimeLeftMs(startMiningMs, height)) {
+                LogPrint(BCLog::MINER, "PackBlockTemplate() : skip tx taking %lld us with the time left, txid: %s\n",
+                         costIt->second, pBaseTx->GetHash().GetHex());
+                typeStats.skipped++;
+                continue;
+            }
+
+            // execute the next txs ahead when this one hasn't been
+            if (speculator.IsEnabled() && IsConcurrentTxType(pBaseTx->nTxType) && !speculator.Has(pTxPriority->txid)) {
+                vector<TxPriority> txs = {*pTxPriority};
+                txQueue.Peek(speculator.GetRoundSize() - 1, txs);
+                speculator.Execute(txs);
+            }
+            std::unique_ptr<CSpeculativeTx> pSpecTx = speculator.Take(pTxPriority->txid);
+
+            auto spCW = pSpecTx != nullptr ? pSpecTx->spCW : std::make_shared<CCacheWrapper>(&cwIn);
+            // the undo of the tx, the keys it writes also invalidate the results of the txs executed ahead
+            CDBOpLogMap dbOpLogMap;
+            if (pSpecTx == nullptr)
+                spCW->SetDbOpLogMap(&dbOpLogMap);
 
             try {
                 CValidationState state;
 
                 pBaseTx->nFuelRate = fuelRate;
 
-                // Special case for price median tx,
-                if (pBaseTx->IsPriceMedianTx()) {
-                    CBlockPriceMedianTx *pPriceMedianTx = (CBlockPriceMedianTx *)itor->baseTx.get();
-
-                    PriceMap medianPrices;
-                    if (!spCW->ppCache.CalcBlockMedianPrices(*spCW, height, medianPrices))
-                        return ERRORMSG("%s(), calculate block median prices error", __func__);
-
-                    pPriceMedianTx->SetMedianPrices(medianPrices);
-                }
-
-                LogPrint(BCLog::MINER, "CreateNewBlockStableCoinRelease() : begin to pack transaction: %s\n",
-                         pBaseTx->ToString(spCW->accountCache));
-
-                uint32_t prevBlockTime = pIndexPrev->GetBlockTime();
-                CTxExecuteContext context(height, index + 1, fuelRate, blockTime, prevBlockTime, spCW.get(), &state, transaction_status_type::mining);
-                if (!pBaseTx->CheckTx(context) || !pBaseTx->ExecuteTx(context)) {
-                    LogPrint(BCLog::MINER, "CreateNewBlockStableCoinRelease() : failed to pack transaction: %s\n",
+                if (pSpecTx != nullptr) {
+                    LogPrint(BCLog::MINER, "PackBlockTemplate() : pack transaction executed ahead: %s\n",
+                             pBaseTx->GetHash().GetHex());
+                    typeStats.executed++;
+                    typeStats.checkTxUs += pSpecTx->checkTxUs;
+                    typeStats.executeTxUs += pSpecTx->executeTxUs;
+                } else {
+                    // Special case for price median tx,
+                    if (pBaseTx->IsPriceMedianTx()) {
+                        CBlockPriceMedianTx *pPriceMedianTx = (CBlockPriceMedianTx *)pTxPriority->baseTx.get();
+
+                        PriceMap medianPrices;
+                        if (!spCW->ppCache.CalcBlockMedianPrices(*spCW, height, medianPrices))
+                            return ERRORMSG("%s(), calculate block median prices error", __func__);
+
+                        pPriceMedianTx->SetMedianPrices(medianPrices);
+                        // the prices change its size
+                        pPriceMedianTx->GetSerializedSize(true);
+                    }
+
+                    LogPrint(BCLog::MINER, "PackBlockTemplate() : begin to pack transaction: %s\n",
                              pBaseTx->ToString(spCW->accountCache));
 
-                    pCdMan->pLogCache->SetExecuteFail(height, pBaseTx->GetHash(), state.GetRejectCode(),
-                                                      state.GetRejectReason());
-                    continue;
+                    uint32_t prevBlockTime = pIndexPrev->GetBlockTime();
+                    CTxExecuteContext context(height, index + 1, fuelRate, blockTime, prevBlockTime, spCW.get(), &state, transaction_status_type::mining);
+                    int64_t startUs = GetTimeMicros();
+                    bool fOk        = pBaseTx->CheckTx(context);
+                    typeStats.checkTxUs += GetTimeMicros() - startUs;
+                    if (fOk) {
+                        startUs = GetTimeMicros();
+                        fOk     = pBaseTx->ExecuteTx(context);
+                        typeStats.executeTxUs += GetTimeMicros() - startUs;
+                    }
+                    typeStats.executed++;
+
+                    if (!fOk) {
+                        LogPrint(BCLog::MINER, "PackBlockTemplate() : failed to pack transaction: %s\n",
+                                 pBaseTx->ToString(spCW->accountCache));
+
+                        pCdMan->pLogCache->SetExecuteFail(height, pBaseTx->GetHash(), state.GetRejectCode(),
+                                                          state.GetRejectReason());
+                        typeStats.rejected++;
+                        continue;
+                    }
                 }
 
                 // Run step limits
-                if (totalRunStep + pBaseTx->nRunStep >= MAX_BLOCK_RUN_STEP) {
-                    LogPrint(BCLog::MINER, "CreateNewBlockStableCoinRelease() : exceed max block run steps, txid: %s\n",
+                if (tmpl.totalRunStep + pBaseTx->nRunStep >= MAX_BLOCK_RUN_STEP) {
+                    LogPrint(BCLog::MINER, "PackBlockTemplate() : exceed max block run steps, txid: %s\n",
                             pBaseTx->GetHash().GetHex());
+                    typeStats.rejected++;
                     continue;
                 }
             } catch (std::exception &e) {
-                LogPrint(BCLog::ERROR, "CreateNewBlockStableCoinRelease() : unexpected exception: %s\n", e.what());
+                LogPrint(BCLog::ERROR, "PackBlockTemplate() : unexpected exception: %s\n", e.what());
 
+                typeStats.rejected++;
                 continue;
             }
 
+            spCW->SetDbOpLogMap(nullptr);
+            int64_t flushStartUs = GetTimeMicros();
             spCW->Flush();
+            typeStats.flushUs += GetTimeMicros() - flushStartUs;
+            if (pSpecTx != nullptr) {
+                speculator.AddPackedWrites(pSpecTx->writeKeys);
+                dbOpLogMap.GetMap().swap(pSpecTx->dbOpLogMap.GetMap());
+            } else if (speculator.IsEnabled()) {
+                CDbKeySet writeKeys;
+                writeKeys.AddWrites(dbOpLogMap);
+                speculator.AddPackedWrites(writeKeys);
+            }
+            tmpl.txUndos.emplace_back(pBaseTx->GetHash());
+            tmpl.txUndos.back().dbOpLogMap.GetMap().swap(dbOpLogMap.GetMap());
+            tmpl.runSteps.push_back(pBaseTx->nRunStep);
 
             auto fuel        = pBaseTx->GetFuel(height, fuelRate);
             auto fees_symbol = std::get<0>(pBaseTx->GetFees());
             auto fees        = std::get<1>(pBaseTx->GetFees());
             assert(fees_symbol == SYMB::WICC || fees_symbol == SYMB::WUSD);
 
-            totalBlockSize += txSize;
-            totalRunStep += pBaseTx->nRunStep;
-            totalFuel += fuel;
-            totalFees += fees;
+            tmpl.totalBlockSize += txSize;
+            tmpl.totalRunStep += pBaseTx->nRunStep;
+            tmpl.totalFuel += fuel;
+            tmpl.totalFees += fees;
             assert(fees >= fuel);
-            rewards[fees_symbol] += (fees - fuel);
+            tmpl.rewards[fees_symbol] += (fees - fuel);
 
             ++index;
 
-            pBlock->vptx.push_back(itor->baseTx);
+            pBlock->vptx.push_back(pTxPriority->baseTx);
+            tmpl.packedTxids.insert(pTxPriority->txid);
+            txQueue.SetPacked();
+            typeStats.packed++;
 
-            LogPrint(BCLog::DEBUG, "miner total fuel fee:%d, tx fuel fee:%d, fuel:%d, fuelRate:%d, txid:%s\n", totalFuel,
+            LogPrint(BCLog::DEBUG, "miner total fuel fee:%d, tx fuel fee:%d, fuel:%d, fuelRate:%d, txid:%s\n", tmpl.totalFuel,
                      pBaseTx->GetFuel(height, fuelRate), pBaseTx->nRunStep, fuelRate, pBaseTx->GetHash().GetHex());
 
         }
 
-        nLastBlockTx                   = index + 1;
-        nLastBlockSize                 = totalBlockSize;
+        tmpl.nTransactionsUpdated = nTransactionsUpdated;
+        tmpl.nPackRounds++;
+
+        roundStats.packTimeUs = GetTimeMicros() - roundStartUs;
+        roundStats.packRounds = 1;
+        tmpl.packStats.Add(roundStats);
+        UpdateTxTypePackCosts(roundStats);
 
-        ((CUCoinBlockRewardTx *)pBlock->vptx[0].get())->reward_fees = rewards;
+        ((CUCoinBlockRewardTx *)pBlock->vptx[0].get())->reward_fees = tmpl.rewards;
 
         // Fill in header
         pBlock->SetPrevBlockHash(pIndexPrev->GetBlockHash());
         pBlock->SetNonce(0);
         pBlock->SetHeight(height);
-        pBlock->SetFuel(totalFuel);
+        pBlock->SetFuel(tmpl.totalFuel);
         pBlock->SetFuelRate(fuelRate);
 
-        LogPrint(BCLog::INFO, "CreateNewBlockStableCoinRelease() : height=%d, tx=%d, totalBlockSize=%llu\n", height, index + 1,
-                 totalBlockSize);
+        LogPrint(BCLog::INFO, "PackBlockTemplate() : height=%d, tx=%d (%u new), totalBlockSize=%llu, round=%u\n", height,
+                 index + 1, tmpl.packedTxids.size() - nPackedBefore, tmpl.totalBlockSize, tmpl.nPackRounds);
+        if (speculator.IsEnabled())
+            LogPrint(BCLog::MINER, "PackBlockTemplate() : %u txs packed as executed ahead, %u executed again\n",
+                     speculator.GetHits(), speculator.GetConflicts());
     }
 
     return true;
 }
 
+static bool CreateNewBlockStableCoinRelease(int64_t startMiningMs, std::unique_ptr<CBlock> &pBlock,
+                                            std::shared_ptr<CPreExecutedBlock> &spPreExecuted,
+                                            BlockPackStats &packStats) {
+    LOCK(cs_main);
+
+    CBlockIndex *pIndexPrev = chainActive.Tip();
+    uint32_t blockTime      = pBlock->GetTime();
+
+    // finish the template built ahead for this slot when there is one
+    std::unique_ptr<CBlockTemplate> pTemplate;
+    if (pNextBlockTemplate != nullptr && pNextBlockTemplate->IsFor(pIndexPrev, blockTime)) {
+        pTemplate = std::move(pNextBlockTemplate);
+        LogPrint(BCLog::MINER, "CreateNewBlockStableCoinRelease() : use the block template built ahead, height=%d, "
+                 "tx_count=%u\n", pTemplate->height, pTemplate->pBlock->vptx.size());
+    } else {
+        pTemplate.reset(new CBlockTemplate(pIndexPrev, blockTime));
+    }
+    pNextBlockTemplate.reset();
+
+    if (!PackBlockTemplate(startMiningMs, *pTemplate))
+        return false;
+
+    nLastBlockTx   = pTemplate->pBlock->vptx.size();
+    nLastBlockSize = pTemplate->totalBlockSize;
+    pBlock         = std::move(pTemplate->pBlock);
+    packStats      = pTemplate->packStats;
+
+    // the state after the packed txs, to connect the block without executing them again
+    spPreExecuted                = std::make_shared<CPreExecutedBlock>();
+    spPreExecuted->prevBlockHash = pIndexPrev->GetBlockHash();
+    spPreExecuted->spCW          = pTemplate->spCW;
+    spPreExecuted->txUndos.swap(pTemplate->txUndos);
+    spPreExecuted->runSteps.swap(pTemplate->runSteps);
+
+    return true;
+}
+
 bool CheckWork(CBlock *pBlock) {
     // Print block information
     pBlock->Print();
@@ -625,6 +1072,7 @@ static bool ProduceBlock(int64_t startMiningMs, CBlockIndex *pPrevIndex, Miner &
     int64_t lastTime    = 0;
     bool success        = false;
     int32_t blockHeight = 0;
+    BlockPackStats packStats;
     std::unique_ptr<CBlock> pBlock(new CBlock());
     if (!pBlock.get())
         throw runtime_error("ProduceBlock() : failed to create new block");
@@ -649,6 +1097,7 @@ static bool ProduceBlock(int64_t startMiningMs, CBlockIndex *pPrevIndex, Miner &
 
         lastTime  = GetTimeMillis();
         auto spCW = std::make_shared<CCacheWrapper>(pCdMan);
+        std::shared_ptr<CPreExecutedBlock> spPreExecuted;
 
         pBlock->SetTime(MillisToSecond(startMiningMs));  // set block time first
 
@@ -657,7 +1106,7 @@ static bool ProduceBlock(int64_t startMiningMs, CBlockIndex *pPrevIndex, Miner &
         } else if (GetFeatureForkVersion(blockHeight) == MAJOR_VER_R1) {
             success = CreateNewBlockPreStableCoinRelease(*spCW, pBlock); // pre-stable coin release
         } else {
-            success = CreateNewBlockStableCoinRelease(startMiningMs, *spCW, pBlock);    // stable coin release
+            success = CreateNewBlockStableCoinRelease(startMiningMs, pBlock, spPreExecuted, packStats);    // stable coin release
         }
 
         if (!success) {
@@ -682,6 +1131,11 @@ static bool ProduceBlock(int64_t startMiningMs, CBlockIndex *pPrevIndex, Miner &
             "used_time_ms=%lld\n", blockHeight, miner.account.regid.ToString(), pBlock->vptx[0]->GetHash().ToString(),
             GetTimeMillis() - lastTime);
 
+        if (spPreExecuted != nullptr) {
+            spPreExecuted->blockHash = pBlock->GetHash();
+            SetPreExecutedBlock(spPreExecuted);
+        }
+
         lastTime = GetTimeMillis();
         success  = CheckWork(pBlock.get());
         if (!success) {
@@ -698,6 +1152,7 @@ static bool ProduceBlock(int64_t startMiningMs, CBlockIndex *pPrevIndex, Miner &
     {
         LOCK(csMinedBlocks);
         miningBlockInfo.Set(pBlock.get());
+        miningBlockInfo.packStats = packStats;
         minedBlocks.push_front(miningBlockInfo);
         miningBlockInfo.SetNull();
     }
@@ -708,6 +1163,65 @@ static bool ProduceBlock(int64_t startMiningMs, CBlockIndex *pPrevIndex, Miner &
     return true;
 }
 
+// Keep a block template ready on top of the tip for the next slot when it is one of this node, packing
+// the mempool txs into it as they arrive, so that at slot time the block producer only has to pack the
+// latest txs, create the reward tx and sign.
+void static ThreadBuildBlockTemplates() {
+    RenameThread("coin-blocktmpl");
+
+    // the last tip and block time checked for being a slot of this node
+    uint256 checkedTipHash;
+    int64_t checkedBlockTime = 0;
+    bool fOnDuty             = false;
+
+    while (true) {
+        MilliSleep(BLOCK_TEMPLATE_REFRESH_INTERVAL_MS);
+
+        if (SysCfg().IsReindex() || IsInitialBlockDownload())
+            continue;
+
+        CBlockIndex *pIndexPrev;
+        {
+            LOCK(cs_main);
+            pIndexPrev = chainActive.Tip();
+        }
+        if (pIndexPrev == nullptr)
+            continue;
+
+        int32_t blockHeight = pIndexPrev->height + 1;
+        if (blockHeight == (int32_t)SysCfg().GetStableCoinGenesisHeight() ||
+            GetFeatureForkVersion(blockHeight) == MAJOR_VER_R1)
+            continue;
+
+        // the time the block producer will stamp the next block with
+        int64_t interval  = GetBlockInterval(blockHeight);
+        int64_t nowTime   = MillisToSecond(GetTimeMillis());
+        int64_t blockTime = pIndexPrev->GetBlockTime() + interval;
+        if (blockTime <= nowTime)
+            blockTime = nowTime - nowTime % interval + interval;
+
+        if (pIndexPrev->GetBlockHash() != checkedTipHash || blockTime != checkedBlockTime) {
+            Miner miner;
+            uint32_t totalDelegateNum;
+            fOnDuty          = GetMiner(blockTime * 1000, blockHeight, miner, totalDelegateNum);
+            checkedTipHash   = pIndexPrev->GetBlockHash();
+            checkedBlockTime = blockTime;
+        }
+        if (!fOnDuty)
+            continue;
+
+        LOCK(cs_main);
+        if (chainActive.Tip() != pIndexPrev)
+            continue;
+
+        if (pNextBlockTemplate == nullptr || !pNextBlockTemplate->IsFor(pIndexPrev, blockTime))
+            pNextBlockTemplate.reset(new CBlockTemplate(pIndexPrev, blockTime));
+
+        if (!PackBlockTemplate(GetTimeMillis(), *pNextBlockTemplate))
+            pNextBlockTemplate.reset();
+    }
+}
+
 void static ThreadProduceBlocks(CWallet *pWallet, int32_t targetHeight) {
     LogPrint(BCLog::INFO, "ThreadProduceBlocks() : started\n");
 
@@ -827,6 +1341,22 @@ void GenerateProduceBlockThread(bool fGenerate, CWallet *pWallet, int32_t target
 
     minerThreads = new boost::thread_group();
     minerThreads->create_thread(boost::bind(&ThreadProduceBlocks, pWallet, targetHeight));
+
+    // -packthreads=0 means autodetect, but nPackThreads==0 means the txs are executed in their turn only
+    nPackThreads = SysCfg().GetArg("-packthreads", DEFAULT_PACK_THREADS);
+    if (nPackThreads <= 0)
+        nPackThreads += std::thread::hardware_concurrency();
+    if (nPackThreads <= 1)
+        nPackThreads = 0;
+    else if (nPackThreads > MAX_PACK_THREADS)
+        nPackThreads = MAX_PACK_THREADS;
+
+    // the thread producing blocks joins the queue as the last worker
+    for (int32_t i = 0; i < nPackThreads - 1; i++)
+        minerThreads->create_thread(&ThreadSpeculativeTx);
+
+    if (SysCfg().GetBoolArg("-blocktemplate", DEFAULT_BLOCK_TEMPLATE))
+        minerThreads->create_thread(&ThreadBuildBlockTemplates);
 }
 
 void MinedBlockInfo::SetNull() {
@@ -839,6 +1369,7 @@ void MinedBlockInfo::SetNull() {
     totalBlockSize = 0;
     hash.SetNull();
     hashPrevBlock.SetNull();
+    packStats = BlockPackStats();
 }
 
 void MinedBlockInfo::Set(const CBlock *pBlock) {
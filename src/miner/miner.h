@@ -16,6 +16,7 @@
 #include "entities/key.h"
 #include "commons/uint256.h"
 #include "tx/tx.h"
+#include "tx/txmempool.h"
 
 class CBlock;
 class CBlockIndex;
@@ -39,25 +40,28 @@ struct Miner {
     CKey key;
 };
 
-struct TxPriority {
-    double priority;
-    double feePerKb;
-    std::shared_ptr<CBaseTx> baseTx;
-
-    TxPriority(const double priorityIn, const double feePerKbIn, const std::shared_ptr<CBaseTx> &baseTxIn)
-        : priority(priorityIn), feePerKb(feePerKbIn), baseTx(baseTxIn) {}
-
-    bool operator<(const TxPriority &other) const {
-        if (fabs(this->priority - other.priority) <= 1000) {
-            if (fabs(this->feePerKb < other.feePerKb) <= 1e-8) {
-                return this->baseTx->GetHash() < other.baseTx->GetHash();
-            } else {
-                return this->feePerKb < other.feePerKb;
-            }
-        } else {
-            return this->priority < other.priority;
-        }
-    }
+// how the txs of a type went when packing a block
+struct TxTypePackStats {
+    uint32_t considered = 0;  // txs handed out by the tx queue
+    uint32_t executed   = 0;  // txs checked and executed, whatever the outcome
+    uint32_t rejected   = 0;  // txs failed to check or execute, or over the block limits
+    uint32_t skipped    = 0;  // txs not tried as the type takes longer than the time left to pack
+    uint32_t packed     = 0;  // txs packed into the block
+    int64_t checkTxUs   = 0;  // time spent in CheckTx()
+    int64_t executeTxUs = 0;  // time spent in ExecuteTx()
+    int64_t flushUs     = 0;  // time spent flushing the packed txs into the block cache
+
+    void Add(const TxTypePackStats &other);
+};
+
+// how the txs of a mined block were packed
+struct BlockPackStats {
+    int64_t packTimeUs = 0;   // time spent packing txs, over all the rounds
+    uint32_t packRounds = 0;  // times the txs arrived since were packed, including ahead of the slot
+    bool timeUsedUp     = false;
+    map<TxType, TxTypePackStats> txTypeStats;
+
+    void Add(const BlockPackStats &other);
 };
 
 // mined block info
@@ -72,6 +76,7 @@ public:
     uint64_t totalBlockSize;  // block size(bytes)
     uint256 hash;             // block hash
     uint256 hashPrevBlock;    // prev block has
+    BlockPackStats packStats; // how the txs were packed
 
 public:
     MinedBlockInfo() { SetNull(); }
@@ -93,8 +98,6 @@ bool CheckWork(CBlock *pBlock);
 /** Get burn element */
 uint32_t GetElementForBurn(CBlockIndex *pIndex);
 
-void GetPriorityTx(vector<TxPriority> &vecPriority, int32_t nFuelRate);
-
 void ShuffleDelegates(const int32_t nCurHeight, const int64_t blockTime,
         VoteDelegateVector &delegates);
 
@@ -11,6 +11,7 @@ CPBFTContext pbftContext ;
 
 bool CPBFTContext::GetMinerListByBlockHash(const uint256 blockHash, set<CRegID>& miners) {
 
+    LOCK(cs_pbftcontext);
     auto it = blockMinerListMap.find(blockHash) ;
     if(it == blockMinerListMap.end())
         return false;
@@ -23,6 +24,7 @@ bool CPBFTContext::SaveMinersByHash(uint256 blockhash, VoteDelegateVector delega
     for(auto delegate: delegates){
         miners.insert(delegate.regid);
     }
+    LOCK(cs_pbftcontext);
     blockMinerListMap.insert(std::make_pair(blockhash, miners));
     return true ;
 }
\ No newline at end of file
@@ -45,14 +45,17 @@ public:
 public:
 
     bool IsBroadcastedBlock(uint256 blockHash) {
+        LOCK(cs_pbftmessage);
         return broadcastedBlockHashSet.count(blockHash) > 0;
     }
 
     bool SaveBroadcastedBlock(uint256 blockHash) {
+        LOCK(cs_pbftmessage);
         broadcastedBlockHashSet.insert(blockHash) ;
         return true ;
     }
     bool IsKnown(const MsgType msg) {
+        LOCK(cs_pbftmessage);
         return messageKnown.count(msg) != 0 ;
     }
 
@@ -80,6 +83,7 @@ public:
     }
 
     bool GetMessagesByBlockHash(const uint256 hash, set<MsgType>& msgs) {
+            LOCK(cs_pbftmessage);
             auto it = blockMessagesMap.find(hash) ;
             if(it == blockMessagesMap.end())
                 return false;
@@ -91,6 +95,8 @@ public:
 
 class CPBFTContext {
 
+private:
+    CCriticalSection cs_pbftcontext;
 
 public:
 
@@ -33,10 +33,15 @@
 #include <sys/sysinfo.h>
 #include <sys/utsname.h>
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_map>
 
 #include <boost/filesystem.hpp>
 
@@ -478,66 +483,362 @@ CNode* ConnectNode(CAddress addrConnect, const char* pszDest) {
 
 static list<CNode*> vNodesDisconnected;
 
-void ThreadSocketHandler() {
-    uint32_t nPrevNodeCount = 0;
-    while (true) {
-        //
-        // Disconnect nodes
-        //
+// Each message handler thread processes the messages of its own share of the peers, in their order
+static int32_t nMsgHandThreads = 1;
+
+static int32_t GetMsgHandThread(const CNode* pNode) { return pNode->GetId() % nMsgHandThreads; }
+
+// Wakes a message handler thread as soon as one of its peers has work for it, instead of its idle poll
+static boost::mutex mutexMsgProc;
+static boost::condition_variable condMsgProc;
+static vector<bool> vMsgProcWake;
+
+void WakeMessageHandler(const CNode* pNode) {
+    {
+        boost::unique_lock<boost::mutex> lock(mutexMsgProc);
+        if (vMsgProcWake.empty())
+            return;
+
+        vMsgProcWake[GetMsgHandThread(pNode)] = true;
+    }
+    condMsgProc.notify_all();
+}
+
+static void DisconnectNodes(uint32_t& nPrevNodeCount) {
+    {
+        LOCK(cs_vNodes);
+        // Disconnect unused nodes
+        vector<CNode*> vNodesCopy = vNodes;
+        for (auto pNode : vNodesCopy) {
+            if (pNode->fDisconnect || (pNode->GetRefCount() <= 0 && pNode->vRecvMsg.empty() &&
+                                       pNode->nSendSize == 0 && pNode->ssSend.empty())) {
+                // remove from vNodes
+                vNodes.erase(remove(vNodes.begin(), vNodes.end(), pNode), vNodes.end());
+
+                // release outbound grant (if any)
+                pNode->grantOutbound.Release();
+
+                // close socket and cleanup
+                pNode->CloseSocketDisconnect();
+                pNode->Cleanup();
+
+                // hold in disconnected pool until all refs are released
+                if (pNode->fNetworkNode || pNode->fInbound)
+                    pNode->Release();
+                vNodesDisconnected.push_back(pNode);
+            }
+        }
+    }
+    {
+        // Delete disconnected nodes
+        list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
+        for (auto pNode : vNodesDisconnectedCopy) {
+            // wait until threads are done using it
+            if (pNode->GetRefCount() <= 0) {
+                bool fDelete = false;
+                {
+                    TRY_LOCK(pNode->cs_vSend, lockSend);
+                    if (lockSend) {
+                        TRY_LOCK(pNode->cs_vRecvMsg, lockRecv);
+                        if (lockRecv) {
+                            TRY_LOCK(pNode->cs_inventory, lockInv);
+                            if (lockInv)
+                                fDelete = true;
+                        }
+                    }
+                }
+                if (fDelete) {
+                    vNodesDisconnected.remove(pNode);
+                    delete pNode;
+                }
+            }
+        }
+    }
+    if (vNodes.size() != nPrevNodeCount) {
+        nPrevNodeCount = vNodes.size();
+
+        LogPrint(BCLog::INFO, "Connections number changed, %d -> %d\n", nPrevNodeCount, vNodes.size());
+    }
+}
+
+static void AcceptConnection(SOCKET hListenSocket) {
+    struct sockaddr_storage sockaddr;
+    socklen_t len  = sizeof(sockaddr);
+    SOCKET hSocket = accept(hListenSocket, (struct sockaddr*)&sockaddr, &len);
+    CAddress addr;
+    int32_t nInbound = 0;
+
+    if (hSocket != INVALID_SOCKET)
+        if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
+            LogPrint(BCLog::INFO, "Warning: Unknown socket family\n");
+
+    {
+        LOCK(cs_vNodes);
+        for (auto pNode : vNodes)
+            if (pNode->fInbound)
+                nInbound++;
+    }
+
+    if (hSocket == INVALID_SOCKET) {
+        int32_t nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK)
+            LogPrint(BCLog::INFO, "socket[%s] error accept failed: %s\n", addr.ToString(), NetworkErrorString(nErr));
+    } else if (nInbound >= nMaxConnections - MAX_OUTBOUND_CONNECTIONS) {
+        closesocket(hSocket);
+    } else if (CNode::IsBanned(addr)) {
+        LogPrint(BCLog::INFO, "connection from %s dropped (banned)\n", addr.ToString());
+        closesocket(hSocket);
+    } else {
+        LogPrint(BCLog::NET, "accepted connection %s\n", addr.ToString());
+        CNode* pNode = new CNode(hSocket, addr, "", true);
+        pNode->AddRef();
         {
             LOCK(cs_vNodes);
-            // Disconnect unused nodes
-            vector<CNode*> vNodesCopy = vNodes;
-            for (auto pNode : vNodesCopy) {
-                if (pNode->fDisconnect || (pNode->GetRefCount() <= 0 && pNode->vRecvMsg.empty() &&
-                                           pNode->nSendSize == 0 && pNode->ssSend.empty())) {
-                    // remove from vNodes
-                    vNodes.erase(remove(vNodes.begin(), vNodes.end(), pNode), vNodes.end());
-
-                    // release outbound grant (if any)
-                    pNode->grantOutbound.Release();
-
-                    // close socket and cleanup
-                    pNode->CloseSocketDisconnect();
-                    pNode->Cleanup();
-
-                    // hold in disconnected pool until all refs are released
-                    if (pNode->fNetworkNode || pNode->fInbound)
-                        pNode->Release();
-                    vNodesDisconnected.push_back(pNode);
-                }
+            vNodes.push_back(pNode);
+        }
+    }
+}
+
+// Reads what the socket of the node has for us. Returns false if the socket may still hold data, either
+// because the receive buffer of the node is full or because the read was cut short.
+// requires LOCK(cs_vRecvMsg)
+static bool ReceiveSocketData(CNode* pNode, bool fDrain) {
+    bool fCompleteMsg = false;
+    bool fDrained     = false;
+    do {
+        if (pNode->GetTotalRecvSize() > ReceiveFloodSize())
+            break;
+
+        // typical socket buffer is 8K-64K
+        char pchBuf[0x10000];
+        int32_t nBytes = recv(pNode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+        if (nBytes > 0) {
+            if (!pNode->ReceiveMsgBytes(pchBuf, nBytes))
+                pNode->CloseSocketDisconnect();
+            pNode->nLastRecv = GetTime();
+            pNode->nRecvBytes += nBytes;
+            pNode->RecordBytesRecv(nBytes);
+            fCompleteMsg = fCompleteMsg || (!pNode->vRecvMsg.empty() && pNode->vRecvMsg.front().complete());
+        } else if (nBytes == 0) {
+            // socket closed gracefully
+            if (!pNode->fDisconnect)
+                LogPrint(BCLog::NET, "socket[%s] closed\n", pNode->addr.ToString());
+            pNode->CloseSocketDisconnect();
+            fDrained = true;
+        } else if (nBytes < 0) {
+            // error
+            int32_t nErr = WSAGetLastError();
+            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
+                if (!pNode->fDisconnect)
+                    LogPrint(BCLog::INFO, "socket[%s] recv error %s\n", pNode->addr.ToString(), NetworkErrorString(nErr));
+                pNode->CloseSocketDisconnect();
             }
+            fDrained = (nErr != WSAEINTR);
         }
+    } while (fDrain && !fDrained && pNode->hSocket != INVALID_SOCKET);
+
+    if (fCompleteMsg)
+        WakeMessageHandler(pNode);
+
+    return fDrained || pNode->hSocket == INVALID_SOCKET;
+}
+
+static void CheckInactivity(CNode* pNode) {
+    if (pNode->vSendMsg.empty())
+        pNode->nLastSendEmpty = GetTime();
+    // p2p_xiaoyu_20191126
+    // if (GetTime() - pNode->nTimeConnected > 60) {
+    //     if (pNode->nLastRecv == 0 || pNode->nLastSend == 0) {
+    //         LogPrint(BCLog::NET, "socket no message in first 60 seconds, %d %d\n", pNode->nLastRecv != 0,
+    //                  pNode->nLastSend != 0);
+    //         pNode->fDisconnect = true;
+    //     } else if (GetTime() - pNode->nLastSend > 90 * 60 && GetTime() - pNode->nLastSendEmpty > 90 * 60) {
+    //         LogPrint(BCLog::INFO, "socket not sending\n");
+    //         pNode->fDisconnect = true;
+    //     } else if (GetTime() - pNode->nLastRecv > 90 * 60) {
+    //         LogPrint(BCLog::INFO, "socket inactivity timeout\n");
+    //         pNode->fDisconnect = true;
+    //     }
+    // }
+    int64_t nTime = GetSystemTimeInSeconds();
+    if (nTime - pNode->nTimeConnected > DEFAULT_PEER_CONNECT_TIMEOUT)
+    {
+        if (pNode->nLastRecv == 0 || pNode->nLastSend == 0)
         {
-            // Delete disconnected nodes
-            list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
-            for (auto pNode : vNodesDisconnectedCopy) {
-                // wait until threads are done using it
-                if (pNode->GetRefCount() <= 0) {
-                    bool fDelete = false;
-                    {
-                        TRY_LOCK(pNode->cs_vSend, lockSend);
-                        if (lockSend) {
-                            TRY_LOCK(pNode->cs_vRecvMsg, lockRecv);
-                            if (lockRecv) {
-                                TRY_LOCK(pNode->cs_inventory, lockInv);
-                                if (lockInv)
-                                    fDelete = true;
-                            }
-                        }
+            LogPrint(BCLog::NET, "socket no message in first %i seconds, %d %d from %d\n", DEFAULT_PEER_CONNECT_TIMEOUT, pNode->nLastRecv != 0, pNode->nLastSend != 0, pNode->GetId());
+            pNode->fDisconnect = true;
+        }
+        else if (nTime - pNode->nLastSend > TIMEOUT_INTERVAL)
+        {
+            LogPrint(BCLog::NET, "socket sending timeout: %is\n", nTime - pNode->nLastSend);
+            pNode->fDisconnect = true;
+        }
+        else if (nTime - pNode->nLastRecv > TIMEOUT_INTERVAL )
+        {
+            LogPrint(BCLog::NET, "socket receive timeout: %is\n", nTime - pNode->nLastRecv);
+            pNode->fDisconnect = true;
+        }
+        else if (pNode->nPingNonceSent && pNode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
+        {
+            LogPrint(BCLog::NET, "ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pNode->nPingUsecStart));
+            pNode->fDisconnect = true;
+        }
+        else if (!pNode->fSuccessfullyConnected)
+        {
+            LogPrint(BCLog::NET, "version handshake timeout from %d\n", pNode->GetId());
+            pNode->fDisconnect = true;
+        }
+    }
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+
+/**
+ * Edge-triggered epoll reactor: sockets are registered once and only the ones with events are
+ * serviced. An edge is reported once, so readiness which can't be served right away (node locked
+ * by the message handler, receive buffer full) is kept on the node and retried on the next round,
+ * which then comes after EPOLL_PENDING_WAIT_MS instead of the idle wait.
+ */
+void ThreadSocketHandler() {
+    static const int32_t EPOLL_MAX_EVENTS      = 256;
+    static const int32_t EPOLL_IDLE_WAIT_MS    = 50;
+    static const int32_t EPOLL_PENDING_WAIT_MS = 5;
+
+    int32_t epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        LogPrint(BCLog::ERROR, "ThreadSocketHandler() : epoll_create1 failed, error %s\n", NetworkErrorString(errno));
+        return;
+    }
+
+    // listen sockets stay level-triggered, one connection is accepted per round
+    for (auto hListenSocket : vhListenSocket) {
+        struct epoll_event event = {};
+        event.events             = EPOLLIN;
+        event.data.fd            = hListenSocket;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, hListenSocket, &event) < 0)
+            LogPrint(BCLog::ERROR, "ThreadSocketHandler() : epoll_ctl listen socket failed, error %s\n",
+                     NetworkErrorString(errno));
+    }
+
+    uint32_t nPrevNodeCount = 0;
+    bool fPending           = false;
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+    try {
+        while (true) {
+            DisconnectNodes(nPrevNodeCount);
+
+            // Register the sockets of new nodes. A closed socket leaves the epoll set by itself.
+            {
+                LOCK(cs_vNodes);
+                for (auto pNode : vNodes) {
+                    if (pNode->fPolled || pNode->hSocket == INVALID_SOCKET)
+                        continue;
+
+                    struct epoll_event event = {};
+                    event.events             = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                    event.data.fd            = pNode->hSocket;
+                    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, pNode->hSocket, &event) < 0) {
+                        LogPrint(BCLog::INFO, "socket[%s] epoll_ctl failed, error %s\n", pNode->addr.ToString(),
+                                 NetworkErrorString(errno));
+                        pNode->fDisconnect = true;
+                        continue;
                     }
-                    if (fDelete) {
-                        vNodesDisconnected.remove(pNode);
-                        delete pNode;
+                    pNode->fPolled = true;
+                    // data may have arrived before the registration
+                    pNode->fPollRecv = true;
+                }
+            }
+
+            int32_t nEvents = epoll_wait(epollFd, events, EPOLL_MAX_EVENTS,
+                                         fPending ? EPOLL_PENDING_WAIT_MS : EPOLL_IDLE_WAIT_MS);
+            boost::this_thread::interruption_point();
+
+            if (nEvents < 0) {
+                if (errno != EINTR)
+                    LogPrint(BCLog::INFO, "socket epoll_wait error %s\n", NetworkErrorString(errno));
+                nEvents = 0;
+            }
+
+            vector<CNode*> vNodesCopy;
+            unordered_map<SOCKET, CNode*> mapSocketNodes;
+            {
+                LOCK(cs_vNodes);
+                vNodesCopy = vNodes;
+                for (auto pNode : vNodesCopy) {
+                    pNode->AddRef();
+                    if (pNode->hSocket != INVALID_SOCKET)
+                        mapSocketNodes[pNode->hSocket] = pNode;
+                }
+            }
+
+            for (int32_t i = 0; i < nEvents; i++) {
+                SOCKET hSocket = events[i].data.fd;
+                if (find(vhListenSocket.begin(), vhListenSocket.end(), hSocket) != vhListenSocket.end()) {
+                    AcceptConnection(hSocket);
+                    continue;
+                }
+
+                auto it = mapSocketNodes.find(hSocket);
+                if (it == mapSocketNodes.end())
+                    continue;
+
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                    it->second->fPollRecv = true;
+                if (events[i].events & EPOLLOUT)
+                    it->second->fPollSend = true;
+            }
+
+            //
+            // Service each socket
+            //
+            fPending = false;
+            for (auto pNode : vNodesCopy) {
+                boost::this_thread::interruption_point();
+
+                if (pNode->hSocket == INVALID_SOCKET)
+                    continue;
+
+                if (pNode->fPollRecv) {
+                    TRY_LOCK(pNode->cs_vRecvMsg, lockRecv);
+                    if (lockRecv && ReceiveSocketData(pNode, true))
+                        pNode->fPollRecv = false;
+                }
+
+                if (pNode->hSocket == INVALID_SOCKET)
+                    continue;
+
+                if (pNode->fPollSend) {
+                    TRY_LOCK(pNode->cs_vSend, lockSend);
+                    if (lockSend) {
+                        // a partial send waits for the next writable edge
+                        pNode->SocketSendData();
+                        pNode->fPollSend = false;
                     }
                 }
+
+                fPending = fPending || pNode->fPollRecv || pNode->fPollSend;
+
+                CheckInactivity(pNode);
             }
-        }
-        if (vNodes.size() != nPrevNodeCount) {
-            nPrevNodeCount = vNodes.size();
 
-            LogPrint(BCLog::INFO, "Connections number changed, %d -> %d\n", nPrevNodeCount, vNodes.size());
+            {
+                LOCK(cs_vNodes);
+                for (auto pNode : vNodesCopy)
+                    pNode->Release();
+            }
         }
+    } catch (...) {
+        close(epollFd);
+        throw;
+    }
+}
+
+#else
+
+void ThreadSocketHandler() {
+    uint32_t nPrevNodeCount = 0;
+    while (true) {
+        DisconnectNodes(nPrevNodeCount);
 
         //
         // Find which sockets have data to receive
@@ -621,43 +922,8 @@ void ThreadSocketHandler() {
         // Accept new connections
         //
         for (auto hListenSocket : vhListenSocket)
-            if (hListenSocket != INVALID_SOCKET && FD_ISSET(hListenSocket, &fdsetRecv)) {
-                struct sockaddr_storage sockaddr;
-                socklen_t len  = sizeof(sockaddr);
-                SOCKET hSocket = accept(hListenSocket, (struct sockaddr*)&sockaddr, &len);
-                CAddress addr;
-                int32_t nInbound = 0;
-
-                if (hSocket != INVALID_SOCKET)
-                    if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
-                        LogPrint(BCLog::INFO, "Warning: Unknown socket family\n");
-
-                {
-                    LOCK(cs_vNodes);
-                    for (auto pNode : vNodes)
-                        if (pNode->fInbound)
-                            nInbound++;
-                }
-
-                if (hSocket == INVALID_SOCKET) {
-                    int32_t nErr = WSAGetLastError();
-                    if (nErr != WSAEWOULDBLOCK)
-                        LogPrint(BCLog::INFO, "socket[%s] error accept failed: %s\n", addr.ToString(), NetworkErrorString(nErr));
-                } else if (nInbound >= nMaxConnections - MAX_OUTBOUND_CONNECTIONS) {
-                    closesocket(hSocket);
-                } else if (CNode::IsBanned(addr)) {
-                    LogPrint(BCLog::INFO, "connection from %s dropped (banned)\n", addr.ToString());
-                    closesocket(hSocket);
-                } else {
-                    LogPrint(BCLog::NET, "accepted connection %s\n", addr.ToString());
-                    CNode* pNode = new CNode(hSocket, addr, "", true);
-                    pNode->AddRef();
-                    {
-                        LOCK(cs_vNodes);
-                        vNodes.push_back(pNode);
-                    }
-                }
-            }
+            if (hListenSocket != INVALID_SOCKET && FD_ISSET(hListenSocket, &fdsetRecv))
+                AcceptConnection(hListenSocket);
 
         //
         // Service each socket
@@ -679,34 +945,8 @@ void ThreadSocketHandler() {
                 continue;
             if (FD_ISSET(pNode->hSocket, &fdsetRecv) || FD_ISSET(pNode->hSocket, &fdsetError)) {
                 TRY_LOCK(pNode->cs_vRecvMsg, lockRecv);
-                if (lockRecv) {
-                    {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int32_t nBytes = recv(pNode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        if (nBytes > 0) {
-                            if (!pNode->ReceiveMsgBytes(pchBuf, nBytes))
-                                pNode->CloseSocketDisconnect();
-                            pNode->nLastRecv = GetTime();
-                            pNode->nRecvBytes += nBytes;
-                            pNode->RecordBytesRecv(nBytes);
-                        } else if (nBytes == 0) {
-                            // socket closed gracefully
-                            if (!pNode->fDisconnect)
-                                LogPrint(BCLog::NET, "socket[%s] closed\n", pNode->addr.ToString());
-                            pNode->CloseSocketDisconnect();
-                        } else if (nBytes < 0) {
-                            // error
-                            int32_t nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR &&
-                                nErr != WSAEINPROGRESS) {
-                                if (!pNode->fDisconnect)
-                                    LogPrint(BCLog::INFO, "socket[%s] recv error %s\n", pNode->addr.ToString(), NetworkErrorString(nErr));
-                                pNode->CloseSocketDisconnect();
-                            }
-                        }
-                    }
-                }
+                if (lockRecv)
+                    ReceiveSocketData(pNode, false);
             }
 
             //
@@ -723,53 +963,7 @@ void ThreadSocketHandler() {
             //
             // Inactivity checking
             //
-            if (pNode->vSendMsg.empty())
-                pNode->nLastSendEmpty = GetTime();
-            // p2p_xiaoyu_20191126
-            // if (GetTime() - pNode->nTimeConnected > 60) {
-            //     if (pNode->nLastRecv == 0 || pNode->nLastSend == 0) {
-            //         LogPrint(BCLog::NET, "socket no message in first 60 seconds, %d %d\n", pNode->nLastRecv != 0,
-            //                  pNode->nLastSend != 0);
-            //         pNode->fDisconnect = true;
-            //     } else if (GetTime() - pNode->nLastSend > 90 * 60 && GetTime() - pNode->nLastSendEmpty > 90 * 60) {
-            //         LogPrint(BCLog::INFO, "socket not sending\n");
-            //         pNode->fDisconnect = true;
-            //     } else if (GetTime() - pNode->nLastRecv > 90 * 60) {
-            //         LogPrint(BCLog::INFO, "socket inactivity timeout\n");
-            //         pNode->fDisconnect = true;
-            //     }
-            // }
-            int64_t nTime = GetSystemTimeInSeconds();
-            if (nTime - pNode->nTimeConnected > DEFAULT_PEER_CONNECT_TIMEOUT)
-            {
-                if (pNode->nLastRecv == 0 || pNode->nLastSend == 0)
-                {
-                    LogPrint(BCLog::NET, "socket no message in first %i seconds, %d %d from %d\n", DEFAULT_PEER_CONNECT_TIMEOUT, pNode->nLastRecv != 0, pNode->nLastSend != 0, pNode->GetId());
-                    pNode->fDisconnect = true;
-                }
-                else if (nTime - pNode->nLastSend > TIMEOUT_INTERVAL)
-                {
-                    LogPrint(BCLog::NET, "socket sending timeout: %is\n", nTime - pNode->nLastSend);
-                    pNode->fDisconnect = true;
-                }
-                else if (nTime - pNode->nLastRecv > TIMEOUT_INTERVAL )
-                {
-                    LogPrint(BCLog::NET, "socket receive timeout: %is\n", nTime - pNode->nLastRecv);
-                    pNode->fDisconnect = true;
-                }
-                else if (pNode->nPingNonceSent && pNode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
-                {
-                    LogPrint(BCLog::NET, "ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pNode->nPingUsecStart));
-                    pNode->fDisconnect = true;
-                }
-                else if (!pNode->fSuccessfullyConnected)
-                {
-                    LogPrint(BCLog::NET, "version handshake timeout from %d\n", pNode->GetId());
-                    pNode->fDisconnect = true;
-                }
-            }
-
-
+            CheckInactivity(pNode);
         }
 
         {
@@ -780,6 +974,8 @@ void ThreadSocketHandler() {
     }
 }
 
+#endif  // HAVE_SYS_EPOLL_H
+
 #ifdef USE_UPNP
 void ThreadMapPort() {
     string port               = strprintf("%u", GetListenPort());
@@ -1171,12 +1367,13 @@ void static StartSync(const vector<CNode*>& vNodes) {
     }
 }
 
-void ThreadMessageHandler() {
+void ThreadMessageHandler(int32_t nThread) {
     SetThreadPriority(THREAD_PRIORITY_BELOW_NORMAL);
     while (true) {
         bool fHaveSyncNode = false;
 
         vector<CNode*> vNodesCopy;
+        vector<CNode*> vThreadNodes;
         {
             LOCK(cs_vNodes);
             vNodesCopy = vNodes;
@@ -1184,20 +1381,23 @@ void ThreadMessageHandler() {
                 pNode->AddRef();
                 if (pNode == pnodeSync)
                     fHaveSyncNode = true;
+                if (GetMsgHandThread(pNode) == nThread)
+                    vThreadNodes.push_back(pNode);
             }
         }
 
-        if (!fHaveSyncNode)
+        // the sync peer is picked among all the peers, by the first thread only
+        if (nThread == 0 && !fHaveSyncNode)
             StartSync(vNodesCopy);
 
         // Poll the connected nodes for messages
         CNode* pnodeTrickle = nullptr;
-        if (!vNodesCopy.empty())
-            pnodeTrickle = vNodesCopy[GetRand(vNodesCopy.size())];
+        if (!vThreadNodes.empty())
+            pnodeTrickle = vThreadNodes[GetRand(vThreadNodes.size())];
 
         bool fSleep = true;
 
-        for (auto pNode : vNodesCopy) {
+        for (auto pNode : vThreadNodes) {
             if (pNode->fDisconnect)
                 continue;
 
@@ -1234,8 +1434,13 @@ void ThreadMessageHandler() {
                 pNode->Release();
         }
 
-        if (fSleep)
-            MilliSleep(100);
+        {
+            // sleep until the socket thread has a complete message for us, or 100ms at most
+            boost::unique_lock<boost::mutex> lock(mutexMsgProc);
+            if (fSleep && !vMsgProcWake[nThread])
+                condMsgProc.timed_wait(lock, boost::posix_time::milliseconds(100));
+            vMsgProcWake[nThread] = false;
+        }
     }
 }
 
@@ -1417,7 +1622,15 @@ void StartNode(boost::thread_group& threadGroup) {
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "opencon", &ThreadOpenConnections));
 
     // Process messages
-    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "msghand", &ThreadMessageHandler));
+    nMsgHandThreads = SysCfg().GetArg("-msghandthreads", DEFAULT_MSGHAND_THREADS);
+    nMsgHandThreads = max(min(nMsgHandThreads, MAX_MSGHAND_THREADS), 1);
+    {
+        boost::unique_lock<boost::mutex> lock(mutexMsgProc);
+        vMsgProcWake.assign(nMsgHandThreads, false);
+    }
+    for (int32_t i = 0; i < nMsgHandThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "msghand",
+                                              boost::function<void()>(boost::bind(&ThreadMessageHandler, i))));
 
     // Dump network addresses
     threadGroup.create_thread(boost::bind(&LoopForever<void (*)()>, "dumpaddr", &DumpAddresses, DUMP_ADDRESSES_INTERVAL * 1000));
@@ -1473,6 +1686,11 @@ public:
 instance_of_cnetcleanup;
 
 void RelayTransaction(CBaseTx* pBaseTx, const uint256& hash) {
+    if (pBaseTx->spRawTx) {
+        RelayTransaction(pBaseTx, hash, *pBaseTx->spRawTx);
+        return;
+    }
+
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss.reserve(1000);
     auto pTx = pBaseTx->GetNewInstance();
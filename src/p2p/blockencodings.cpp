@@ -0,0 +1,143 @@
+// Copyright (c) 2016-2018 The Bitcoin Core developers
+// Copyright (c) 2017-2019 The WaykiChain Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockencodings.h"
+
+#include "commons/random.h"
+#include "commons/util/util.h"
+#include "crypto/hash.h"
+#include "crypto/siphash.h"
+#include "tx/txmempool.h"
+
+#include <limits>
+#include <unordered_map>
+
+// every serialized tx takes more than this, which bounds the tx count of a valid block
+static const uint32_t MIN_SERIALIZED_TX_SIZE = 10;
+
+static bool IsPrefilledTx(const std::shared_ptr<CBaseTx> &pTx) {
+    // these txs are made by the block producer and never relayed
+    return pTx->IsBlockRewardTx() || pTx->IsCoinRewardTx() || pTx->IsPriceMedianTx();
+}
+
+CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock &block)
+    : header(block.GetBlockHeader()), nonce(GetRand(std::numeric_limits<uint64_t>::max())) {
+    FillShortIdKeys();
+    for (uint32_t i = 0; i < block.vptx.size(); i++) {
+        const auto &pTx = block.vptx[i];
+        if (IsPrefilledTx(pTx))
+            prefilledTxs.push_back({i, pTx});
+        else
+            shortTxIds.push_back(CShortTxId(GetShortTxId(pTx->GetHash())));
+    }
+}
+
+void CBlockHeaderAndShortTxIDs::FillShortIdKeys() const {
+    // keyed by the block and a per-message nonce, so colliding txs can't be crafted ahead
+    CHashWriter hasher(SER_GETHASH, CLIENT_VERSION);
+    hasher << header << nonce;
+    uint256 keys = hasher.GetHash();
+    shortIdK0    = keys.GetUint64(0);
+    shortIdK1    = keys.GetUint64(1);
+}
+
+uint64_t CBlockHeaderAndShortTxIDs::GetShortTxId(const uint256 &txid) const {
+    if (shortIdK0 == 0 && shortIdK1 == 0)
+        FillShortIdKeys();
+
+    return SipHashUint256(shortIdK0, shortIdK1, txid) & CShortTxId::MASK;
+}
+
+CBlockTxs::CBlockTxs(const CBlock &block, const CBlockTxsRequest &req) : blockHash(req.blockHash) {
+    vptx.reserve(req.indexes.size());
+    for (uint32_t index : req.indexes)
+        vptx.push_back(block.vptx[index]);
+}
+
+ReadStatus CPartialBlock::InitData(const CBlockHeaderAndShortTxIDs &cmpctBlock, CTxMemPool &pool) {
+    size_t txCount = cmpctBlock.GetTxCount();
+    if (txCount == 0 || txCount > MAX_BLOCK_SIZE / MIN_SERIALIZED_TX_SIZE)
+        return READ_STATUS_INVALID;
+
+    header = cmpctBlock.header;
+    vptxAvailable.assign(txCount, nullptr);
+    missingIndexes.clear();
+
+    int64_t lastIndex = -1;
+    for (const auto &prefilled : cmpctBlock.prefilledTxs) {
+        if (!prefilled.pTx || (int64_t)prefilled.index <= lastIndex || prefilled.index >= txCount)
+            return READ_STATUS_INVALID;
+
+        vptxAvailable[prefilled.index] = prefilled.pTx;
+        lastIndex                      = prefilled.index;
+    }
+
+    // map the short ids to the tx slots not taken by the prefilled txs
+    std::unordered_map<uint64_t, uint32_t> shortIdIndexes;
+    shortIdIndexes.reserve(cmpctBlock.shortTxIds.size());
+    uint32_t index = 0;
+    for (const auto &shortTxId : cmpctBlock.shortTxIds) {
+        while (vptxAvailable[index])
+            index++;
+
+        if (!shortIdIndexes.emplace(shortTxId.Get(), index).second)
+            return READ_STATUS_FAILED;  // two txs of the block share a short id
+
+        index++;
+    }
+
+    std::vector<uint8_t> matches(txCount, 0);
+    {
+        LOCK(pool.cs);
+        for (const auto &item : pool.memPoolTxs) {
+            auto it = shortIdIndexes.find(cmpctBlock.GetShortTxId(item.first));
+            if (it == shortIdIndexes.end())
+                continue;
+
+            // several mempool txs with the id of a block tx: ask the peer for it. The block gets its own
+            // copy, as the in-memory fields of the mempool tx are written by the miner.
+            if (matches[it->second]++ == 0)
+                vptxAvailable[it->second] = item.second.GetTransaction()->GetNewInstance();
+            else
+                vptxAvailable[it->second] = nullptr;
+        }
+    }
+
+    for (uint32_t i = 0; i < txCount; i++) {
+        if (!vptxAvailable[i])
+            missingIndexes.push_back(i);
+    }
+
+    LogPrint(BCLog::NET, "compact block %s: %u txs, %u prefilled, %u missing from mempool\n",
+             header.GetHash().GetHex(), txCount, cmpctBlock.prefilledTxs.size(), missingIndexes.size());
+
+    return READ_STATUS_OK;
+}
+
+bool CPartialBlock::IsTxAvailable(uint32_t index) const {
+    return index < vptxAvailable.size() && vptxAvailable[index] != nullptr;
+}
+
+ReadStatus CPartialBlock::FillBlock(CBlock &block, const std::vector<std::shared_ptr<CBaseTx>> &vptxMissing) {
+    if (vptxMissing.size() != missingIndexes.size())
+        return READ_STATUS_INVALID;
+
+    for (size_t i = 0; i < missingIndexes.size(); i++) {
+        if (!vptxMissing[i])
+            return READ_STATUS_INVALID;
+
+        vptxAvailable[missingIndexes[i]] = vptxMissing[i];
+    }
+
+    block = CBlock(header);
+    block.vptx.swap(vptxAvailable);
+    missingIndexes.clear();
+
+    // a short id collision with a mempool tx shows up as a wrong merkle root
+    if (block.BuildMerkleTree() != block.GetMerkleRootHash())
+        return READ_STATUS_FAILED;
+
+    return READ_STATUS_OK;
+}
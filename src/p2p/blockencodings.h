@@ -0,0 +1,128 @@
+// Copyright (c) 2016-2018 The Bitcoin Core developers
+// Copyright (c) 2017-2019 The WaykiChain Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef P2P_BLOCKENCODINGS_H
+#define P2P_BLOCKENCODINGS_H
+
+#include "commons/serialize.h"
+#include "commons/uint256.h"
+#include "persistence/block.h"
+
+#include <memory>
+#include <vector>
+
+class CTxMemPool;
+
+/** Serialized tx ids of a compact block are SipHash-2-4 digests truncated to 48 bits */
+class CShortTxId {
+public:
+    static const uint64_t MASK = 0xffffffffffffULL;
+
+    uint32_t lsb;
+    uint16_t msb;
+
+    CShortTxId() : lsb(0), msb(0) {}
+    explicit CShortTxId(uint64_t id) : lsb(id & 0xffffffff), msb((id >> 32) & 0xffff) {}
+
+    uint64_t Get() const { return (uint64_t(msb) << 32) | lsb; }
+
+    IMPLEMENT_SERIALIZE(
+        READWRITE(lsb);
+        READWRITE(msb);
+    )
+};
+
+/** A tx sent along with a compact block, as the peer can't have it in its mempool */
+class CPrefilledTx {
+public:
+    uint32_t index;
+    std::shared_ptr<CBaseTx> pTx;
+
+    IMPLEMENT_SERIALIZE(
+        READWRITE(VARINT(index));
+        READWRITE(pTx);
+    )
+};
+
+/**
+ * Compact block: the header, the short ids of the txs the peer should find in its mempool, and
+ * the txs which never go through the mempool (block reward, coin reward and price median txs).
+ */
+class CBlockHeaderAndShortTxIDs {
+public:
+    CBlockHeader header;
+    uint64_t nonce;
+    std::vector<CShortTxId> shortTxIds;
+    std::vector<CPrefilledTx> prefilledTxs;
+
+    CBlockHeaderAndShortTxIDs() : nonce(0) {}
+    explicit CBlockHeaderAndShortTxIDs(const CBlock &block);
+
+    uint64_t GetShortTxId(const uint256 &txid) const;
+    size_t GetTxCount() const { return shortTxIds.size() + prefilledTxs.size(); }
+
+    IMPLEMENT_SERIALIZE(
+        READWRITE(header);
+        READWRITE(nonce);
+        READWRITE(shortTxIds);
+        READWRITE(prefilledTxs);
+    )
+
+private:
+    mutable uint64_t shortIdK0 = 0;
+    mutable uint64_t shortIdK1 = 0;
+
+    void FillShortIdKeys() const;
+};
+
+/** Indexes of the txs of a compact block missing from the mempool, sent as "getblocktxn" */
+class CBlockTxsRequest {
+public:
+    uint256 blockHash;
+    std::vector<uint32_t> indexes;
+
+    IMPLEMENT_SERIALIZE(
+        READWRITE(blockHash);
+        READWRITE(indexes);
+    )
+};
+
+/** The txs asked for by a "getblocktxn", sent back in the same order as "blocktxn" */
+class CBlockTxs {
+public:
+    uint256 blockHash;
+    std::vector<std::shared_ptr<CBaseTx>> vptx;
+
+    CBlockTxs() {}
+    CBlockTxs(const CBlock &block, const CBlockTxsRequest &req);
+
+    IMPLEMENT_SERIALIZE(
+        READWRITE(blockHash);
+        READWRITE(vptx);
+    )
+};
+
+enum ReadStatus {
+    READ_STATUS_OK,
+    READ_STATUS_INVALID,  // the peer sent invalid data
+    READ_STATUS_FAILED,   // reconstruction failed, e.g. short id collision: fall back to the full block
+};
+
+/** A block being rebuilt from a compact block and the local mempool */
+class CPartialBlock {
+public:
+    CBlockHeader header;
+    std::vector<uint32_t> missingIndexes;
+
+    ReadStatus InitData(const CBlockHeaderAndShortTxIDs &cmpctBlock, CTxMemPool &pool);
+    bool IsTxAvailable(uint32_t index) const;
+    // The missing txs must be given in the order of missingIndexes
+    ReadStatus FillBlock(CBlock &block, const std::vector<std::shared_ptr<CBaseTx>> &vptxMissing);
+
+private:
+    std::vector<std::shared_ptr<CBaseTx>> vptxAvailable;
+};
+
+#endif  // P2P_BLOCKENCODINGS_H
@@ -11,8 +11,12 @@
 #include "commons/util/util.h"
 #include "main.h"
 #include "net.h"
+#include "miner/miner.h"
 #include "miner/pbftcontext.h"
 #include "miner/pbftmanager.h"
+#include "p2p/blockencodings.h"
+#include "p2p/headerchain.h"
+#include "p2p/rawblockcache.h"
 #include "tx/einvalidtxtype.h"
 
 #include <string>
@@ -37,6 +41,7 @@ extern CPBFTMan pbftMan ;
 extern CChain chainActive;
 extern uint256 GetOrphanRoot(const uint256 &hash);
 extern map<uint256, COrphanBlock *> mapOrphanBlocks;
+extern CHeaderChain headerChain;
 
 namespace {
 map<uint256, tuple<NodeId, list<QueuedBlock>::iterator, int64_t>> mapBlocksInFlight;  // downloading blocks
@@ -46,6 +51,12 @@ map<uint256, tuple<NodeId, list<uint256>::iterator, int64_t>> mapBlocksToDownloa
 // them, if processing happens afterwards. Protected by cs_main.
 map<uint256, NodeId> mapBlockSource;  // Remember who we got this block from.
 
+// Headers-first sync, protected by cs_main. The header chain is fetched from the sync peer only.
+NodeId nHeadersSyncPeer     = -1;
+int64_t nHeadersRequestTime = 0;      // when the outstanding getheaders was sent, 0 if none
+bool fHeadersSynced         = false;  // the sync peer has no more headers for us
+bool fHeadersPaused         = false;  // stopped at a header signed by a delegate unknown at the tip
+
 
 // Requires cs_mapNodeState.
 void MarkBlockAsReceived(const uint256 &hash, NodeId nodeFrom = -1) {
@@ -64,8 +75,12 @@ void MarkBlockAsReceived(const uint256 &hash, NodeId nodeFrom = -1) {
         CNodeState *state = State(std::get<0>(itInFlight->second));
         state->vBlocksInFlight.erase(std::get<1>(itInFlight->second));
         state->nBlocksInFlight--;
-        if (std::get<0>(itInFlight->second) == nodeFrom)
+        if (std::get<0>(itInFlight->second) == nodeFrom) {
             state->nLastBlockReceive = GetTimeMicros();
+            // the peer delivered in time, ask it for one more block at a time
+            if (state->nBlocksInFlightLimit < MAX_BLOCKS_IN_TRANSIT_PER_PEER)
+                state->nBlocksInFlightLimit++;
+        }
 
         mapBlocksInFlight.erase(itInFlight);
     }
@@ -101,7 +116,7 @@ inline void ProcessGetData(CNode *pFrom) {
             boost::this_thread::interruption_point();
             it++;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) {
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK) {
                 bool send                                = false;
                 map<uint256, CBlockIndex *>::iterator mi = mapBlockIndex.find(inv.hash);
                 if (mi != mapBlockIndex.end()) {
@@ -111,32 +126,43 @@ inline void ProcessGetData(CNode *pFrom) {
                 }
 
                 if (send) {
-                    // Send block from disk
-                    CBlock block;
-                    ReadBlockFromDisk((*mi).second, block);
-                    if (inv.type == MSG_BLOCK) {
-                        LogPrint(BCLog::NET, "send block[%u]: %s to peer %s\n", block.GetHeight(), block.GetHash().GetHex(),
-                                 pFrom->addr.ToString());
-                        pFrom->PushMessage(NetMsgType::BLOCK, block);
-                    }
-                    else  // MSG_FILTERED_BLOCK)
-                    {
-                        LOCK(pFrom->cs_filter);
-                        if (pFrom->pFilter) {
-                            CMerkleBlock merkleBlock(block, *pFrom->pFilter);
-                            pFrom->PushMessage("merkleblock", merkleBlock);
-                            // CMerkleBlock just contains hashes, so also push any transactions in the block the client
-                            // did not see This avoids hurting performance by pointlessly requiring a round-trip Note
-                            // that there is currently no way for a node to request any single transactions we didnt
-                            // send here - they must either disconnect and retry or request the full block. Thus, the
-                            // protocol spec specified allows for us to provide duplicate txn here, however we MUST
-                            // always provide at least what the remote peer needs
-                            for (auto &pair : merkleBlock.vMatchedTxn)
-                                if (!pFrom->setInventoryKnown.count(CInv(MSG_TX, pair.second)))
-                                    pFrom->PushMessage(NetMsgType::TX, block.vptx[pair.first]);
+                    const CBlockIndex *pIndex = (*mi).second;
+                    // the txs of older blocks have left the mempool of the peer
+                    bool fCmpctBlock = inv.type == MSG_CMPCT_BLOCK && chainActive.Height() - pIndex->height <= MAX_CMPCTBLOCK_DEPTH;
+                    if (inv.type != MSG_FILTERED_BLOCK && !fCmpctBlock) {
+                        // Send the block bytes from disk as they are, without deserializing the txs
+                        auto spMsg = GetRawBlockMessage(pIndex);
+                        if (spMsg) {
+                            LogPrint(BCLog::NET, "send block[%u]: %s to peer %s\n", pIndex->height,
+                                     pIndex->GetBlockHash().GetHex(), pFrom->addr.ToString());
+                            pFrom->PushRawMessage(*spMsg);
+                        }
+                    } else {
+                        // Send block from disk
+                        CBlock block;
+                        ReadBlockFromDisk(pIndex, block);
+                        if (fCmpctBlock) {
+                            LogPrint(BCLog::NET, "send compact block[%u]: %s to peer %s\n", block.GetHeight(),
+                                     block.GetHash().GetHex(), pFrom->addr.ToString());
+                            pFrom->PushMessage(NetMsgType::CMPCTBLOCK, CBlockHeaderAndShortTxIDs(block));
+                        } else {  // MSG_FILTERED_BLOCK
+                            LOCK(pFrom->cs_filter);
+                            if (pFrom->pFilter) {
+                                CMerkleBlock merkleBlock(block, *pFrom->pFilter);
+                                pFrom->PushMessage("merkleblock", merkleBlock);
+                                // CMerkleBlock just contains hashes, so also push any transactions in the block the client
+                                // did not see This avoids hurting performance by pointlessly requiring a round-trip Note
+                                // that there is currently no way for a node to request any single transactions we didnt
+                                // send here - they must either disconnect and retry or request the full block. Thus, the
+                                // protocol spec specified allows for us to provide duplicate txn here, however we MUST
+                                // always provide at least what the remote peer needs
+                                for (auto &pair : merkleBlock.vMatchedTxn)
+                                    if (!pFrom->setInventoryKnown.count(CInv(MSG_TX, pair.second)))
+                                        pFrom->PushMessage(NetMsgType::TX, block.vptx[pair.first]);
+                            }
+                            // else
+                            // no response
                         }
-                        // else
-                        // no response
                     }
 
                     // Trigger them to send a getblocks request for the next batch of inventory
@@ -165,10 +191,14 @@ inline void ProcessGetData(CNode *pFrom) {
                 if (!pushed && inv.type == MSG_TX) {
                     std::shared_ptr<CBaseTx> pBaseTx = mempool.Lookup(inv.hash);
                     if (pBaseTx.get() && !pBaseTx->IsBlockRewardTx() && !pBaseTx->IsPriceMedianTx()) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << pBaseTx;
-                        pFrom->PushMessage(NetMsgType::TX, ss);
+                        if (pBaseTx->spRawTx) {
+                            pFrom->PushMessage(NetMsgType::TX, *pBaseTx->spRawTx);
+                        } else {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << pBaseTx;
+                            pFrom->PushMessage(NetMsgType::TX, ss);
+                        }
                         pushed = true;
                     }
                 }
@@ -180,7 +210,7 @@ inline void ProcessGetData(CNode *pFrom) {
             // Track requests for our stuff.
             // g_signals.Inventory(inv.hash);
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
                 break;
         }
     }
@@ -481,12 +511,16 @@ inline bool ProcessAddrMessage(CNode *pFrom, CDataStream &vRecv) {
 
 inline bool ProcessTxMessage(CNode *pFrom, string strCommand, CDataStream &vRecv) {
     std::shared_ptr<CBaseTx> pBaseTx;
+    // keep the received bytes, so the tx is relayed and served without serializing it again
+    auto spRawTx = std::make_shared<CDataStream>(vRecv.begin(), vRecv.end(), vRecv.GetType(), vRecv.GetVersion());
     try {
         vRecv >> pBaseTx;
     } catch(EInvalidTxType e) {
         // TODO: record the misebehaving or ban the peer node.
         return ERRORMSG("Unknown transaction type from peer %s, ignore! %s", pFrom->addr.ToString(), e.what());
     }
+    spRawTx->resize(spRawTx->size() - vRecv.size());
+    pBaseTx->SetRawTx(spRawTx);
 
     if (pBaseTx->IsBlockRewardTx() || pBaseTx->IsCoinRewardTx() || pBaseTx->IsPriceMedianTx()) {
         return ERRORMSG("Forbidden transaction from network from peer %s, raw: %s", pFrom->addr.ToString(),
@@ -501,13 +535,24 @@ inline bool ProcessTxMessage(CNode *pFrom, string strCommand, CDataStream &vRecv
         return true ;
     }
 
-
+    // Verify the signature before the mempool checks, cs_main is only held to look up the signer. A valid
+    // signature lands in the signature cache, an invalid one is reported by AcceptToMemoryPool.
+    CSignatureBatch batch;
+    {
+        LOCK(cs_main);
+        CCacheWrapper cw(mempool.cw.get());
+        pBaseTx->GetSignatureChecks(cw, batch);
+    }
+    VerifySignatureBatch(batch);
 
     LOCK(cs_main);
     CValidationState state;
     if (AcceptToMemoryPool(mempool, state, pBaseTx.get(), true)) {
         RelayTransaction(pBaseTx.get(), inv.hash);
-        mapAlreadyAskedFor.erase(inv);
+        {
+            LOCK(cs_mapAlreadyAskedFor);
+            mapAlreadyAskedFor.erase(inv);
+        }
 
         LogPrint(BCLog::INFO, "AcceptToMemoryPool: %s %s : accepted %s (poolsz %u)\n", pFrom->addr.ToString(),
                  pFrom->cleanSubVer, pBaseTx->GetHash().ToString(), mempool.memPoolTxs.size());
@@ -553,7 +598,7 @@ inline bool ProcessGetHeadersMessage(CNode *pFrom, CDataStream &vRecv) {
 
     // We must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
     vector<CBlock> vHeaders;
-    int32_t nLimit = 2000;
+    int32_t nLimit = MAX_HEADERS_RESULTS;
     LogPrint(BCLog::NET, "getheaders %d to %s from peer %s\n", (pIndex ? pIndex->height : -1), hashStop.ToString(),
              pFrom->addr.ToString());
     for (; pIndex; pIndex = chainActive.Next(pIndex)) {
@@ -566,6 +611,237 @@ inline bool ProcessGetHeadersMessage(CNode *pFrom, CDataStream &vRecv) {
     return false;
 }
 
+// Requires cs_main. The checks CheckBlock() and AcceptBlock() run on the header of a block, against the last
+// header of the header chain it follows.
+inline bool CheckBlockHeader(const CBlockHeader &header, CValidationState &state) {
+    if (header.GetPrevBlockHash() != headerChain.GetLastHash())
+        return state.DoS(100, ERRORMSG("CheckBlockHeader() : non-continuous headers"), REJECT_INVALID, "bad-prevblk");
+
+    if ((int32_t)header.GetHeight() != headerChain.GetHeight() + 1)
+        return state.DoS(100, ERRORMSG("CheckBlockHeader() : height mismatches with its actual height"), REJECT_INVALID,
+                         "incorrect-height");
+
+    if (header.GetVersion() != CBlockHeader::CURRENT_VERSION)
+        return state.Invalid(ERRORMSG("CheckBlockHeader() : block version error"), REJECT_INVALID, "block-version-error");
+
+    if (header.GetBlockTime() > GetAdjustedTime() + ::GetBlockInterval(header.GetHeight()) + 2)
+        return state.Invalid(ERRORMSG("CheckBlockHeader() : block timestamp too far in the future"), REJECT_INVALID,
+                             "time-too-new");
+
+    int64_t prevTime = headerChain.GetLastTime();
+    if (header.GetBlockTime() <= prevTime || header.GetBlockTime() - prevTime < GetBlockInterval(header.GetHeight()))
+        return state.Invalid(ERRORMSG("CheckBlockHeader() : the new block came in too early"), REJECT_INVALID,
+                             "time-too-early");
+
+    static uint64_t maxNonce = SysCfg().GetBlockMaxNonce();
+    if (header.GetNonce() > maxNonce)
+        return state.Invalid(ERRORMSG("CheckBlockHeader() : Nonce is larger than maxNonce"), REJECT_INVALID,
+                             "Nonce-too-large");
+
+    const auto &signature = header.GetSignature();
+    if (signature.empty() || signature.size() > MAX_SIGNATURE_SIZE)
+        return state.DoS(100, ERRORMSG("CheckBlockHeader() : invalid block signature size"), REJECT_INVALID,
+                         "bad-signature-size");
+
+    return true;
+}
+
+// Requires cs_main. Checks the header is signed by the delegate of its slot, as VerifyRewardTx() does for the
+// block, with the active delegates at the tip. Only final for a header following the tip: the delegates of the
+// later ones may be elected by blocks in between.
+inline bool CheckBlockHeaderSignature(const CBlockHeader &header) {
+    VoteDelegateVector delegates;
+    if (!pCdMan->pDelegateCache->GetActiveDelegates(delegates) || delegates.empty())
+        return false;
+
+    VoteDelegate delegate;
+    ShuffleDelegates(header.GetHeight(), header.GetTime(), delegates);
+    if (!GetCurrentDelegate(header.GetTime(), header.GetHeight(), delegates, delegate))
+        return false;
+
+    CAccount account;
+    if (!pCdMan->pAccountCache->GetAccount(delegate.regid, account))
+        return false;
+
+    const uint256 blockHash = header.GetHash();
+    return VerifySignature(blockHash, header.GetSignature(), account.owner_pubkey) ||
+           (account.miner_pubkey.IsValid() && VerifySignature(blockHash, header.GetSignature(), account.miner_pubkey));
+}
+
+// Requires cs_main. Drops the headers of the blocks connected meanwhile.
+inline void PruneHeaderChain() {
+    CBlockIndex *pTip = chainActive.Tip();
+    if (!headerChain.Prune(pTip->GetBlockHash(), pTip->height, pTip->GetBlockTime())) {
+        LogPrint(BCLog::NET, "tip %s left the header chain, fetch the headers again\n", pTip->GetIndentityString());
+        fHeadersSynced = false;
+    }
+}
+
+// Requires cs_main. Asks the sync peer for the headers following the header chain.
+inline void PushGetHeaders(CNode *pNode) {
+    CBlockLocator locator = chainActive.GetLocator();
+    if (!headerChain.IsEmpty())
+        locator.vHave.insert(locator.vHave.begin(), headerChain.GetLastHash());
+
+    nHeadersRequestTime = GetTimeMicros();
+    fHeadersPaused      = false;
+    pNode->PushMessage(NetMsgType::GETHEADERS, locator, uint256());
+    LogPrint(BCLog::NET, "getheaders after height %d from peer %s\n", headerChain.GetHeight(), pNode->addr.ToString());
+}
+
+// Requires cs_main.
+inline void StartHeadersSync(CNode *pNode) {
+    nHeadersSyncPeer    = pNode->GetId();
+    nHeadersRequestTime = 0;
+    fHeadersSynced      = false;
+    PruneHeaderChain();
+    PushGetHeaders(pNode);
+}
+
+inline bool ProcessHeadersMessage(CNode *pFrom, CDataStream &vRecv) {
+    // headers are sent as blocks without txs
+    vector<CBlock> vHeaders;
+    vRecv >> vHeaders;
+    if (vHeaders.size() > MAX_HEADERS_RESULTS) {
+        Misbehaving(pFrom->GetId(), 20);
+        return ERRORMSG("message headers size() = %u from peer %s", vHeaders.size(), pFrom->addr.ToString());
+    }
+
+    LOCK(cs_main);
+    if (pFrom->GetId() != nHeadersSyncPeer || nHeadersRequestTime == 0) {
+        LogPrint(BCLog::NET, "unrequested headers (%u) from peer %s, ignore\n", vHeaders.size(), pFrom->addr.ToString());
+        return true;
+    }
+
+    nHeadersRequestTime = 0;
+    PruneHeaderChain();
+
+    if (!vHeaders.empty() && vHeaders[0].GetPrevBlockHash() != headerChain.GetLastHash()) {
+        CBlockIndex *pTip = chainActive.Tip();
+        if (vHeaders[0].GetPrevBlockHash() != pTip->GetBlockHash()) {
+            // the peer is on a fork below the tip, which the blocks sync resolves
+            LogPrint(BCLog::NET, "headers from peer %s fork below the tip, fall back to getblocks\n",
+                     pFrom->addr.ToString());
+            fHeadersSynced = true;
+            PushGetBlocks(pFrom, pTip, uint256());
+            return true;
+        }
+
+        headerChain.Reset(pTip->GetBlockHash(), pTip->height, pTip->GetBlockTime());
+    }
+
+    for (const auto &header : vHeaders) {
+        CValidationState state;
+        int32_t nDoS = 0;
+        if (!CheckBlockHeader(header, state)) {
+            LogPrint(BCLog::INFO, "invalid header [%u]: %s from peer %s, reason: %s\n", header.GetHeight(),
+                     header.GetHash().GetHex(), pFrom->addr.ToString(), state.GetRejectReason());
+            if (state.IsInvalid(nDoS) && nDoS > 0)
+                Misbehaving(pFrom->GetId(), nDoS);
+
+            fHeadersSynced = true;
+            break;
+        }
+
+        if (!CheckBlockHeaderSignature(header)) {
+            if (header.GetPrevBlockHash() == chainActive.Tip()->GetBlockHash()) {
+                LogPrint(BCLog::INFO, "Misbehaving: header [%u]: %s from peer %s not signed by its delegate, "
+                         "Misbehavior add 100\n", header.GetHeight(), header.GetHash().GetHex(), pFrom->addr.ToString());
+                Misbehaving(pFrom->GetId(), 100);
+                fHeadersSynced = true;
+                break;
+            }
+
+            // checked again once the blocks before it are connected, its delegate may be elected by them
+            LogPrint(BCLog::NET, "header [%u]: %s signed by a delegate unknown at the tip, wait for the blocks before it\n",
+                     header.GetHeight(), header.GetHash().GetHex());
+            fHeadersPaused = true;
+            break;
+        }
+
+        headerChain.Append(header);
+    }
+
+    if (!fHeadersPaused && vHeaders.size() < MAX_HEADERS_RESULTS)
+        fHeadersSynced = true;
+
+    if (headerChain.GetHeight() > nSyncTipHeight)
+        nSyncTipHeight = headerChain.GetHeight();
+
+    LogPrint(BCLog::NET, "recv headers! count=%u, header_height=%d, tip_height=%d, synced=%d, peer=%s\n",
+             vHeaders.size(), headerChain.GetHeight(), chainActive.Height(), fHeadersSynced, pFrom->addr.ToString());
+
+    if (!fHeadersSynced && !fHeadersPaused && headerChain.Size() < MAX_HEADERS_AHEAD)
+        PushGetHeaders(pFrom);
+
+    return true;
+}
+
+// Requires cs_main. Run by SendMessages() for every peer: keeps the header chain ahead of the tip from the sync
+// peer, and queues to the peer the missing blocks of the download window above the tip, up to its in-flight
+// limit, so the window is downloaded from all peers at once.
+inline void ScheduleBlockDownload(CNode *pTo) {
+    PruneHeaderChain();
+
+    if (pTo->GetId() == nHeadersSyncPeer) {
+        if (nHeadersRequestTime != 0 && GetTimeMicros() - nHeadersRequestTime > BLOCK_DOWNLOAD_TIMEOUT * 1000000) {
+            LogPrint(BCLog::INFO, "Peer %s is stalling headers download, disconnecting\n", pTo->addr.ToString());
+            pTo->fDisconnect = true;
+            return;
+        }
+
+        if (nHeadersRequestTime == 0 && !fHeadersSynced &&
+            (fHeadersPaused ? headerChain.IsEmpty() : headerChain.Size() < MAX_HEADERS_AHEAD / 2))
+            PushGetHeaders(pTo);
+
+        // the headers sync ended short of the chain of the peer, get the rest of it by getblocks
+        if (fHeadersSynced && headerChain.IsEmpty() && pTo->nStartingHeight > chainActive.Height())
+            PushGetBlocks(pTo, chainActive.Tip(), uint256());
+    }
+
+    if (headerChain.IsEmpty())
+        return;
+
+    CBlockIndex *pTip  = chainActive.Tip();
+    int32_t nMaxHeight = std::min(headerChain.GetHeight(), pTip->height + BLOCK_DOWNLOAD_WINDOW);
+    // the other peers are only asked for the blocks up to the height they announced
+    if (pTo->GetId() != nHeadersSyncPeer)
+        nMaxHeight = std::min(nMaxHeight, pTo->nStartingHeight);
+
+    LOCK(cs_mapNodeState);
+    CNodeState *state = State(pTo->GetId());
+    int32_t nFree     = state->nBlocksInFlightLimit - state->nBlocksInFlight - state->nBlocksToDownload;
+    if (pTo->fDisconnect || nMaxHeight <= pTip->height || nFree <= 0)
+        return;
+
+    // The block above the tip holds the whole window back: take it from a peer slow to deliver it, and
+    // cut down the blocks that peer is asked for at a time
+    int64_t now      = GetTimeMicros();
+    uint256 nextHash = headerChain.GetHash(pTip->height + 1);
+    auto itInFlight  = mapBlocksInFlight.find(nextHash);
+    if (itInFlight != mapBlocksInFlight.end() && std::get<0>(itInFlight->second) != pTo->GetId() &&
+        now - std::get<2>(itInFlight->second) > BLOCK_STALLING_TIMEOUT * 1000000) {
+        CNodeState *stallerState = State(std::get<0>(itInFlight->second));
+        stallerState->nBlocksInFlightLimit =
+            std::max(stallerState->nBlocksInFlightLimit / 2, MIN_BLOCKS_IN_TRANSIT_PER_PEER);
+        LogPrint(BCLog::NET, "peer %s stalls the block download at height %d, ask peer %s for it\n",
+                 stallerState->name, pTip->height + 1, state->name);
+        MarkBlockAsReceived(nextHash);
+    }
+
+    for (int32_t height = pTip->height + 1; height <= nMaxHeight && nFree > 0; height++) {
+        uint256 hash = headerChain.GetHash(height);
+        if (mapBlocksInFlight.count(hash) || mapBlocksToDownload.count(hash) || mapBlockIndex.count(hash) ||
+            mapOrphanBlocks.count(hash))
+            continue;
+
+        list<uint256>::iterator it = state->vBlocksToDownload.insert(state->vBlocksToDownload.end(), hash);
+        state->nBlocksToDownload++;
+        mapBlocksToDownload[hash] = std::make_tuple(pTo->GetId(), it, now);
+        nFree--;
+    }
+}
+
 inline void ProcessGetBlocksMessage(CNode *pFrom, CDataStream &vRecv) {
     CBlockLocator locator;
     uint256 hashStop;
@@ -612,16 +888,8 @@ inline void ProcessGetBlocksMessage(CNode *pFrom, CDataStream &vRecv) {
     }
 }
 
-inline bool ProcessInvMessage(CNode *pFrom, CDataStream &vRecv) {
-    vector<CInv> vInv;
-    vRecv >> vInv;
-    if (vInv.size() > MAX_INV_SZ) {
-        Misbehaving(pFrom->GetId(), 20);
-        return ERRORMSG("message inv size() = %u from peer %s", vInv.size(), pFrom->addrName);
-    }
-
-    LOCK(cs_main);
-
+// Requires cs_main if vInv holds block invs.
+inline bool ProcessInvs(CNode *pFrom, vector<CInv> &vInv) {
     int i = 0;
     for (CInv &inv : vInv) {
         boost::this_thread::interruption_point();
@@ -636,7 +904,7 @@ inline bool ProcessInvMessage(CNode *pFrom, CDataStream &vRecv) {
                     GetTimeMillis(), i, msgName, inv.ToString(), pFrom->addrName);
                 fAlreadyHave = true;
             }
-            if(chainActive.Tip()->GetBlockTime() < GetTime() - 24 * 60 * 60){
+            if(GetTipBlockTime() < GetTime() - 24 * 60 * 60){
                 LogPrint(BCLog::NET, "recv tx inv data when initialBlockDownload,reject it! time_ms=%lld, i=%d, msg=%s, hash=%s, peer=%s\n",
                          GetTimeMillis(), i, msgName, inv.ToString(), pFrom->addrName);
                 fAlreadyHave = true;
@@ -685,6 +953,24 @@ inline bool ProcessInvMessage(CNode *pFrom, CDataStream &vRecv) {
     return true;
 }
 
+inline bool ProcessInvMessage(CNode *pFrom, CDataStream &vRecv) {
+    vector<CInv> vInv;
+    vRecv >> vInv;
+    if (vInv.size() > MAX_INV_SZ) {
+        Misbehaving(pFrom->GetId(), 20);
+        return ERRORMSG("message inv size() = %u from peer %s", vInv.size(), pFrom->addrName);
+    }
+
+    // tx invs are checked against the mempool only, so they don't wait for cs_main while a block is connected
+    bool fHaveBlockInv = std::any_of(vInv.begin(), vInv.end(), [](const CInv &inv) { return inv.type == MSG_BLOCK; });
+    if (fHaveBlockInv) {
+        LOCK(cs_main);
+        return ProcessInvs(pFrom, vInv);
+    }
+
+    return ProcessInvs(pFrom, vInv);
+}
+
 inline bool ProcessGetDataMessage(CNode *pFrom, CDataStream &vRecv) {
     vector<CInv> vInv;
     vRecv >> vInv;
@@ -705,14 +991,8 @@ inline bool ProcessGetDataMessage(CNode *pFrom, CDataStream &vRecv) {
     return true;
 }
 
-inline void ProcessBlockMessage(CNode *pFrom, CDataStream &vRecv) {
-    CBlock block;
-    vRecv >> block;
-
-    LogPrint(BCLog::NET, "recv block! time_ms=%lld, hash=%s, peer=%s\n", GetTimeMillis(),
-        block.GetHash().ToString(), pFrom->addr.ToString());
-    // block.Print();
-
+// Hands a block from a peer, received in full or rebuilt from a compact block, over to ProcessBlock().
+inline void ProcessReceivedBlock(CNode *pFrom, CBlock &block) {
     CInv inv(MSG_BLOCK, block.GetHash());
     pFrom->AddInventoryKnown(inv);
 
@@ -721,6 +1001,10 @@ inline void ProcessBlockMessage(CNode *pFrom, CDataStream &vRecv) {
         LOCK(cs_mapNodeState);
         mapBlockSource[inv.hash] = pFrom->GetId();
         MarkBlockAsReceived(inv.hash, pFrom->GetId());
+
+        CNodeState *state = State(pFrom->GetId());
+        if (state->spPartialBlock && state->spPartialBlock->header.GetHash() == inv.hash)
+            state->spPartialBlock.reset();
     }
 
     LOCK(cs_main);
@@ -734,7 +1018,149 @@ inline void ProcessBlockMessage(CNode *pFrom, CDataStream &vRecv) {
     } else {
         ProcessBlock(state, pFrom, &block);
     }
+}
+
+inline void ProcessBlockMessage(CNode *pFrom, CDataStream &vRecv) {
+    CBlock block;
+    vRecv >> block;
+
+    LogPrint(BCLog::NET, "recv block! time_ms=%lld, hash=%s, peer=%s\n", GetTimeMillis(),
+        block.GetHash().ToString(), pFrom->addr.ToString());
+    // block.Print();
+
+    ProcessReceivedBlock(pFrom, block);
+}
+
+// Falls back to the full block when a compact block can't be rebuilt, the block stays in flight meanwhile.
+inline void RequestFullBlock(CNode *pFrom, const uint256 &hash) {
+    LogPrint(BCLog::NET, "compact block can't be rebuilt, request full block! hash=%s, peer=%s\n", hash.ToString(),
+             pFrom->addr.ToString());
+
+    vector<CInv> vGetData = {CInv(MSG_BLOCK, hash)};
+    pFrom->PushMessage(NetMsgType::GETDATA, vGetData);
+}
+
+inline void ProcessCmpctBlockMessage(CNode *pFrom, CDataStream &vRecv) {
+    CBlockHeaderAndShortTxIDs cmpctBlock;
+    vRecv >> cmpctBlock;
+
+    uint256 hash = cmpctBlock.header.GetHash();
+    LogPrint(BCLog::NET, "recv compact block! time_ms=%lld, hash=%s, short_ids=%u, prefilled=%u, peer=%s\n",
+             GetTimeMillis(), hash.ToString(), cmpctBlock.shortTxIds.size(), cmpctBlock.prefilledTxs.size(),
+             pFrom->addr.ToString());
+
+    {
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hash) || mapOrphanBlocks.count(hash)) {
+            LOCK(cs_mapNodeState);
+            MarkBlockAsReceived(hash, pFrom->GetId());
+            return;
+        }
+    }
+
+    auto spPartialBlock = std::make_shared<CPartialBlock>();
+    ReadStatus status   = spPartialBlock->InitData(cmpctBlock, mempool);
+    if (status == READ_STATUS_INVALID) {
+        {
+            LOCK(cs_mapNodeState);
+            MarkBlockAsReceived(hash);
+        }
+        LogPrint(BCLog::INFO, "Misbehaving: invalid compact block %s, Misbehavior add 100\n", hash.ToString());
+        Misbehaving(pFrom->GetId(), 100);
+        return;
+    } else if (status == READ_STATUS_FAILED) {
+        RequestFullBlock(pFrom, hash);
+        return;
+    }
+
+    if (!spPartialBlock->missingIndexes.empty()) {
+        CBlockTxsRequest req;
+        req.blockHash = hash;
+        req.indexes   = spPartialBlock->missingIndexes;
+        {
+            LOCK(cs_mapNodeState);
+            State(pFrom->GetId())->spPartialBlock = spPartialBlock;
+        }
+        pFrom->PushMessage(NetMsgType::GETBLOCKTXN, req);
+        return;
+    }
+
+    CBlock block;
+    if (spPartialBlock->FillBlock(block, {}) != READ_STATUS_OK) {
+        RequestFullBlock(pFrom, hash);
+        return;
+    }
+
+    ProcessReceivedBlock(pFrom, block);
+}
+
+inline bool ProcessGetBlockTxnMessage(CNode *pFrom, CDataStream &vRecv) {
+    CBlockTxsRequest req;
+    vRecv >> req;
+
+    LOCK(cs_main);
+    auto mi = mapBlockIndex.find(req.blockHash);
+    if (mi == mapBlockIndex.end()) {
+        LogPrint(BCLog::NET, "getblocktxn for unknown block %s from peer %s\n", req.blockHash.ToString(),
+                 pFrom->addr.ToString());
+        return true;
+    }
+
+    CBlock block;
+    if (!ReadBlockFromDisk(mi->second, block))
+        return ERRORMSG("ProcessGetBlockTxnMessage() : read block %s failed", req.blockHash.ToString());
+
+    for (uint32_t index : req.indexes) {
+        if (index >= block.vptx.size()) {
+            Misbehaving(pFrom->GetId(), 100);
+            return ERRORMSG("getblocktxn tx index %u out of block %s from peer %s", index, req.blockHash.ToString(),
+                            pFrom->addr.ToString());
+        }
+    }
+
+    pFrom->PushMessage(NetMsgType::BLOCKTXN, CBlockTxs(block, req));
+
+    return true;
+}
+
+inline void ProcessBlockTxnMessage(CNode *pFrom, CDataStream &vRecv) {
+    CBlockTxs blockTxs;
+    vRecv >> blockTxs;
+
+    std::shared_ptr<CPartialBlock> spPartialBlock;
+    {
+        LOCK(cs_mapNodeState);
+        CNodeState *state = State(pFrom->GetId());
+        if (state->spPartialBlock && state->spPartialBlock->header.GetHash() == blockTxs.blockHash)
+            spPartialBlock.swap(state->spPartialBlock);
+    }
+
+    if (!spPartialBlock) {
+        LogPrint(BCLog::NET, "unexpected blocktxn for block %s from peer %s\n", blockTxs.blockHash.ToString(),
+                 pFrom->addr.ToString());
+        return;
+    }
+
+    CBlock block;
+    ReadStatus status = spPartialBlock->FillBlock(block, blockTxs.vptx);
+    if (status == READ_STATUS_INVALID) {
+        {
+            LOCK(cs_mapNodeState);
+            MarkBlockAsReceived(blockTxs.blockHash);
+        }
+        LogPrint(BCLog::INFO, "Misbehaving: invalid blocktxn for block %s, Misbehavior add 100\n",
+                 blockTxs.blockHash.ToString());
+        Misbehaving(pFrom->GetId(), 100);
+        return;
+    } else if (status == READ_STATUS_FAILED) {
+        RequestFullBlock(pFrom, blockTxs.blockHash);
+        return;
+    }
+
+    LogPrint(BCLog::NET, "recv blocktxn, compact block rebuilt! time_ms=%lld, hash=%s, missing=%u, peer=%s\n",
+             GetTimeMillis(), blockTxs.blockHash.ToString(), blockTxs.vptx.size(), pFrom->addr.ToString());
 
+    ProcessReceivedBlock(pFrom, block);
 }
 
 inline void ProcessMempoolMessage(CNode *pFrom, CDataStream &vRecv) {
@@ -826,7 +1252,7 @@ inline void ProcessFilterAddMessage(CNode *pFrom, CDataStream &vRecv) {
 
 bool ProcessBlockConfirmMessage(CNode *pFrom, CDataStream &vRecv) {
 
-    if(SysCfg().IsReindex()|| GetTime()-chainActive.Tip()->GetBlockTime()>600){
+    if(SysCfg().IsReindex()|| GetTime()-GetTipBlockTime()>600){
         LogPrint(BCLog::NET, "local tip's height is too low,drop the confirm message ") ;
         return false ;
     }
@@ -872,7 +1298,7 @@ bool ProcessBlockConfirmMessage(CNode *pFrom, CDataStream &vRecv) {
 bool ProcessBlockFinalityMessage(CNode *pFrom, CDataStream &vRecv) {
 
 
-    if(SysCfg().IsReindex()|| GetTime()-chainActive.Tip()->GetBlockTime()>600)
+    if(SysCfg().IsReindex()|| GetTime()-GetTipBlockTime()>600)
         return false ;
 
     CPBFTMessageMan<CBlockFinalityMessage>& msgMan = pbftContext.finalityMessageMan ;
@@ -0,0 +1,52 @@
+// Copyright (c) 2017-2019 The WaykiChain Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "headerchain.h"
+
+#include "persistence/block.h"
+
+void CHeaderChain::Reset(const uint256 &hash, int32_t height, uint32_t time) {
+    baseHash   = hash;
+    baseHeight = height;
+    baseTime   = time;
+    vHeaders.clear();
+}
+
+uint256 CHeaderChain::GetHash(int32_t height) const {
+    if (height == baseHeight)
+        return baseHash;
+
+    if (height <= baseHeight || height > GetHeight())
+        return uint256();
+
+    return vHeaders[height - baseHeight - 1].hash;
+}
+
+bool CHeaderChain::Append(const CBlockHeader &header) {
+    if (baseHash.IsNull() || header.GetPrevBlockHash() != GetLastHash() ||
+        (int32_t)header.GetHeight() != GetHeight() + 1)
+        return false;
+
+    vHeaders.push_back({header.GetHash(), header.GetTime()});
+    return true;
+}
+
+bool CHeaderChain::Prune(const uint256 &tipHash, int32_t tipHeight, uint32_t tipTime) {
+    if (tipHeight > GetHeight()) {
+        // the tip passed the last header, the headers left are of no use
+        Reset(tipHash, tipHeight, tipTime);
+        return true;
+    }
+
+    if (GetHash(tipHeight) != tipHash) {
+        Reset(tipHash, tipHeight, tipTime);
+        return false;
+    }
+
+    vHeaders.erase(vHeaders.begin(), vHeaders.begin() + (tipHeight - baseHeight));
+    baseHash   = tipHash;
+    baseHeight = tipHeight;
+    baseTime   = tipTime;
+    return true;
+}
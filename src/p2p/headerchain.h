@@ -0,0 +1,56 @@
+// Copyright (c) 2017-2019 The WaykiChain Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef P2P_HEADERCHAIN_H
+#define P2P_HEADERCHAIN_H
+
+#include "commons/uint256.h"
+
+#include <deque>
+
+class CBlockHeader;
+
+/**
+ * Block headers ahead of the active chain tip, fetched and validated before their blocks in the initial
+ * sync. It grows from a base block of the active chain, and the blocks of its first headers are downloaded
+ * from many peers at once. Protected by cs_main.
+ */
+class CHeaderChain {
+public:
+    CHeaderChain() : baseHeight(0), baseTime(0) {}
+
+    // Start over from a block of the active chain
+    void Reset(const uint256 &hash, int32_t height, uint32_t time);
+    void Clear() { Reset(uint256(), 0, 0); }
+
+    bool IsEmpty() const { return vHeaders.empty(); }
+    size_t Size() const { return vHeaders.size(); }
+    int32_t GetBaseHeight() const { return baseHeight; }
+    // Height of the last header, the base height when empty
+    int32_t GetHeight() const { return baseHeight + (int32_t)vHeaders.size(); }
+    const uint256 &GetLastHash() const { return vHeaders.empty() ? baseHash : vHeaders.back().hash; }
+    uint32_t GetLastTime() const { return vHeaders.empty() ? baseTime : vHeaders.back().nTime; }
+    // Hash of the header at the height, null when not held
+    uint256 GetHash(int32_t height) const;
+    bool Contains(const uint256 &hash, int32_t height) const { return !hash.IsNull() && GetHash(height) == hash; }
+
+    // Append a header following the last one, false if it doesn't link to it
+    bool Append(const CBlockHeader &header);
+    // Drop the headers up to the new tip of the active chain. Returns false, after restarting from the
+    // tip, when the headers don't lead through it.
+    bool Prune(const uint256 &tipHash, int32_t tipHeight, uint32_t tipTime);
+
+private:
+    struct CHeaderEntry {
+        uint256 hash;
+        uint32_t nTime;
+    };
+
+    uint256 baseHash;
+    int32_t baseHeight;
+    uint32_t baseTime;
+    std::deque<CHeaderEntry> vHeaders;  // vHeaders[i] is at height baseHeight + 1 + i
+};
+
+#endif  // P2P_HEADERCHAIN_H
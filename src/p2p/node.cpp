@@ -22,6 +22,7 @@ CCriticalSection cs_mapNodeState;
 
 NodeId nLastNodeId = 0;
 limitedmap<CInv, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
+CCriticalSection cs_mapAlreadyAskedFor;
 CNode* pnodeSync = nullptr;
 
 
@@ -19,6 +19,7 @@
 #include "p2p/netmessage.h"
 
 class CNode ;
+class CPartialBlock;
 struct CNodeSignals;
 struct CNodeState ;
 
@@ -40,6 +41,7 @@ static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
 static const uint32_t MAX_ADDR_TO_SEND = 1000;
 
 extern limitedmap<CInv, int64_t> mapAlreadyAskedFor;
+extern CCriticalSection cs_mapAlreadyAskedFor;
 
 struct LocalServiceInfo {
     int32_t nScore;
@@ -61,6 +63,8 @@ inline uint32_t SendBufferSize() { return 1000 * SysCfg().GetArg("-maxsendbuffer
 
 CAddress GetLocalAddress(const CNetAddr* paddrPeer = nullptr);
 bool GetLocal(CService& addr, const CNetAddr* paddrPeer = nullptr);
+/** Ends the idle wait of the message handler thread of the node */
+void WakeMessageHandler(const CNode* pNode);
 
 class CNodeStats {
 public:
@@ -111,18 +115,21 @@ struct CNodeState {
     vector<CBlockReject> rejects;
     list<QueuedBlock> vBlocksInFlight;
     int32_t nBlocksInFlight;          // maximun blocks downloading at the same time
+    int32_t nBlocksInFlightLimit;     // blocks asked for at a time, raised by delivered blocks, cut by stalls
     list<uint256> vBlocksToDownload;  // blocks to be downloaded
     int32_t nBlocksToDownload;        // blocks number to be downloaded
     int64_t nLastBlockReceive;        // the latest receiving blocks time
     int64_t nLastBlockProcess;        // the latest processing blocks time
+    std::shared_ptr<CPartialBlock> spPartialBlock;  // compact block waiting for its missing txs
 
     CNodeState() {
-        nMisbehavior      = 0;
-        fShouldBan        = false;
-        nBlocksToDownload = 0;
-        nBlocksInFlight   = 0;
-        nLastBlockReceive = 0;
-        nLastBlockProcess = 0;
+        nMisbehavior         = 0;
+        fShouldBan           = false;
+        nBlocksToDownload    = 0;
+        nBlocksInFlight      = 0;
+        nBlocksInFlightLimit = INITIAL_BLOCKS_IN_TRANSIT_PER_PEER;
+        nLastBlockReceive    = 0;
+        nLastBlockProcess    = 0;
     }
 };
 
@@ -141,6 +148,10 @@ public:
     uint64_t nSendBytes;
     deque<CSerializeData> vSendMsg;
     CCriticalSection cs_vSend;
+    // epoll registration and readiness not served yet, only used by the socket thread
+    bool fPolled;
+    bool fPollRecv;
+    bool fPollSend;
 
     deque<CInv> vRecvGetData;  // strCommand == "getdata 保存的inv
     deque<CNetMessage> vRecvMsg;
@@ -197,6 +208,7 @@ public:
     // flood relay
     vector<CAddress> vAddrToSend;
     mruset<CAddress> setAddrKnown;
+    CCriticalSection cs_vAddrToSend;  // vAddrToSend and setAddrKnown, written for other peers too
     bool fGetAddr;
     set<uint256> setKnown;  // alertHash
 
@@ -225,6 +237,9 @@ public:
             : ssSend(SER_NETWORK, INIT_PROTO_VERSION), setAddrKnown(5000) {
         nServices                = 0;
         hSocket                  = hSocketIn;
+        fPolled                  = false;
+        fPollRecv                = false;
+        fPollSend                = false;
         nRecvVersion             = INIT_PROTO_VERSION;
         nLastSend                = 0;
         nLastRecv                = 0;
@@ -332,15 +347,25 @@ public:
 
     void Release() { nRefCount--; }
 
-    void AddAddressKnown(const CAddress& addr) { setAddrKnown.insert(addr); }
+    void AddAddressKnown(const CAddress& addr) {
+        LOCK(cs_vAddrToSend);
+        setAddrKnown.insert(addr);
+    }
 
-    void AddBlockConfirmMessageKnown(const CBlockConfirmMessage msg){ setBlockConfirmMsgKnown.insert(msg); }
-    void AddBlockFinalityMessageKnown(const CBlockFinalityMessage msg){ setBlockFinalityMsgKnown.insert(msg); }
+    void AddBlockConfirmMessageKnown(const CBlockConfirmMessage msg){
+        LOCK(cs_blockConfirm);
+        setBlockConfirmMsgKnown.insert(msg);
+    }
+    void AddBlockFinalityMessageKnown(const CBlockFinalityMessage msg){
+        LOCK(cs_blockFinality);
+        setBlockFinalityMsgKnown.insert(msg);
+    }
 
     void PushAddress(const CAddress& addr) {
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_vAddrToSend);
         if (addr.IsValid() && !setAddrKnown.count(addr)) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand() % vAddrToSend.size()] = addr;
@@ -369,6 +394,9 @@ public:
                 vInventoryToSend.push_back(inv);
 
         }
+        // blocks are announced right away rather than on the next idle round of the message handler
+        if (inv.type == MSG_BLOCK)
+            WakeMessageHandler(this);
     }
 
     void PushBlockConfirmMessage(const CBlockConfirmMessage& msg) {
@@ -394,6 +422,7 @@ public:
 
         // We're using mapAskFor as a priority queue,
         // the key is the earliest time the request can be sent
+        LOCK(cs_mapAlreadyAskedFor);
         int64_t nRequestTime;
         limitedmap<CInv, int64_t>::const_iterator it = mapAlreadyAskedFor.find(inv);
         if (it != mapAlreadyAskedFor.end())
@@ -475,6 +504,18 @@ public:
             LEAVE_CRITICAL_SECTION(cs_vSend);
     }
 
+    // Queue a message framed ahead of time, header and checksum included
+    void PushRawMessage(const CSerializeData& msg) {
+        LOCK(cs_vSend);
+        LogPrint(BCLog::NET, "sending: raw message (%d bytes)\n", msg.size());
+
+        deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), msg);
+        nSendSize += (*it).size();
+
+        // If write queue empty, attempt "optimistic write"
+        if (it == vSendMsg.begin()) SocketSendData();
+    }
+
     void PushVersion();
 
     void PushMessage(const char* pszCommand) {
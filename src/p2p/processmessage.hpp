@@ -61,6 +61,11 @@ bool static ProcessMessage(CNode *pFrom, string strCommand, CDataStream &vRecv)
             return true;
     }
 
+    else if (strCommand == NetMsgType::HEADERS && !SysCfg().IsImporting() && !SysCfg().IsReindex()) {
+        if (!ProcessHeadersMessage(pFrom, vRecv))
+            return false;
+    }
+
     else if (strCommand == NetMsgType::TX) {
         if (!ProcessTxMessage(pFrom, strCommand, vRecv))
             return false;
@@ -72,8 +77,24 @@ bool static ProcessMessage(CNode *pFrom, string strCommand, CDataStream &vRecv)
         ProcessBlockMessage(pFrom, vRecv);
     }
 
+    else if (strCommand == NetMsgType::CMPCTBLOCK && !SysCfg().IsImporting() && !SysCfg().IsReindex()) {
+        ProcessCmpctBlockMessage(pFrom, vRecv);
+    }
+
+    else if (strCommand == NetMsgType::GETBLOCKTXN) {
+        if (!ProcessGetBlockTxnMessage(pFrom, vRecv))
+            return false;
+    }
+
+    else if (strCommand == NetMsgType::BLOCKTXN && !SysCfg().IsImporting() && !SysCfg().IsReindex()) {
+        ProcessBlockTxnMessage(pFrom, vRecv);
+    }
+
     else if (strCommand == NetMsgType::GETADDR) {
-        pFrom->vAddrToSend.clear();
+        {
+            LOCK(pFrom->cs_vAddrToSend);
+            pFrom->vAddrToSend.clear();
+        }
         vector<CAddress> vAddr = addrman.GetAddr();
         for (const auto &addr : vAddr)
             pFrom->PushAddress(addr);
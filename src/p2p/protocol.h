@@ -62,6 +62,8 @@ class CMessageHeader
 enum
 {
     NODE_NETWORK = (1 << 0),
+    // The node serves blocks as "cmpctblock" and the missing txs as "blocktxn", see blockencodings.h
+    NODE_COMPACT_BLOCKS = (1 << 1),
 };
 
 
@@ -131,7 +133,7 @@ extern const char *TX;
  * @since protocol version 31800.
  * @see https://bitcoin.org/en/developer-reference#headers
  */
-// extern const char *HEADERS;
+extern const char *HEADERS;
 /**
  * The block message transmits a single serialized block.
  * @see https://bitcoin.org/en/developer-reference#block
@@ -229,19 +231,17 @@ extern const char *SENDCMPCT;
 /**
  * Contains a CBlockHeaderAndShortTxIDs object - providing a header and
  * list of "short txids".
- * @since protocol version 70014 as described by BIP 152
+ * Sent in response to a MSG_CMPCT_BLOCK getdata to peers with NODE_COMPACT_BLOCKS.
  */
 extern const char *CMPCTBLOCK;
 /**
- * Contains a BlockTransactionsRequest
+ * Contains a CBlockTxsRequest
  * Peer should respond with "blocktxn" message.
- * @since protocol version 70014 as described by BIP 152
  */
 extern const char *GETBLOCKTXN;
 /**
- * Contains a BlockTransactions.
+ * Contains a CBlockTxs.
  * Sent in response to a "getblocktxn" message.
- * @since protocol version 70014 as described by BIP 152
  */
 extern const char *BLOCKTXN;
 
@@ -383,6 +383,8 @@ enum
     // Nodes may always request a MSG_FILTERED_BLOCK in a getdata, however,
     // MSG_FILTERED_BLOCK should not appear in any invs except as a part of getdata.
     MSG_FILTERED_BLOCK,
+    // Requests a compact block in getdata, never appears in invs
+    MSG_CMPCT_BLOCK,
 };
 
 #endif // __INCLUDED_PROTOCOL_H__
@@ -0,0 +1,84 @@
+// Copyright (c) 2017-2019 The WaykiChain Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rawblockcache.h"
+
+#include "commons/util/util.h"
+#include "config/const.h"
+#include "crypto/hash.h"
+#include "p2p/protocol.h"
+#include "persistence/block.h"
+
+#include <algorithm>
+
+static CRawBlockCache rawBlockCache(RAW_BLOCK_CACHE_SIZE);
+
+std::shared_ptr<const CSerializeData> CRawBlockCache::Get(const uint256 &hash) {
+    LOCK(cs_rawBlockCache);
+    auto it = mapEntries.find(hash);
+    if (it == mapEntries.end())
+        return nullptr;
+
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->second;
+}
+
+void CRawBlockCache::Add(const uint256 &hash, const std::shared_ptr<const CSerializeData> &spMsg) {
+    if (spMsg->size() > nMaxSize)
+        return;
+
+    LOCK(cs_rawBlockCache);
+    if (mapEntries.count(hash))
+        return;
+
+    while (!lru.empty() && nSize + spMsg->size() > nMaxSize) {
+        nSize -= lru.back().second->size();
+        mapEntries.erase(lru.back().first);
+        lru.pop_back();
+    }
+
+    mapEntries[hash] = lru.insert(lru.begin(), std::make_pair(hash, spMsg));
+    nSize += spMsg->size();
+}
+
+std::shared_ptr<const CSerializeData> GetRawBlockMessage(const CBlockIndex *pIndex) {
+    // the cache is filled by the blocks peers ask for, so sync peers catching up on the same range share them
+    auto spMsg = rawBlockCache.Get(pIndex->GetBlockHash());
+    if (spMsg)
+        return spMsg;
+
+    CSerializeData data;
+    if (!ReadRawBlockFromDisk(pIndex->GetBlockPos(), data))
+        return nullptr;
+
+    // the header is within the first bytes: fixed size fields and a signature of at most MAX_SIGNATURE_SIZE
+    CBlockHeader header;
+    try {
+        CDataStream ss(data.data(), data.data() + std::min<size_t>(data.size(), 1024), SER_NETWORK, PROTOCOL_VERSION);
+        ss >> header;
+    } catch (std::exception &e) {
+        LogPrint(BCLog::ERROR, "GetRawBlockMessage() : invalid block header - %s\n", e.what());
+        return nullptr;
+    }
+    if (header.GetHash() != pIndex->GetBlockHash()) {
+        LogPrint(BCLog::ERROR, "GetRawBlockMessage() : block %s on disk doesn't match\n",
+                 pIndex->GetBlockHash().GetHex());
+        return nullptr;
+    }
+
+    CMessageHeader hdr(NetMsgType::BLOCK, data.size());
+    uint256 hash = Hash(data.begin(), data.end());
+    memcpy(&hdr.nChecksum, &hash, sizeof(hdr.nChecksum));
+
+    CDataStream ssMsg(SER_NETWORK, PROTOCOL_VERSION);
+    ssMsg.reserve(CMessageHeader::HEADER_SIZE + data.size());
+    ssMsg << hdr;
+    ssMsg.write(data.data(), data.size());
+
+    auto spNewMsg = std::make_shared<CSerializeData>();
+    ssMsg.GetAndClear(*spNewMsg);
+    rawBlockCache.Add(pIndex->GetBlockHash(), spNewMsg);
+
+    return spNewMsg;
+}
@@ -0,0 +1,46 @@
+// Copyright (c) 2017-2019 The WaykiChain Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef P2P_RAWBLOCKCACHE_H
+#define P2P_RAWBLOCKCACHE_H
+
+#include "commons/serialize.h"
+#include "commons/uint256.h"
+#include "sync.h"
+
+#include <list>
+#include <map>
+#include <memory>
+
+class CBlockIndex;
+
+/**
+ * Recently served blocks, kept as complete "block" messages (header and checksum included) so that
+ * peers syncing the same blocks get them without any disk read or hashing. Bounded by a byte budget,
+ * the least recently served blocks are dropped first.
+ */
+class CRawBlockCache {
+public:
+    explicit CRawBlockCache(size_t nMaxSizeIn) : nMaxSize(nMaxSizeIn), nSize(0) {}
+
+    std::shared_ptr<const CSerializeData> Get(const uint256 &hash);
+    void Add(const uint256 &hash, const std::shared_ptr<const CSerializeData> &spMsg);
+
+private:
+    typedef std::list<std::pair<uint256, std::shared_ptr<const CSerializeData>>> EntryList;
+
+    CCriticalSection cs_rawBlockCache;
+    size_t nMaxSize;
+    size_t nSize;
+    EntryList lru;
+    std::map<uint256, EntryList::iterator> mapEntries;
+};
+
+/**
+ * The "block" message of the block, built from the bytes stored on disk without deserializing its
+ * txs. Returns nullptr if the block can't be read.
+ */
+std::shared_ptr<const CSerializeData> GetRawBlockMessage(const CBlockIndex *pIndex);
+
+#endif  // P2P_RAWBLOCKCACHE_H
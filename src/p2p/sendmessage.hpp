@@ -68,11 +68,16 @@ bool SendMessages(CNode *pTo, bool fSendTrickle) {
             //LogPrint(BCLog::NET, "send ping: %s\n", DateTimeStrFormat("YYYY-MM-DDTHH-MM-SS", pTo->nPingUsecStart).c_str());
         }
 
+        // Near the tip, blocks are asked for as compact blocks, rebuilt from the mempool
+        bool fCompactBlocks = false;
         {
             TRY_LOCK(cs_main, lockMain);  // Acquire cs_main for IsInitialBlockDownload() and CNodeState()
             if (!lockMain)
                 return true;
 
+            fCompactBlocks = (nLocalServices & NODE_COMPACT_BLOCKS) && (pTo->nServices & NODE_COMPACT_BLOCKS) &&
+                             !IsInitialBlockDownload();
+
             // Address refresh broadcast
             static int64_t nLastRebroadcast;
             if (!IsInitialBlockDownload() && (GetTime() - nLastRebroadcast > 24 * 60 * 60)) {
@@ -80,8 +85,10 @@ bool SendMessages(CNode *pTo, bool fSendTrickle) {
                     LOCK(cs_vNodes);
                     for (auto pNode : vNodes) {
                         // Periodically clear setAddrKnown to allow refresh broadcasts
-                        if (nLastRebroadcast)
+                        if (nLastRebroadcast) {
+                            LOCK(pNode->cs_vAddrToSend);
                             pNode->setAddrKnown.clear();
+                        }
 
                         // Rebroadcast our address
                         if (!fNoListen) {
@@ -98,6 +105,7 @@ bool SendMessages(CNode *pTo, bool fSendTrickle) {
             // Message: addr
             //
             if (fSendTrickle) {
+                LOCK(pTo->cs_vAddrToSend);
                 vector<CAddress> vAddr;
                 vAddr.reserve(pTo->vAddrToSend.size());
                 for (const auto &addr : pTo->vAddrToSend) {
@@ -120,10 +128,19 @@ bool SendMessages(CNode *pTo, bool fSendTrickle) {
             if (pTo->fStartSync && !SysCfg().IsImporting() && !SysCfg().IsReindex()) {
                 pTo->fStartSync = false;
                 nSyncTipHeight  = pTo->nStartingHeight;
-                LogPrint(BCLog::NET, "start block sync lead to getblocks\n");
-                PushGetBlocks(pTo, chainActive.Tip(), uint256());
+                if (SysCfg().GetBoolArg("-headerssync", DEFAULT_HEADERS_SYNC)) {
+                    LogPrint(BCLog::NET, "start block sync lead to getheaders\n");
+                    StartHeadersSync(pTo);
+                } else {
+                    LogPrint(BCLog::NET, "start block sync lead to getblocks\n");
+                    PushGetBlocks(pTo, chainActive.Tip(), uint256());
+                }
             }
 
+            // Headers-first sync: more headers from the sync peer, the blocks of the download window from all
+            if (!SysCfg().IsImporting() && !SysCfg().IsReindex())
+                ScheduleBlockDownload(pTo);
+
             // Resend wallet transactions that haven't gotten in a block yet
             // Except during reindex, importing and IBD, when old wallet
             // transactions become unconfirmed and spams other nodes.
@@ -218,12 +235,13 @@ bool SendMessages(CNode *pTo, bool fSendTrickle) {
         //
         vector<CInv> vGetData;
         int32_t index = 0;
-        while (!pTo->fDisconnect && state.nBlocksToDownload && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        while (!pTo->fDisconnect && state.nBlocksToDownload && state.nBlocksInFlight < state.nBlocksInFlightLimit) {
             uint256 hash = state.vBlocksToDownload.front();
-            vGetData.push_back(CInv(MSG_BLOCK, hash));
+            CInv inv(fCompactBlocks ? MSG_CMPCT_BLOCK : MSG_BLOCK, hash);
+            vGetData.push_back(inv);
             MarkBlockAsInFlight(hash, pTo->GetId());
-            LogPrint(BCLog::NET, "send MSG_BLOCK msg! time_ms=%lld, hash=%s, peer=%s, FlightBlocks=%d, index=%d\n",
-                GetTimeMillis(), hash.ToString(), state.name, state.nBlocksInFlight, index++);
+            LogPrint(BCLog::NET, "send %s msg! time_ms=%lld, hash=%s, peer=%s, FlightBlocks=%d, index=%d\n",
+                inv.GetCommand(), GetTimeMillis(), hash.ToString(), state.name, state.nBlocksInFlight, index++);
             if (vGetData.size() >= 1000) {
                 pTo->PushMessage(NetMsgType::GETDATA, vGetData);
                 vGetData.clear();
@@ -108,6 +108,12 @@ public:
         nickId2KeyIdCache.RegisterUndoFunc(undoDataFuncMap);
         accountCache.RegisterUndoFunc(undoDataFuncMap);
     }
+
+    void RegisterDiscardFunc(DiscardDataFuncMap &discardDataFuncMap) {
+        regId2KeyIdCache.RegisterDiscardFunc(discardDataFuncMap);
+        nickId2KeyIdCache.RegisterDiscardFunc(discardDataFuncMap);
+        accountCache.RegisterDiscardFunc(discardDataFuncMap);
+    }
 public:
 /*  CCompositeKVCache     prefixType            key              value           variable           */
 /*  -------------------- --------------------   --------------  -------------   --------------------- */
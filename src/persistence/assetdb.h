@@ -80,6 +80,11 @@ public:
         assetTradingPairCache.RegisterUndoFunc(undoDataFuncMap);
     }
 
+    void RegisterDiscardFunc(DiscardDataFuncMap &discardDataFuncMap) {
+        assetCache.RegisterDiscardFunc(discardDataFuncMap);
+        assetTradingPairCache.RegisterDiscardFunc(discardDataFuncMap);
+    }
+
     shared_ptr<CUserAssetsIterator> CreateUserAssetsIterator() {
         return make_shared<CUserAssetsIterator>(assetCache);
     }
@@ -175,6 +175,35 @@ bool ReadBlockFromDisk(const CDiskBlockPos &pos, CBlock &block) {
     return true;
 }
 
+bool ReadRawBlockFromDisk(const CDiskBlockPos &pos, CSerializeData &data) {
+    // the block is stored after the message start and its size, see WriteBlockToDisk()
+    static const uint32_t BLOCK_PREFIX_SIZE = MESSAGE_START_SIZE + sizeof(uint32_t);
+    if (pos.nPos < BLOCK_PREFIX_SIZE)
+        return ERRORMSG("ReadRawBlockFromDisk : invalid block pos %s", pos.ToString());
+
+    CAutoFile filein = CAutoFile(OpenBlockFile(CDiskBlockPos(pos.nFile, pos.nPos - BLOCK_PREFIX_SIZE), true),
+                                 SER_DISK, CLIENT_VERSION);
+    if (!filein)
+        return ERRORMSG("ReadRawBlockFromDisk : OpenBlockFile failed");
+
+    try {
+        MessageStartChars messageStart;
+        uint32_t nSize;
+        filein >> FLATDATA(messageStart) >> nSize;
+        if (memcmp(messageStart, SysCfg().MessageStart(), MESSAGE_START_SIZE) != 0)
+            return ERRORMSG("ReadRawBlockFromDisk : no block at %s", pos.ToString());
+        if (nSize > MAX_BLOCK_SIZE)
+            return ERRORMSG("ReadRawBlockFromDisk : block size %u at %s is too large", nSize, pos.ToString());
+
+        data.resize(nSize);
+        filein.read(data.data(), nSize);
+    } catch (std::exception &e) {
+        return ERRORMSG("%s : I/O error - %s", __func__, e.what());
+    }
+
+    return true;
+}
+
 bool ReadBlockFromDisk(const CBlockIndex *pIndex, CBlock &block) {
     if (!ReadBlockFromDisk(pIndex->GetBlockPos(), block))
         return false;
@@ -469,6 +469,8 @@ struct CBlockLocator {
 bool WriteBlockToDisk(CBlock &block, CDiskBlockPos &pos);
 bool ReadBlockFromDisk(const CDiskBlockPos &pos, CBlock &block);
 bool ReadBlockFromDisk(const CBlockIndex *pIndex, CBlock &block);
+/** Read the serialized block as stored on disk, which is also its network serialization */
+bool ReadRawBlockFromDisk(const CDiskBlockPos &pos, CSerializeData &data);
 
 
 bool ReadBaseTxFromDisk(const CTxCord txCord, std::shared_ptr<CBaseTx> &pTx);
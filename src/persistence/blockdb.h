@@ -101,6 +101,16 @@ public:
         finalityBlockCache.RegisterUndoFunc(undoDataFuncMap);
     }
 
+    void RegisterDiscardFunc(DiscardDataFuncMap &discardDataFuncMap) {
+        txDiskPosCache.RegisterDiscardFunc(discardDataFuncMap);
+        flagCache.RegisterDiscardFunc(discardDataFuncMap);
+        bestBlockHashCache.RegisterDiscardFunc(discardDataFuncMap);
+        lastBlockFileCache.RegisterDiscardFunc(discardDataFuncMap);
+        medianPricesCache.RegisterDiscardFunc(discardDataFuncMap);
+        reindexCache.RegisterDiscardFunc(discardDataFuncMap);
+        finalityBlockCache.RegisterDiscardFunc(discardDataFuncMap);
+    }
+
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool SetTxIndex(const uint256 &txid, const CDiskTxPos &pos);
     bool WriteTxIndexes(const vector<pair<uint256, CDiskTxPos> > &list);
@@ -144,55 +144,97 @@ UndoDataFuncMap CCacheWrapper::GetUndoDataFuncMap() {
     return undoDataFuncMap;
 }
 
+DiscardDataFuncMap CCacheWrapper::GetDiscardDataFuncMap() {
+    DiscardDataFuncMap discardDataFuncMap;
+    sysParamCache.RegisterDiscardFunc(discardDataFuncMap);
+    blockCache.RegisterDiscardFunc(discardDataFuncMap);
+    accountCache.RegisterDiscardFunc(discardDataFuncMap);
+    assetCache.RegisterDiscardFunc(discardDataFuncMap);
+    contractCache.RegisterDiscardFunc(discardDataFuncMap);
+    delegateCache.RegisterDiscardFunc(discardDataFuncMap);
+    cdpCache.RegisterDiscardFunc(discardDataFuncMap);
+    closedCdpCache.RegisterDiscardFunc(discardDataFuncMap);
+    dexCache.RegisterDiscardFunc(discardDataFuncMap);
+    txReceiptCache.RegisterDiscardFunc(discardDataFuncMap);
+    txUtxoCache.RegisterDiscardFunc(discardDataFuncMap);
+    sysGovernCache.RegisterDiscardFunc(discardDataFuncMap);
+    return discardDataFuncMap;
+}
+
+void CCacheWrapper::DiscardData(const CDbKeySet &keys) {
+    DiscardDataFuncMap discardDataFuncMap = GetDiscardDataFuncMap();
+    for (const auto &item : keys.GetMap()) {
+        auto it = discardDataFuncMap.find(dbk::ParseKeyPrefixType(item.first));
+        if (it == discardDataFuncMap.end())
+            continue;
+
+        for (const auto &key : item.second)
+            it->second(key);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // class CCacheDBManager
 
-CCacheDBManager::CCacheDBManager(bool fReIndex, bool fMemory) {
+CCacheDBManager::CCacheDBManager(bool fReIndex, bool fMemory, bool fUnifiedDbIn) : fUnifiedDb(fUnifiedDbIn) {
     const boost::filesystem::path& dbDir = GetDataDir() / "blocks";
-    pSysParamDb     = new CDBAccess(dbDir, DBNameType::SYSPARAM, false, fReIndex);
+    nDbCacheBudget = GetDbCacheBudget();
+    LogPrint(BCLog::INFO, "Using %.1f MiB for the chain state database caches\n", nDbCacheBudget / 1048576.0);
+    nStateCacheBudget = (size_t)std::max<int64_t>(0, std::min(SysCfg().GetArg("-statecache", DEFAULT_STATE_CACHE),
+                                                              MAX_STATE_CACHE)) << 20;
+    LogPrint(BCLog::INFO, "Using %.1f MiB for the clean chain state caches\n", nStateCacheBudget / 1048576.0);
+    if (fUnifiedDb) {
+        // one LevelDB for all the prefixes: a single block cache, WAL and compaction thread
+        pUnifiedDb = std::make_shared<CLevelDBWrapper>(
+            dbDir / UNIFIED_DB_NAME, GetDbOptions(UNIFIED_DB_NAME, nDbCacheBudget), false, fReIndex);
+    }
+
+    pSysParamDb     = NewDbAccess(dbDir, DBNameType::SYSPARAM, fReIndex);
     pSysParamCache  = new CSysParamDBCache(pSysParamDb);
 
-    pAccountDb      = new CDBAccess(dbDir, DBNameType::ACCOUNT, false, fReIndex);
+    pAccountDb      = NewDbAccess(dbDir, DBNameType::ACCOUNT, fReIndex);
     pAccountCache   = new CAccountDBCache(pAccountDb);
 
-    pAssetDb        = new CDBAccess(dbDir, DBNameType::ASSET, false, fReIndex);
+    pAssetDb        = NewDbAccess(dbDir, DBNameType::ASSET, fReIndex);
     pAssetCache     = new CAssetDBCache(pAssetDb);
 
-    pContractDb     = new CDBAccess(dbDir, DBNameType::CONTRACT, false, fReIndex);
+    pContractDb     = NewDbAccess(dbDir, DBNameType::CONTRACT, fReIndex);
     pContractCache  = new CContractDBCache(pContractDb);
 
-    pDelegateDb     = new CDBAccess(dbDir, DBNameType::DELEGATE, false, fReIndex);
+    pDelegateDb     = NewDbAccess(dbDir, DBNameType::DELEGATE, fReIndex);
     pDelegateCache  = new CDelegateDBCache(pDelegateDb);
 
-    pCdpDb          = new CDBAccess(dbDir, DBNameType::CDP, false, fReIndex);
+    pCdpDb          = NewDbAccess(dbDir, DBNameType::CDP, fReIndex);
     pCdpCache       = new CCdpDBCache(pCdpDb);
 
-    pClosedCdpDb    = new CDBAccess(dbDir, DBNameType::CLOSEDCDP, false, fReIndex);
+    pClosedCdpDb    = NewDbAccess(dbDir, DBNameType::CLOSEDCDP, fReIndex);
     pClosedCdpCache = new CClosedCdpDBCache(pClosedCdpDb);
 
-    pDexDb          = new CDBAccess(dbDir, DBNameType::DEX, false, fReIndex);
+    pDexDb          = NewDbAccess(dbDir, DBNameType::DEX, fReIndex);
     pDexCache       = new CDexDBCache(pDexDb);
 
     pBlockIndexDb   = new CBlockIndexDB(false, fReIndex);
 
-    pBlockDb        = new CDBAccess(dbDir, DBNameType::BLOCK, false, fReIndex);
+    pBlockDb        = NewDbAccess(dbDir, DBNameType::BLOCK, fReIndex);
     pBlockCache     = new CBlockDBCache(pBlockDb);
 
-    pLogDb          = new CDBAccess(dbDir, DBNameType::LOG, false, fReIndex);
+    pLogDb          = NewDbAccess(dbDir, DBNameType::LOG, fReIndex);
     pLogCache       = new CLogDBCache(pLogDb);
 
-    pReceiptDb      = new CDBAccess(dbDir, DBNameType::RECEIPT, false, fReIndex);
+    pReceiptDb      = NewDbAccess(dbDir, DBNameType::RECEIPT, fReIndex);
     pReceiptCache   = new CTxReceiptDBCache(pReceiptDb);
 
-    pUtxoDb         = new CDBAccess(dbDir, DBNameType::UTXO, false, fReIndex);
+    pUtxoDb         = NewDbAccess(dbDir, DBNameType::UTXO, fReIndex);
     pUtxoCache      = new CTxUTXODBCache(pUtxoDb);
 
-    pSysGovernDb    = new CDBAccess(dbDir, DBNameType::SYSGOVERN, false, fReIndex);
+    pSysGovernDb    = NewDbAccess(dbDir, DBNameType::SYSGOVERN, fReIndex);
     pSysGovernCache = new CSysGovernDBCache(pSysGovernDb);
 
     // memory-only cache
     pTxCache        = new CTxMemCache();
     pPpCache        = new CPricePointMemCache();
+
+    RecoverFlush();
 }
 
 CCacheDBManager::~CCacheDBManager() {
@@ -230,7 +272,86 @@ CCacheDBManager::~CCacheDBManager() {
     delete pPpCache;        pPpCache = nullptr;
 }
 
+size_t CCacheDBManager::GetDbCacheBudget() {
+    // unless set explicitly, scale the budget with the physical memory
+    int64_t nDefaultCache = DEFAULT_DB_CACHE;
+    int64_t nMemory       = GetTotalPhysicalMemory() >> 20;
+    if (nMemory > 0)
+        nDefaultCache = std::max(DEFAULT_DB_CACHE, std::min(nMemory / 32, MAX_DB_CACHE / 4));
+
+    int64_t nCache = SysCfg().GetArg("-dbcache", nDefaultCache);
+    nCache         = std::max(MIN_DB_CACHE, std::min(nCache, MAX_DB_CACHE));
+
+    return (size_t)nCache << 20;
+}
+
+/**
+ * Options of the LevelDB named dbName. Every option can be set per db as -<dbname>.<option>
+ * (a [<dbname>] section in the config file), falling back to -db<option> then to the default.
+ */
+CLevelDBOptions CCacheDBManager::GetDbOptions(const string &dbName, size_t nDefaultCacheSize) {
+    const string prefix = "-" + dbName + ".";
+    auto GetDbArg = [&](const string &option, int64_t nDefault) {
+        return SysCfg().GetArg(prefix + option, SysCfg().GetArg("-db" + option, nDefault));
+    };
+
+    size_t nCacheSize = nDefaultCacheSize;
+    if (SysCfg().IsArgCount(prefix + "cache"))
+        nCacheSize = (size_t)std::max<int64_t>(1, SysCfg().GetArg(prefix + "cache", 0)) << 20;
+
+    CLevelDBOptions dbOptions(nCacheSize);
+    if (SysCfg().IsArgCount(prefix + "writebuffer") || SysCfg().IsArgCount("-dbwritebuffer"))
+        dbOptions.nWriteBufferSize = (size_t)std::max<int64_t>(1, GetDbArg("writebuffer", 0)) << 20;
+
+    dbOptions.nBloomBits    = std::max<int64_t>(0, GetDbArg("bloombits", DEFAULT_DB_BLOOM_BITS));
+    dbOptions.fCompression  = GetDbArg("compression", DEFAULT_DB_COMPRESSION) != 0;
+    dbOptions.nMaxOpenFiles = std::max<int64_t>(MIN_DB_MAX_OPEN_FILES, GetDbArg("maxopenfiles", DEFAULT_DB_MAX_OPEN_FILES));
+
+    return dbOptions;
+}
+
+CDBAccess* CCacheDBManager::NewDbAccess(const boost::filesystem::path &dbDir, DBNameType dbNameType, bool fReIndex) {
+    // the budgets are shared out by the DBCacheSize weights
+    int64_t nTotalWeight = 0;
+    for (int32_t i = 0; i < DBNameType::DB_NAME_COUNT; i++)
+        nTotalWeight += DBCacheSize[i];
+    double share = (double)DBCacheSize[dbNameType] / nTotalWeight;
+
+    CDBAccess *pDbAccess = nullptr;
+    if (pUnifiedDb) {
+        pDbAccess = new CDBAccess(dbNameType, pUnifiedDb);
+    } else {
+        size_t nCacheSize = std::max<size_t>(MIN_DB_CACHE_PER_DB << 20, nDbCacheBudget * share);
+        pDbAccess = new CDBAccess(dbDir, dbNameType, GetDbOptions(::GetDbName(dbNameType), nCacheSize), false, fReIndex);
+    }
+
+    size_t nStateCacheSize = nStateCacheBudget == 0 ? 0 :
+        std::max<size_t>(DEFAULT_STATE_CACHE_PER_DB << 20, nStateCacheBudget * share);
+    pDbAccess->GetCleanCache().SetLimit(nStateCacheSize);
+
+    return pDbAccess;
+}
+
+bool CCacheDBManager::IsStorageModeChanged(bool fUnifiedDb) {
+    const boost::filesystem::path& dbDir = GetDataDir() / "blocks";
+    bool fHasUnified  = boost::filesystem::exists(dbDir / UNIFIED_DB_NAME);
+    bool fHasSeparate = boost::filesystem::exists(dbDir / ::GetDbName(DBNameType::ACCOUNT));
+
+    return fUnifiedDb ? (fHasSeparate && !fHasUnified) : (fHasUnified && !fHasSeparate);
+}
+
+vector<CDBAccess*> CCacheDBManager::GetDbAccesses() const {
+    return {pAccountDb, pAssetDb,   pContractDb, pDelegateDb, pCdpDb,       pClosedCdpDb, pDexDb,
+            pBlockDb,   pLogDb,     pReceiptDb,  pUtxoDb,     pSysGovernDb, pSysParamDb};
+}
+
 bool CCacheDBManager::Flush() {
+    // queue the dirty entries of every prefix into one batch per database
+    vector<CDBAccess*> dbAccesses = GetDbAccesses();
+    auto pUnifiedBatch            = fUnifiedDb ? std::make_shared<CLevelDBBatch>() : nullptr;
+    for (auto pDbAccess : dbAccesses)
+        pDbAccess->BeginFlushBatch(pUnifiedBatch);
+
     if (pSysParamCache) pSysParamCache->Flush();
 
     if (pAccountCache) pAccountCache->Flush();
@@ -265,5 +386,95 @@ bool CCacheDBManager::Flush() {
     // if (pPpCache)
     //     pPpCache->Flush();
 
+    map<DBNameType, std::shared_ptr<CLevelDBBatch>> batches;
+    for (auto pDbAccess : dbAccesses) {
+        auto pBatch = pDbAccess->EndFlushBatch();
+        if (!pBatch->IsEmpty() && pBatch != pUnifiedBatch)
+            batches.emplace(pDbAccess->GetDbNameType(), pBatch);
+    }
+    // all the prefixes share one db, the whole flush is then a single atomic batch
+    if (pUnifiedBatch && !pUnifiedBatch->IsEmpty())
+        batches.emplace(DBNameType::SYSPARAM, pUnifiedBatch);
+
+    return CommitFlush(batches);
+}
+
+/**
+ * Commit the batches of one flush with a single synced write per database. When more than one
+ * database is involved, the batches are first journaled to the sys param db so that a crash in
+ * between leaves a journal to replay at startup instead of a partially flushed state.
+ */
+bool CCacheDBManager::CommitFlush(map<DBNameType, std::shared_ptr<CLevelDBBatch>> &batches) {
+    if (batches.empty())
+        return true;
+
+    int64_t nStart = GetTimeMicros();
+    uint64_t epoch = nFlushEpoch + 1;
+
+    // a single batch is atomic by itself
+    bool fJournal = batches.size() > 1;
+    if (fJournal) {
+        CDBFlushJournal journal;
+        journal.epoch = epoch;
+        for (const auto &item : batches)
+            item.second->GetOps(journal.batches[item.first]);
+
+        CLevelDBBatch journalBatch;
+        journalBatch.Write(dbk::GetKeyPrefix(dbk::FLUSH_JOURNAL), journal);
+        pSysParamDb->WriteBatch(journalBatch, true);
+    }
+
+    uint32_t nOps = ApplyFlush(batches, epoch, fJournal);
+
+    if (SysCfg().IsBenchmark())
+        LogPrint(BCLog::INFO, "- Flush epoch %llu, %u ops to %u databases: %.2fms\n", epoch, nOps,
+                 (uint32_t)batches.size(), 0.001 * (GetTimeMicros() - nStart));
+
     return true;
 }
+
+uint32_t CCacheDBManager::ApplyFlush(map<DBNameType, std::shared_ptr<CLevelDBBatch>> &batches, uint64_t epoch,
+                                     bool fEraseJournal) {
+    uint32_t nOps = 0;
+    for (auto pDbAccess : GetDbAccesses()) {
+        bool fCommit = (pDbAccess == pSysParamDb);
+        auto it      = batches.find(pDbAccess->GetDbNameType());
+        if (it == batches.end() && !fCommit)
+            continue;
+
+        CLevelDBBatch emptyBatch;
+        CLevelDBBatch &batch = (it != batches.end()) ? *it->second : emptyBatch;
+        nOps += batch.GetOpCount();
+        if (fCommit) {
+            // the sys param batch goes last and doubles as the commit marker of the flush
+            if (fEraseJournal)
+                batch.Erase(dbk::GetKeyPrefix(dbk::FLUSH_JOURNAL));
+            batch.Write(dbk::GetKeyPrefix(dbk::FLUSH_EPOCH), epoch);
+        }
+        pDbAccess->WriteBatch(batch, true);
+    }
+    nFlushEpoch = epoch;
+
+    return nOps;
+}
+
+void CCacheDBManager::RecoverFlush() {
+    pSysParamDb->GetData(dbk::FLUSH_EPOCH, nFlushEpoch);
+
+    CDBFlushJournal journal;
+    if (!pSysParamDb->GetData(dbk::FLUSH_JOURNAL, journal))
+        return;
+
+    LogPrint(BCLog::INFO, "Flush of epoch %llu was interrupted (last committed epoch %llu), replaying %u databases\n",
+             journal.epoch, nFlushEpoch, journal.batches.size());
+
+    // the journal holds the final values of that flush, so applying it again is harmless
+    map<DBNameType, std::shared_ptr<CLevelDBBatch>> batches;
+    for (const auto &item : journal.batches) {
+        auto pBatch = std::make_shared<CLevelDBBatch>();
+        pBatch->AddOps(item.second);
+        batches.emplace((DBNameType)item.first, pBatch);
+    }
+
+    ApplyFlush(batches, journal.epoch, true);
+}
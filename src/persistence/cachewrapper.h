@@ -56,6 +56,10 @@ public:
     void Flush();
 
     UndoDataFuncMap GetUndoDataFuncMap();
+    DiscardDataFuncMap GetDiscardDataFuncMap();
+
+    // drop the values of the keys from the caches of this wrapper, to read them from the base again
+    void DiscardData(const CDbKeySet &keys);
 
     void SetDbOpLogMap(CDBOpLogMap *pDbOpLogMap);
 private:
@@ -112,11 +116,40 @@ public:
     CPricePointMemCache *pPpCache;
 
 public:
-    CCacheDBManager(bool fReIndex, bool fMemory);
+    CCacheDBManager(bool fReIndex, bool fMemory, bool fUnifiedDbIn = false);
 
     ~CCacheDBManager();
 
     bool Flush();
+
+    uint64_t GetFlushEpoch() const { return nFlushEpoch; }
+    bool IsUnifiedDb() const { return fUnifiedDb; }
+
+    // whether the data dir was created with the other storage mode
+    static bool IsStorageModeChanged(bool fUnifiedDb);
+
+private:
+    // all prefixes in one LevelDB instead of one LevelDB per DBNameType
+    bool fUnifiedDb = false;
+    std::shared_ptr<CLevelDBWrapper> pUnifiedDb = nullptr;
+    // bytes of LevelDB caches shared by the state dbs
+    size_t nDbCacheBudget = 0;
+    // bytes of clean values kept by the top level caches, shared out like nDbCacheBudget
+    size_t nStateCacheBudget = 0;
+
+    static size_t GetDbCacheBudget();
+    static CLevelDBOptions GetDbOptions(const string &dbName, size_t nDefaultCacheSize);
+
+    // epoch of the last committed flush
+    uint64_t nFlushEpoch = 0;
+
+    // all state databases, the sys param db holding the flush journal comes last
+    CDBAccess* NewDbAccess(const boost::filesystem::path &dbDir, DBNameType dbNameType, bool fReIndex);
+    vector<CDBAccess*> GetDbAccesses() const;
+    bool CommitFlush(map<DBNameType, std::shared_ptr<CLevelDBBatch>> &batches);
+    uint32_t ApplyFlush(map<DBNameType, std::shared_ptr<CLevelDBBatch>> &batches, uint64_t epoch,
+                        bool fEraseJournal);
+    void RecoverFlush();
 };  // CCacheDBManager
 
 #endif //PERSIST_CACHEWRAPPER_H
\ No newline at end of file
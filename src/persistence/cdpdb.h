@@ -62,6 +62,14 @@ public:
         cdpRatioSortedCache.RegisterUndoFunc(undoDataFuncMap);
     }
 
+    void RegisterDiscardFunc(DiscardDataFuncMap &discardDataFuncMap) {
+        cdpGlobalDataCache.RegisterDiscardFunc(discardDataFuncMap);
+        cdpCache.RegisterDiscardFunc(discardDataFuncMap);
+        userCdpCache.RegisterDiscardFunc(discardDataFuncMap);
+        cdpCoinPairsCache.RegisterDiscardFunc(discardDataFuncMap);
+        cdpRatioSortedCache.RegisterDiscardFunc(discardDataFuncMap);
+    }
+
     uint32_t GetCacheSize() const;
     bool Flush();
 private:
@@ -143,6 +151,11 @@ public:
         closedCdpTxCache.RegisterUndoFunc(undoDataFuncMap);
         closedTxCdpCache.RegisterUndoFunc(undoDataFuncMap);
     }
+
+    void RegisterDiscardFunc(DiscardDataFuncMap &discardDataFuncMap) {
+        closedCdpTxCache.RegisterDiscardFunc(discardDataFuncMap);
+        closedTxCdpCache.RegisterDiscardFunc(discardDataFuncMap);
+    }
 private:
     CdpRatioSortedCache::KeyType MakeCdpRatioSortedKey(const CUserCDP &cdp);
 public:
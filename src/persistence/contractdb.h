@@ -119,6 +119,13 @@ public:
         contractTracesCache.RegisterUndoFunc(undoDataFuncMap);
     }
 
+    void RegisterDiscardFunc(DiscardDataFuncMap &discardDataFuncMap) {
+        contractCache.RegisterDiscardFunc(discardDataFuncMap);
+        contractDataCache.RegisterDiscardFunc(discardDataFuncMap);
+        contractAccountCache.RegisterDiscardFunc(discardDataFuncMap);
+        contractTracesCache.RegisterDiscardFunc(discardDataFuncMap);
+    }
+
     shared_ptr<CDBContractDataIterator> CreateContractDataIterator(const CRegID &contractRegid,
         const string &contractKeyPrefix);
 
@@ -10,6 +10,11 @@
 #include "dbconf.h"
 #include "leveldbwrapper.h"
 
+#include <atomic>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -264,11 +269,148 @@ namespace db_util {
 typedef void(UndoDataFunc)(const CDbOpLogs &pDbOpLogs);
 typedef std::map<dbk::PrefixType, std::function<UndoDataFunc>> UndoDataFuncMap;
 
+typedef void(DiscardDataFunc)(const string &key);
+typedef std::map<dbk::PrefixType, std::function<DiscardDataFunc>> DiscardDataFuncMap;
+
+/**
+ * Caches shared by threads executing txs concurrently, each of them on its own child CCacheWrapper.
+ * While a CConcurrentReads scope is active, the reads reaching a shared cache are serialized and the
+ * clean caches defer their evictions, so that the values handed out stay valid until the scope ends.
+ * Range reads would walk the shared maps unlocked, they are refused by throwing. The shared caches
+ * must not be written to while the scope is active.
+ */
+class CConcurrentReads {
+public:
+    CConcurrentReads() { fActive = true; }
+    ~CConcurrentReads() { fActive = false; }
+
+    static bool IsActive() { return fActive; }
+
+    // holds the reads lock while a scope is active, if the cache locking it is shared
+    class Lock {
+    public:
+        explicit Lock(bool fShared) : lock(mtx, std::defer_lock) {
+            if (fShared && fActive)
+                lock.lock();
+        }
+
+    private:
+        std::unique_lock<std::recursive_mutex> lock;
+    };
+
+    static void CheckRangeRead() {
+        if (fActive) {
+            fRangeReadRefused = true;
+            throw runtime_error("range read refused while reading caches concurrently");
+        }
+    }
+
+    // whether a range read was refused on this thread since the last call, in case the tx executed
+    // caught the exception
+    static bool TakeRangeReadRefused() {
+        bool fRefused     = fRangeReadRefused;
+        fRangeReadRefused = false;
+        return fRefused;
+    }
+
+private:
+    inline static std::atomic<bool> fActive{false};
+    inline static std::recursive_mutex mtx;
+    inline static thread_local bool fRangeReadRefused = false;
+};
+
+class CCleanCacheOwner {
+public:
+    virtual ~CCleanCacheOwner() {}
+    // drop the clean value of the key at pKey, called when CCleanCache evicts it
+    virtual void EvictCleanData(const void *pKey) const = 0;
+};
+
+/**
+ * Byte budget and LRU order of the clean values (equal to what is stored in the db) that the top
+ * level caches of a db keep in memory. The values of all the caches sharing a CDBAccess are
+ * evicted in one LRU order, so that each keeps its hot keys resident.
+ */
+class CCleanCache {
+public:
+    struct Entry {
+        const CCleanCacheOwner *pOwner;
+        const void *pKey;
+        uint32_t size;
+    };
+    typedef std::list<Entry>::iterator Iterator;
+
+    explicit CCleanCache(uint64_t nLimitIn) : nLimit(nLimitIn) {}
+
+    void SetLimit(uint64_t nLimitIn) {
+        nLimit = nLimitIn;
+        Evict(0);
+    }
+
+    uint64_t GetLimit() const { return nLimit; }
+    uint64_t GetSize() const { return nSize; }
+    size_t GetCount() const { return lru.size(); }
+
+    // evict the least recently used values until size bytes fit in, false if they never can
+    bool Reserve(uint32_t size) {
+        if (size > nLimit)
+            return false;
+        Evict(size);
+        return true;
+    }
+
+    // must follow a successful Reserve(size)
+    Iterator Add(const CCleanCacheOwner *pOwner, const void *pKey, uint32_t size) {
+        nSize += size;
+        return lru.insert(lru.begin(), Entry{pOwner, pKey, size});
+    }
+
+    void Touch(Iterator it) { lru.splice(lru.begin(), lru, it); }
+
+    void Remove(Iterator it) {
+        nSize -= it->size;
+        lru.erase(it);
+    }
+
+private:
+    void Evict(uint64_t nRoom) {
+        // caught up by the next Reserve() after the concurrent reads
+        if (CConcurrentReads::IsActive())
+            return;
+
+        while (!lru.empty() && nSize + nRoom > nLimit) {
+            Entry entry = lru.back();
+            lru.pop_back();
+            nSize -= entry.size;
+            entry.pOwner->EvictCleanData(entry.pKey);
+        }
+    }
+
+    std::list<Entry> lru;
+    uint64_t nLimit;
+    uint64_t nSize = 0;
+};
+
 class CDBAccess {
 public:
     CDBAccess(const boost::filesystem::path& dir, DBNameType dbNameTypeIn, bool fMemory, bool fWipe) :
               dbNameType(dbNameTypeIn),
-              db( dir / ::GetDbName(dbNameTypeIn), DBCacheSize[dbNameTypeIn], fMemory, fWipe ) {}
+              pDb(std::make_shared<CLevelDBWrapper>(dir / ::GetDbName(dbNameTypeIn), DBCacheSize[dbNameTypeIn],
+                                                    fMemory, fWipe)),
+              db(*pDb), cleanCache(DEFAULT_STATE_CACHE_PER_DB << 20) {}
+
+    CDBAccess(const boost::filesystem::path& dir, DBNameType dbNameTypeIn, const CLevelDBOptions &dbOptions,
+              bool fMemory, bool fWipe) :
+              dbNameType(dbNameTypeIn),
+              pDb(std::make_shared<CLevelDBWrapper>(dir / ::GetDbName(dbNameTypeIn), dbOptions, fMemory, fWipe)),
+              db(*pDb), cleanCache(DEFAULT_STATE_CACHE_PER_DB << 20) {}
+
+    /**
+     * Access the prefixes of dbNameTypeIn inside a LevelDB shared with other db name types. The
+     * dbk prefixes are unique across all dbs, so they keep the key spaces apart.
+     */
+    CDBAccess(DBNameType dbNameTypeIn, std::shared_ptr<CLevelDBWrapper> pDbIn) :
+              dbNameType(dbNameTypeIn), pDb(pDbIn), db(*pDb), cleanCache(DEFAULT_STATE_CACHE_PER_DB << 20) {}
 
     int64_t GetDbCount() const { return db.GetDbCount(); }
     template<typename KeyType, typename ValueType>
@@ -452,7 +594,8 @@ public:
 
     template<typename KeyType, typename ValueType>
     void BatchWrite(const dbk::PrefixType prefixType, const map<KeyType, ValueType> &mapData) {
-        CLevelDBBatch batch;
+        CLevelDBBatch localBatch;
+        CLevelDBBatch &batch = pFlushBatch ? *pFlushBatch : localBatch;
         for (auto item : mapData) {
             string key = dbk::GenDbKey(prefixType, item.first);
             if (db_util::IsEmpty(item.second)) {
@@ -461,12 +604,14 @@ public:
                 batch.Write(key, item.second);
             }
         }
-        db.WriteBatch(batch, true);
+        if (!pFlushBatch)
+            db.WriteBatch(batch, true);
     }
 
     template<typename ValueType>
     void BatchWrite(const dbk::PrefixType prefixType, ValueType &value) {
-        CLevelDBBatch batch;
+        CLevelDBBatch localBatch;
+        CLevelDBBatch &batch = pFlushBatch ? *pFlushBatch : localBatch;
         const string prefix = dbk::GetKeyPrefix(prefixType);
 
         if (db_util::IsEmpty(value)) {
@@ -474,21 +619,44 @@ public:
         } else {
             batch.Write(prefix, value);
         }
-        db.WriteBatch(batch, true);
+        if (!pFlushBatch)
+            db.WriteBatch(batch, true);
+    }
+
+    bool WriteBatch(CLevelDBBatch &batch, bool fSync) { return db.WriteBatch(batch, fSync); }
+
+    /**
+     * While a flush batch is open, BatchWrite() queues every prefix into it instead of issuing
+     * a synced write of its own; the flush coordinator then commits the whole batch at once.
+     */
+    void BeginFlushBatch(std::shared_ptr<CLevelDBBatch> pSharedBatch = nullptr) {
+        assert(!pFlushBatch);
+        pFlushBatch = pSharedBatch ? pSharedBatch : std::make_shared<CLevelDBBatch>();
+    }
+
+    std::shared_ptr<CLevelDBBatch> EndFlushBatch() {
+        auto batch = pFlushBatch;
+        pFlushBatch = nullptr;
+        return batch;
     }
 
     DBNameType GetDbNameType() const { return dbNameType; }
 
+    CCleanCache& GetCleanCache() { return cleanCache; }
+
     std::shared_ptr<leveldb::Iterator> NewIterator() {
         return std::shared_ptr<leveldb::Iterator>(db.NewIterator());
     }
 private:
     DBNameType dbNameType;
-    mutable CLevelDBWrapper db; // // TODO: remove the mutable declare
+    std::shared_ptr<CLevelDBWrapper> pDb;
+    CLevelDBWrapper &db;
+    std::shared_ptr<CLevelDBBatch> pFlushBatch = nullptr;
+    CCleanCache cleanCache;
 };
 
 template<int32_t PREFIX_TYPE_VALUE, typename __KeyType, typename __ValueType>
-class CCompositeKVCache {
+class CCompositeKVCache: public CCleanCacheOwner {
 public:
     static const dbk::PrefixType PREFIX_TYPE = (dbk::PrefixType)PREFIX_TYPE_VALUE;
 public:
@@ -496,6 +664,9 @@ public:
     typedef __ValueType ValueType;
     typedef typename std::map<KeyType, ValueType> Map;
     typedef typename std::map<KeyType, ValueType>::iterator Iterator;
+    typedef typename std::map<KeyType, ValueType>::const_iterator ConstIterator;
+    // immutable maps shared by copies of a cache, oldest first
+    typedef std::vector<std::shared_ptr<const Map>> FrozenMaps;
 
 public:
     /**
@@ -514,9 +685,41 @@ public:
         assert(pDbAccess->GetDbNameType() == GetDbNameEnumByPrefix(PREFIX_TYPE));
     };
 
+    CCompositeKVCache(const CCompositeKVCache &other) {
+        operator=(other);
+    }
+
+    ~CCompositeKVCache() {
+        ClearCleanData();
+    }
+
+    /**
+     * Copy on write: the data of other is frozen into an immutable map shared by both caches,
+     * and each of them copies a value into its own mapData only when it modifies it. So copying a
+     * cache (e.g. the fork snapshots of the top level caches) costs O(1) instead of O(cache size).
+     */
+    CCompositeKVCache& operator=(const CCompositeKVCache &other) {
+        if (this == &other)
+            return *this;
+
+        other.Freeze();
+        ClearCleanData();
+        pBase           = other.pBase;
+        pDbAccess       = other.pDbAccess;
+        mapData.clear();
+        frozenMaps      = other.frozenMaps;
+        frozenSize      = other.frozenSize;
+        missingKeys     = other.missingKeys;
+        missingKeyQueue = other.missingKeyQueue;
+        pDbOpLogMap     = other.pDbOpLogMap;
+        is_calc_size    = other.is_calc_size;
+        size            = 0;
+        return *this;
+    }
+
     void SetBase(CCompositeKVCache *pBaseIn) {
         assert(pDbAccess == nullptr);
-        assert(mapData.empty());
+        assert(mapData.empty() && frozenMaps.empty());
         pBase = pBaseIn;
     };
 
@@ -526,11 +729,13 @@ public:
 
     bool IsCalcSize() const { return is_calc_size; }
 
+    // size of the data to be flushed, the clean values are bounded by the CCleanCache of the db
     uint32_t GetCacheSize() const {
-        return size;
+        return size + frozenSize;
     }
 
     bool GetTopNElements(const uint32_t maxNum, set<KeyType> &keys) {
+        AddRangeReadLog();
         // 1. Get all candidate elements.
         set<KeyType> expiredKeys;
         set<KeyType> candidateKeys;
@@ -553,6 +758,7 @@ public:
 
     // map<string, ValueType>
     bool GetAllElements(const KeyType &endKey, Map &elements) {
+        AddRangeReadLog();
         set<KeyType> expiredKeys;
         if (!GetAllElements(endKey, elements, expiredKeys)) {
             // TODO: log
@@ -563,6 +769,7 @@ public:
     }
 
     bool GetAllElements(map<KeyType, ValueType> &elements) {
+        AddRangeReadLog();
         set<KeyType> expiredKeys;
         if (!GetAllElements(expiredKeys, elements)) {
             // TODO: log
@@ -576,9 +783,10 @@ public:
         if (db_util::IsEmpty(key)) {
             return false;
         }
-        auto it = GetDataIt(key);
-        if (it != mapData.end() && !db_util::IsEmpty(it->second)) {
-            value = it->second;
+        AddReadLog(key);
+        const ValueType *pValue = FindData(key);
+        if (pValue != nullptr && !db_util::IsEmpty(*pValue)) {
+            value = *pValue;
             return true;
         }
         return false;
@@ -605,8 +813,9 @@ public:
         if (db_util::IsEmpty(key)) {
             return false;
         }
-        auto it = GetDataIt(key);
-        return it != mapData.end() && !db_util::IsEmpty(it->second);
+        AddReadLog(key);
+        const ValueType *pValue = FindData(key);
+        return pValue != nullptr && !db_util::IsEmpty(*pValue);
     }
 
     bool EraseData(const KeyType &key) {
@@ -625,19 +834,31 @@ public:
 
     void Clear() {
         mapData.clear();
-        size = 0;
+        frozenMaps.clear();
+        size       = 0;
+        frozenSize = 0;
     }
 
     void Flush() {
         assert(pBase != nullptr || pDbAccess != nullptr);
+        Thaw();
         if (pBase != nullptr) {
             assert(pDbAccess == nullptr);
             for (auto it : mapData) {
                 pBase->mapData[it.first] = it.second;
+                pBase->missingKeys.erase(it.first);
+                pBase->EraseCleanData(it.first);
             }
         } else if (pDbAccess != nullptr) {
             assert(pBase == nullptr);
             pDbAccess->BatchWrite<KeyType, ValueType>(PREFIX_TYPE, mapData);
+            // the written values stay resident as clean ones
+            for (auto &item : mapData) {
+                if (db_util::IsEmpty(item.second))
+                    AddMissingKey(item.first);
+                else
+                    AddCleanData(item.first, item.second);
+            }
         }
 
         Clear();
@@ -666,6 +887,37 @@ public:
         undoDataFuncMap[GetPrefixType()] = std::bind(&CCompositeKVCache::UndoDataList, this, std::placeholders::_1);
     }
 
+    // Drop the value of the serialized key from this cache, so that it is read from the base
+    // again. An empty key drops all the values.
+    void DiscardData(const string &keyStr) {
+        if (keyStr.empty()) {
+            Clear();
+            return;
+        }
+
+        KeyType key;
+        CDataStream ssKey(keyStr, SER_DISK, CLIENT_VERSION);
+        ssKey >> key;
+
+        Thaw();
+        auto it = mapData.find(key);
+        if (it != mapData.end()) {
+            DecDataSize(it->first, it->second);
+            mapData.erase(it);
+        }
+    }
+
+    void RegisterDiscardFunc(DiscardDataFuncMap &discardDataFuncMap) {
+        discardDataFuncMap[GetPrefixType()] = std::bind(&CCompositeKVCache::DiscardData, this, std::placeholders::_1);
+    }
+
+    // record a range read over all the keys, e.g. by a CDBIterator
+    void AddRangeReadLog() const {
+        CConcurrentReads::CheckRangeRead();
+        if (pDbOpLogMap != nullptr && pDbOpLogMap->IsReadLogged())
+            pDbOpLogMap->AddReadLog(PREFIX_TYPE, "");
+    }
+
     dbk::PrefixType GetPrefixType() const { return PREFIX_TYPE; }
 
     CDBAccess* GetDbAccessPtr() {
@@ -678,28 +930,115 @@ public:
 
     CCompositeKVCache<PREFIX_TYPE, KeyType, ValueType>* GetBasePtr() { return pBase; }
 
-    map<KeyType, ValueType>& GetMapData() { return mapData; };
+    // merges the frozen maps back first, prefer iterating through CDBIterator which reads them in place
+    map<KeyType, ValueType>& GetMapData() {
+        AddRangeReadLog();
+        Thaw();
+        return mapData;
+    };
+
+    // the data of this cache itself, without the frozen maps
+    const Map& GetOwnMapData() const { return mapData; }
+
+    const FrozenMaps& GetFrozenMaps() const { return frozenMaps; }
+
+    size_t GetCleanDataCount() const { return cleanData.size(); }
+
+    void EvictCleanData(const void *pKey) const {
+        auto it = cleanData.find(*static_cast<const KeyType *>(pKey));
+        if (it != cleanData.end())
+            cleanData.erase(it);
+    }
 private:
-    Iterator GetDataIt(const KeyType &key) const {
-        Iterator it = mapData.find(key);
-        if (it != mapData.end()) {
-            return it;
-        } else if (pBase != nullptr) {
-            // find key-value at base cache
-            auto baseIt = pBase->GetDataIt(key);
-            if (baseIt != pBase->mapData.end()) {
-                // the found key-value add to current mapData
-                return AddDataToMap(key, baseIt->second);
+    // Find the value of key without copying it into mapData, only the top level cache keeps the
+    // values it reads from the db.
+    const ValueType* FindData(const KeyType &key) const {
+        // a top level cache is shared by all the wrappers
+        CConcurrentReads::Lock lock(pDbAccess != nullptr);
+        auto it = mapData.find(key);
+        if (it != mapData.end())
+            return &it->second;
+
+        for (auto frozenIt = frozenMaps.rbegin(); frozenIt != frozenMaps.rend(); frozenIt++) {
+            auto valueIt = (*frozenIt)->find(key);
+            if (valueIt != (*frozenIt)->end())
+                return &valueIt->second;
+        }
+
+        if (pBase != nullptr) {
+            CConcurrentReads::Lock baseLock(true);
+            return pBase->FindData(key);
+        } else if (pDbAccess != nullptr) {
+            auto cleanIt = cleanData.find(key);
+            if (cleanIt != cleanData.end()) {
+                pDbAccess->GetCleanCache().Touch(cleanIt->second.lruIt);
+                return &cleanIt->second.value;
             }
-        } else if (pDbAccess != NULL) {
-            // TODO: need to save the empty value to mapData for search performance?
+            if (missingKeys.count(key))
+                return nullptr;
+
             auto pDbValue = db_util::MakeEmptyValue<ValueType>();
             if (pDbAccess->GetData(PREFIX_TYPE, key, *pDbValue)) {
-                return AddDataToMap(key, *pDbValue);
+                const ValueType *pValue = AddCleanData(key, *pDbValue);
+                if (pValue != nullptr)
+                    return pValue;
+                // too large for the clean cache, keep it with the data to be flushed
+                return &AddDataToMap(key, *pDbValue)->second;
             }
+            AddMissingKey(key);
         }
 
-        return mapData.end();
+        return nullptr;
+    }
+
+    // Get the writable item of key, copying it into mapData when it only exists in the frozen
+    // maps or the base cache.
+    Iterator GetDataIt(const KeyType &key) const {
+        Iterator it = mapData.find(key);
+        if (it != mapData.end())
+            return it;
+
+        const ValueType *pValue = FindData(key);
+        if (pValue == nullptr)
+            return mapData.end();
+
+        // the top level cache has already kept the value read from the db
+        it = mapData.find(key);
+        if (it != mapData.end())
+            return it;
+
+        return AddDataToMap(key, *pValue);
+    }
+
+    // Move mapData into a new frozen map to be shared with a copy of this cache.
+    void Freeze() const {
+        if (mapData.empty())
+            return;
+
+        frozenMaps.push_back(std::make_shared<const Map>(std::move(mapData)));
+        mapData.clear();
+        frozenSize += size;
+        size = 0;
+    }
+
+    // Merge the frozen maps back into mapData, newer values win.
+    void Thaw() const {
+        for (auto frozenIt = frozenMaps.rbegin(); frozenIt != frozenMaps.rend(); frozenIt++) {
+            for (const auto &item : **frozenIt) {
+                if (mapData.emplace(item.first, item.second).second)
+                    IncDataSize(item.first, item.second);
+            }
+        }
+        frozenMaps.clear();
+        frozenSize = 0;
+    }
+
+    // call func on mapData and then on the frozen maps, newest first
+    template <typename Func>
+    void ForEachMap(Func func) const {
+        func(mapData);
+        for (auto frozenIt = frozenMaps.rbegin(); frozenIt != frozenMaps.rend(); frozenIt++)
+            func(**frozenIt);
     }
 
     inline Iterator AddDataToMap(const KeyType &keyIn, const ValueType &valueIn) const {
@@ -707,9 +1046,58 @@ private:
         if (!newRet.second)
             throw runtime_error(strprintf("%s :  %s, alloc new cache item failed", __FUNCTION__, __LINE__));
         IncDataSize(keyIn, valueIn);
+        missingKeys.erase(keyIn);
+        // valueIn may be the clean value itself, so it is dropped only after being copied
+        EraseCleanData(keyIn);
         return newRet.first;
     }
 
+    // Keep a value equal to the one in the db, returns nullptr if it doesn't fit the clean cache.
+    const ValueType* AddCleanData(const KeyType &key, const ValueType &value) const {
+        assert(pDbAccess != nullptr);
+        EraseCleanData(key);
+
+        CCleanCache &cleanCache = pDbAccess->GetCleanCache();
+        uint32_t dataSize = CalcDataSize(key) + CalcDataSize(value);
+        if (!cleanCache.Reserve(dataSize))
+            return nullptr;
+
+        auto ret = cleanData.emplace(key, CCleanItem{value, CCleanCache::Iterator()});
+        ret.first->second.lruIt = cleanCache.Add(this, &ret.first->first, dataSize);
+        missingKeys.erase(key);
+        return &ret.first->second.value;
+    }
+
+    inline void EraseCleanData(const KeyType &key) const {
+        if (cleanData.empty())
+            return;
+
+        auto it = cleanData.find(key);
+        if (it != cleanData.end()) {
+            pDbAccess->GetCleanCache().Remove(it->second.lruIt);
+            cleanData.erase(it);
+        }
+    }
+
+    void ClearCleanData() const {
+        for (auto &item : cleanData)
+            pDbAccess->GetCleanCache().Remove(item.second.lruIt);
+        cleanData.clear();
+    }
+
+    // Remember a key known to be absent from the db, so that probing it again doesn't reach the disk.
+    // The oldest keys are dropped first once MAX_MISSING_KEYS are remembered.
+    inline void AddMissingKey(const KeyType &key) const {
+        if (!missingKeys.insert(key).second)
+            return;
+
+        missingKeyQueue.push_back(key);
+        while (missingKeyQueue.size() > MAX_MISSING_KEYS) {
+            missingKeys.erase(missingKeyQueue.front());
+            missingKeyQueue.pop_front();
+        }
+    }
+
     inline void IncDataSize(const KeyType &keyIn, const ValueType &valueIn) const {
         if (is_calc_size) {
             size += CalcDataSize(keyIn);
@@ -729,6 +1117,13 @@ private:
         }
     }
 
+    inline void DecDataSize(const KeyType &keyIn, const ValueType &valueIn) const {
+        if (is_calc_size) {
+            uint32_t sz = CalcDataSize(keyIn) + CalcDataSize(valueIn);
+            size = size > sz ? size - sz : 0;
+        }
+    }
+
     inline void UpdateDataSize(const ValueType &oldValue, const ValueType &newVvalue) const {
         if (is_calc_size) {
             size += CalcDataSize(newVvalue);
@@ -743,11 +1138,11 @@ private:
     }
 
     bool GetTopNElements(const uint32_t maxNum, set<KeyType> &expiredKeys, set<KeyType> &keys) {
-        if (!mapData.empty()) {
+        ForEachMap([&](const Map &dataMap) {
             uint32_t count = 0;
-            auto iter      = mapData.begin();
+            auto iter      = dataMap.begin();
 
-            for (; (count < maxNum) && iter != mapData.end(); ++iter) {
+            for (; (count < maxNum) && iter != dataMap.end(); ++iter) {
                 if (db_util::IsEmpty(iter->second)) {
                     expiredKeys.insert(iter->first);
                 } else if (expiredKeys.count(iter->first) || keys.count(iter->first)) {
@@ -760,7 +1155,7 @@ private:
                     ++count;
                 }
             }
-        }
+        });
 
         if (pBase != nullptr) {
             return pBase->GetTopNElements(maxNum, expiredKeys, keys);
@@ -773,8 +1168,8 @@ private:
 
     // map<string, ValueType>
     bool GetAllElements(const KeyType &endKey, Map &mapDataOut, set<KeyType> &expiredKeys) {
-        if (!mapData.empty()) {
-            for (auto iter = mapData.begin(); iter != mapData.end() && iter->first < endKey; iter++) {
+        ForEachMap([&](const Map &dataMap) {
+            for (auto iter = dataMap.begin(); iter != dataMap.end() && iter->first < endKey; iter++) {
                 if (!expiredKeys.count(iter->first) && !mapDataOut.count(iter->first)) { // check not got
                     if (db_util::IsEmpty(iter->second)) { // empty, will be deleted
                         expiredKeys.insert(iter->first);
@@ -783,7 +1178,7 @@ private:
                     }
                 }
             }
-        }
+        });
 
         if (pBase != nullptr) {
             return pBase->GetAllElements(endKey, mapDataOut, expiredKeys);
@@ -795,8 +1190,8 @@ private:
     }
 
     bool GetAllElements(set<KeyType> &expiredKeys, map<KeyType, ValueType> &elements) {
-        if (!mapData.empty()) {
-            for (auto iter : mapData) {
+        ForEachMap([&](const Map &dataMap) {
+            for (auto iter : dataMap) {
                 if (db_util::IsEmpty(iter.second)) {
                     expiredKeys.insert(iter.first);
                 } else if (expiredKeys.count(iter.first) || elements.count(iter.first)) {
@@ -807,7 +1202,7 @@ private:
                     elements.insert(iter);
                 }
             }
-        }
+        });
 
         if (pBase != nullptr) {
             return pBase->GetAllElements(expiredKeys, elements);
@@ -833,10 +1228,34 @@ private:
         }
 
     }
+
+    inline void AddReadLog(const KeyType &key) const {
+        if (pDbOpLogMap != nullptr && pDbOpLogMap->IsReadLogged()) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            ssKey << key;
+            pDbOpLogMap->AddReadLog(PREFIX_TYPE, ssKey.str());
+        }
+    }
 private:
+    // max number of absent keys remembered by a top level cache
+    static const uint32_t MAX_MISSING_KEYS = 4096;
+
     mutable CCompositeKVCache<PREFIX_TYPE, KeyType, ValueType> *pBase = nullptr;
     CDBAccess *pDbAccess = nullptr;
     mutable map<KeyType, ValueType> mapData;
+    // data frozen when this cache was copied, shared with the copies and never modified
+    mutable FrozenMaps frozenMaps;
+    mutable uint32_t frozenSize = 0;
+
+    struct CCleanItem {
+        ValueType value;
+        CCleanCache::Iterator lruIt;
+    };
+    // values read from or flushed to the db, only kept by a top level cache (pDbAccess != nullptr)
+    mutable map<KeyType, CCleanItem> cleanData;
+    // keys missing from the db and not in mapData, only filled at the top level (pDbAccess != nullptr)
+    mutable set<KeyType> missingKeys;
+    mutable deque<KeyType> missingKeyQueue;
     CDBOpLogMap *pDbOpLogMap = nullptr;
     bool is_calc_size = false;
     mutable uint32_t size = 0;
@@ -900,6 +1319,7 @@ public:
     }
 
     bool GetData(ValueType &value) const {
+        AddReadLog();
         auto ptr = GetDataPtr();
         if (ptr && !db_util::IsEmpty(*ptr)) {
             value = *ptr;
@@ -918,6 +1338,7 @@ public:
     }
 
     bool HaveData() const {
+        AddReadLog();
         auto ptr = GetDataPtr();
         return ptr && !db_util::IsEmpty(*ptr);
     }
@@ -966,13 +1387,22 @@ public:
         undoDataFuncMap[GetPrefixType()] = std::bind(&CSimpleKVCache::UndoDataList, this, std::placeholders::_1);
     }
 
+    // the value has no key of its own
+    void DiscardData(const string &keyStr) { ptrData = nullptr; }
+
+    void RegisterDiscardFunc(DiscardDataFuncMap &discardDataFuncMap) {
+        discardDataFuncMap[GetPrefixType()] = std::bind(&CSimpleKVCache::DiscardData, this, std::placeholders::_1);
+    }
+
     dbk::PrefixType GetPrefixType() const { return PREFIX_TYPE; }
 
     std::shared_ptr<ValueType> GetDataPtr() const {
-
+        // a top level cache is shared by all the wrappers
+        CConcurrentReads::Lock lock(pDbAccess != nullptr);
         if (ptrData) {
             return ptrData;
         } else if (pBase != nullptr){
+            CConcurrentReads::Lock baseLock(true);
             auto ptr = pBase->GetDataPtr();
             if (ptr) {
                 ptrData = std::make_shared<ValueType>(*ptr);
@@ -999,6 +1429,11 @@ private:
         }
 
     }
+
+    inline void AddReadLog() const {
+        if (pDbOpLogMap != nullptr && pDbOpLogMap->IsReadLogged())
+            pDbOpLogMap->AddReadLog(PREFIX_TYPE, "");
+    }
 private:
     mutable CSimpleKVCache<PREFIX_TYPE, ValueType> *pBase;
     CDBAccess *pDbAccess;
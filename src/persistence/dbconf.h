@@ -18,6 +18,7 @@ typedef leveldb::Slice Slice;
 #define DEF_DB_NAME_ARRAY(enumType, enumName, cacheSize) enumName,
 #define DEF_CACHE_SIZE_ARRAY(enumType, enumName, cacheSize) cacheSize,
 
+// DBCacheSize is the share of -dbcache given to each db, relative to the others
 //         DBNameType            DBName             DBCacheSize           description
 //         ----------           --------------    --------------     ----------------------------
 #define DB_NAME_LIST(DEFINE) \
@@ -53,6 +54,9 @@ static const std::string kDbNames[DBNameType::DB_NAME_COUNT + 1] {
     DB_NAME_LIST(DEF_DB_NAME_ARRAY)
 };
 
+// name of the single LevelDB holding every prefix when -unifieddb is set
+static const std::string UNIFIED_DB_NAME = "chainstate";
+
 inline const std::string& GetDbName(DBNameType dbNameType) {
     assert(dbNameType >= 0 && dbNameType < DBNameType::DB_NAME_COUNT);
     return kDbNames[dbNameType];
@@ -73,6 +77,8 @@ namespace dbk {
         DEFINE( CDP_INTEREST_PARAMS,  "cips",   SYSPARAM )       /* [prefix]*/  \
         DEFINE( BP_COUNT,             "bpct",   SYSPARAM )           \
         DEFINE( NEW_BP_COUNT,         "nbpc",   SYSPARAM )           \
+        DEFINE( FLUSH_EPOCH,          "fepo",   SYSPARAM )       /* [prefix] --> $LastCommittedFlushEpoch */ \
+        DEFINE( FLUSH_JOURNAL,        "fjnl",   SYSPARAM )       /* [prefix] --> $FlushJournal of an in-flight flush */ \
         DEFINE( SYS_GOVERN,           "govn",   SYSGOVERN )       /* govn --> $list of governers */ \
         DEFINE( GOVN_PROP,            "pgvn",   SYSGOVERN )       /* pgvn{txid} --> proposal */ \
         DEFINE( GOVN_SECOND,          "sgvn",   SYSGOVERN )       /* sgvn{txid}{regid} --> 1 */ \
@@ -114,19 +114,21 @@ public:
     typedef typename CacheType::KeyType KeyType;
     typedef typename CacheType::ValueType ValueType;
 private:
-    typename CacheType::Iterator map_it;
+    const typename CacheType::Map &data_map;
+    typename CacheType::ConstIterator map_it;
 public:
-    CCacheMapIterator(CacheType &dbCache) : Base(dbCache), map_it(dbCache.GetMapData().end()) {}
+    CCacheMapIterator(CacheType &dbCache, const typename CacheType::Map &dataMap)
+        : Base(dbCache), data_map(dataMap), map_it(dataMap.end()) {}
 
     virtual bool First() {
-        map_it = this->db_cache.GetMapData().begin();
+        map_it = data_map.begin();
         return ProcessData();
     }
 
     bool SeekUpper(const KeyType *pKey) {
         if (pKey == nullptr || db_util::IsEmpty(*pKey))
             return First();
-        map_it = this->db_cache.GetMapData().upper_bound(*pKey);
+        map_it = data_map.upper_bound(*pKey);
         return ProcessData();
     }
 
@@ -139,7 +141,7 @@ public:
 private:
     inline bool ProcessData() {
         this->is_valid = false;
-        if (map_it == this->db_cache.GetMapData().end())  return false;
+        if (map_it == data_map.end())  return false;
         *this->sp_key = map_it->first;
         *this->sp_value = map_it->second;
         this->is_valid = true;
@@ -159,17 +161,22 @@ public:
 public:
     static shared_ptr<CDBCacheIteratorImpl> Create(CacheType &cache) {
         assert(cache.GetBasePtr() != nullptr || cache.GetDbAccessPtr() != nullptr);
-        shared_ptr<CDBCacheIteratorImpl> spIt;
+        shared_ptr<Base> spBaseIt;
         if (cache.GetBasePtr() != nullptr) {
-            spIt = make_shared<CDBCacheIteratorImpl>(cache, Create(*cache.GetBasePtr()));
+            spBaseIt = Create(*cache.GetBasePtr());
         } else {
-            spIt = make_shared<CDBCacheIteratorImpl>(cache, make_shared<DbAccessIt>(cache));
+            spBaseIt = make_shared<DbAccessIt>(cache);
         }
-        return spIt;
+        // the frozen maps shared with copies of the cache lie between its own data and its base
+        for (const auto &pFrozenMap : cache.GetFrozenMaps()) {
+            spBaseIt = make_shared<CDBCacheIteratorImpl>(cache, *pFrozenMap, spBaseIt);
+        }
+        return make_shared<CDBCacheIteratorImpl>(cache, cache.GetOwnMapData(), spBaseIt);
     }
 public:
-    CDBCacheIteratorImpl(CacheType &dbCacheIn, shared_ptr<Base> spBaseItIn)
-        : Base(dbCacheIn), sp_map_it(make_shared<CacheMapIt>(dbCacheIn)), sp_base_it(spBaseItIn) {}
+    CDBCacheIteratorImpl(CacheType &dbCacheIn, const typename CacheType::Map &dataMap,
+                         shared_ptr<Base> spBaseItIn)
+        : Base(dbCacheIn), sp_map_it(make_shared<CacheMapIt>(dbCacheIn, dataMap)), sp_base_it(spBaseItIn) {}
 
     bool First() {
         sp_map_it->First();
@@ -274,9 +281,8 @@ public:
     typedef typename CacheType::KeyType KeyType;
     typedef typename CacheType::ValueType ValueType;
 
-    CDBIterator(CacheType &dbCacheIn): sp_it_Impl(IteratorImpl::Create(dbCacheIn)){
-
-    }
+    // the range read is logged, or refused, before the iterator reaches the data of the caches
+    CDBIterator(CacheType &dbCacheIn): sp_it_Impl((dbCacheIn.AddRangeReadLog(), IteratorImpl::Create(dbCacheIn))) {}
     virtual bool First() {
         return sp_it_Impl->First();
     }
@@ -86,6 +86,14 @@ public:
         pending_delegates_cache.RegisterUndoFunc(undoDataFuncMap);
         active_delegates_cache.RegisterUndoFunc(undoDataFuncMap);
     }
+
+    void RegisterDiscardFunc(DiscardDataFuncMap &discardDataFuncMap) {
+        voteRegIdCache.RegisterDiscardFunc(discardDataFuncMap);
+        regId2VoteCache.RegisterDiscardFunc(discardDataFuncMap);
+        last_vote_height_cache.RegisterDiscardFunc(discardDataFuncMap);
+        pending_delegates_cache.RegisterDiscardFunc(discardDataFuncMap);
+        active_delegates_cache.RegisterDiscardFunc(discardDataFuncMap);
+    }
 public:
 /*  CCompositeKVCache  prefixType     key                              value                   variable       */
 /*  -------------------- -------------- --------------------------  ----------------------- -------------- */
@@ -161,6 +161,15 @@ public:
         operator_trade_pair_cache.RegisterUndoFunc(undoDataFuncMap);
     }
 
+    void RegisterDiscardFunc(DiscardDataFuncMap &discardDataFuncMap) {
+        activeOrderCache.RegisterDiscardFunc(discardDataFuncMap);
+        blockOrdersCache.RegisterDiscardFunc(discardDataFuncMap);
+        operator_detail_cache.RegisterDiscardFunc(discardDataFuncMap);
+        operator_owner_map_cache.RegisterDiscardFunc(discardDataFuncMap);
+        operator_last_id_cache.RegisterDiscardFunc(discardDataFuncMap);
+        operator_trade_pair_cache.RegisterDiscardFunc(discardDataFuncMap);
+    }
+
     shared_ptr<CDEXOrdersGetter> CreateOrdersGetter() {
         assert(blockOrdersCache.GetBasePtr() == nullptr && "only support top level cache");
         return make_shared<CDEXOrdersGetter>(blockOrdersCache);
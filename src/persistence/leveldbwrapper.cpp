@@ -4,6 +4,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "leveldbwrapper.h"
+#include "commons/memusage.h"
 
 #include "commons/util/util.h"
 
@@ -40,23 +41,113 @@ std::string CDBOpLogMap::ToString() const {
     return str;
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize) {
+void CDbKeySet::Add(const CDbKeySet &other) {
+    for (const auto &item : other.mapKeys)
+        mapKeys[item.first].insert(item.second.begin(), item.second.end());
+}
+
+void CDbKeySet::AddWrites(const CDBOpLogMap &dbOpLogMap) {
+    for (const auto &item : dbOpLogMap.GetMap()) {
+        auto &keys = mapKeys[item.first];
+        for (const auto &dbOpLog : item.second)
+            keys.insert(dbOpLog.GetKey());
+    }
+}
+
+size_t CDbKeySet::DynamicMemoryUsage() const {
+    size_t usage = memusage::DynamicUsage(mapKeys);
+    for (const auto &item : mapKeys) {
+        usage += memusage::DynamicUsage(item.first) + memusage::DynamicUsage(item.second);
+        for (const auto &key : item.second)
+            usage += memusage::DynamicUsage(key);
+    }
+    return usage;
+}
+
+bool CDbKeySet::Intersects(const CDbKeySet &other) const {
+    const CDbKeySet &smaller = mapKeys.size() <= other.mapKeys.size() ? *this : other;
+    const CDbKeySet &larger  = &smaller == this ? other : *this;
+    for (const auto &item : smaller.mapKeys) {
+        auto it = larger.mapKeys.find(item.first);
+        if (it == larger.mapKeys.end())
+            continue;
+
+        // the whole prefix
+        if (item.second.count("") || it->second.count(""))
+            return true;
+
+        const auto &fewer = item.second.size() <= it->second.size() ? item.second : it->second;
+        const auto &more  = &fewer == &item.second ? it->second : item.second;
+        for (const auto &key : fewer) {
+            if (more.count(key))
+                return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+class CLevelDBOpCollector : public leveldb::WriteBatch::Handler {
+public:
+    vector<CLevelDBOp> &ops;
+
+    CLevelDBOpCollector(vector<CLevelDBOp> &opsIn) : ops(opsIn) {}
+
+    virtual void Put(const leveldb::Slice &key, const leveldb::Slice &value) {
+        ops.emplace_back(false, key.ToString(), value.ToString());
+    }
+
+    virtual void Delete(const leveldb::Slice &key) {
+        ops.emplace_back(true, key.ToString(), string());
+    }
+};
+
+}  // namespace
+
+void CLevelDBBatch::GetOps(vector<CLevelDBOp> &ops) const {
+    ops.reserve(ops.size() + nOps);
+    CLevelDBOpCollector collector(ops);
+    ThrowError(batch.Iterate(&collector));
+}
+
+void CLevelDBBatch::AddOps(const vector<CLevelDBOp> &ops) {
+    for (const auto &op : ops) {
+        if (op.fErase)
+            batch.Delete(op.key);
+        else
+            batch.Put(op.key, op.value);
+        ++nOps;
+    }
+}
+
+string CLevelDBOptions::ToString() const {
+    return strprintf("block_cache=%.1fMiB write_buffer=%.1fMiB bloom_bits=%d compression=%s max_open_files=%d",
+                     nBlockCacheSize / 1048576.0, nWriteBufferSize / 1048576.0, nBloomBits,
+                     fCompression ? "snappy" : "none", nMaxOpenFiles);
+}
+
+static leveldb::Options GetOptions(const CLevelDBOptions &dbOptions) {
     leveldb::Options options;
-    options.block_cache       = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4;  // up to two write buffers may be held in memory simultaneously
-    options.filter_policy     = leveldb::NewBloomFilterPolicy(10);
-    options.compression       = leveldb::kNoCompression;
-    options.max_open_files    = 64;
+    options.block_cache       = leveldb::NewLRUCache(dbOptions.nBlockCacheSize);
+    options.write_buffer_size = dbOptions.nWriteBufferSize;
+    options.filter_policy     = dbOptions.nBloomBits > 0 ? leveldb::NewBloomFilterPolicy(dbOptions.nBloomBits) : nullptr;
+    options.compression       = dbOptions.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+    options.max_open_files    = dbOptions.nMaxOpenFiles;
     return options;
 }
 
-CLevelDBWrapper::CLevelDBWrapper(const boost::filesystem::path &path, size_t nCacheSize, bool fMemory, bool fWipe) {
+CLevelDBWrapper::CLevelDBWrapper(const boost::filesystem::path &path, size_t nCacheSize, bool fMemory, bool fWipe) :
+    CLevelDBWrapper(path, CLevelDBOptions(nCacheSize), fMemory, fWipe) {}
+
+CLevelDBWrapper::CLevelDBWrapper(const boost::filesystem::path &path, const CLevelDBOptions &dbOptions, bool fMemory,
+                                 bool fWipe) {
     penv                         = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache       = false;
     syncoptions.sync             = true;
-    options                      = GetOptions(nCacheSize);
+    options                      = GetOptions(dbOptions);
     options.create_if_missing    = true;
     if (fMemory) {
         penv        = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -67,7 +158,7 @@ CLevelDBWrapper::CLevelDBWrapper(const boost::filesystem::path &path, size_t nCa
             leveldb::DestroyDB(path.string(), options);
         }
         TryCreateDirectory(path);
-        LogPrint(BCLog::INFO, "Opening LevelDB in %s\n", path.string());
+        LogPrint(BCLog::INFO, "Opening LevelDB in %s (%s)\n", path.string(), dbOptions.ToString());
     }
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
     ThrowError(status);
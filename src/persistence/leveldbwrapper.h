@@ -84,9 +84,32 @@ public:
 
 typedef vector<CDbOpLog> CDbOpLogs;
 
+class CDBOpLogMap;
+
+// Serialized db keys by db prefix, an empty key stands for all the keys of the prefix
+class CDbKeySet {
+public:
+    void Add(const string &prefix, const string &key) { mapKeys[prefix].insert(key); }
+    void Add(const CDbKeySet &other);
+    // the keys written by the op logs
+    void AddWrites(const CDBOpLogMap &dbOpLogMap);
+
+    bool Intersects(const CDbKeySet &other) const;
+    bool IsEmpty() const { return mapKeys.empty(); }
+    void Clear() { mapKeys.clear(); }
+
+    const map<string, set<string>>& GetMap() const { return mapKeys; }
+
+    size_t DynamicMemoryUsage() const;
+
+private:
+    map<string, set<string>> mapKeys;
+};
+
 class CDBOpLogMap {
 public:
     map<string, CDbOpLogs>& GetMap() { return mapDbOpLogs; }
+    const map<string, CDbOpLogs>& GetMap() const { return mapDbOpLogs; }
 
     const CDbOpLogs* GetDbOpLogsPtr(dbk::PrefixType prefixType) const {
         assert(prefixType != dbk::EMPTY);
@@ -106,6 +129,17 @@ public:
 
     void Clear() { mapDbOpLogs.clear(); }
 
+    // the caches logging to this map also record the keys they are read at into pReadKeys,
+    // nullptr to stop it
+    void SetReadKeys(CDbKeySet *pReadKeysIn) { pReadKeys = pReadKeysIn; }
+    bool IsReadLogged() const { return pReadKeys != nullptr; }
+
+    void AddReadLog(dbk::PrefixType prefixType, const string &key) {
+        assert(prefixType != dbk::EMPTY);
+        if (pReadKeys != nullptr)
+            pReadKeys->Add(dbk::GetKeyPrefix(prefixType), key);
+    }
+
     std::string ToString() const;
 public:
     IMPLEMENT_SERIALIZE(
@@ -113,6 +147,7 @@ public:
 	)
 private:
     mutable map<string, CDbOpLogs> mapDbOpLogs; // dbName -> dbOpLogs
+    CDbKeySet *pReadKeys = nullptr;              // not serialized
 };
 
 class leveldb_error : public runtime_error
@@ -123,12 +158,31 @@ public:
 
 void ThrowError(const leveldb::Status &status);
 
+// Single put or erase of a CLevelDBBatch, key and value already serialized
+class CLevelDBOp {
+public:
+    bool fErase = false;
+    string key;
+    string value;
+
+    CLevelDBOp() {}
+    CLevelDBOp(bool fEraseIn, const string &keyIn, const string &valueIn) :
+        fErase(fEraseIn), key(keyIn), value(valueIn) {}
+
+    IMPLEMENT_SERIALIZE(
+        READWRITE(fErase);
+        READWRITE(key);
+        READWRITE(value);
+    )
+};
+
 // Batch of changes queued to be written to a CLevelDBWrapper
 class CLevelDBBatch {
     friend class CLevelDBWrapper;
 
 private:
     leveldb::WriteBatch batch;
+    uint32_t nOps = 0;
 
 public:
     template<typename V>
@@ -139,14 +193,56 @@ public:
         ssValue << value;
         leveldb::Slice slValue(&ssValue[0], ssValue.size());
         batch.Put(slKey, slValue);
+        ++nOps;
     }
 
     void Erase(const std::string &key) {
         batch.Delete(key);
+        ++nOps;
     }
 
+    bool IsEmpty() const { return nOps == 0; }
+    uint32_t GetOpCount() const { return nOps; }
+
+    // raw form of the batch, used to journal a coordinated flush
+    void GetOps(vector<CLevelDBOp> &ops) const;
+    void AddOps(const vector<CLevelDBOp> &ops);
  };
 
+/**
+ * Write-ahead record of a coordinated flush across several databases. It is synced before any of
+ * the database batches is applied and erased together with the last one, so a journal found at
+ * startup means the flush of that epoch was interrupted and must be replayed.
+ */
+class CDBFlushJournal {
+public:
+    uint64_t epoch = 0;
+    map<uint8_t, vector<CLevelDBOp>> batches;  // DBNameType -> batch ops
+
+    IMPLEMENT_SERIALIZE(
+        READWRITE(VARINT(epoch));
+        READWRITE(batches);
+    )
+};
+
+// Tuning of one LevelDB instance
+class CLevelDBOptions {
+public:
+    size_t nBlockCacheSize  = 0;
+    size_t nWriteBufferSize = 0;
+    int32_t nBloomBits      = 10;  // bits per key of the bloom filter, 0 disables it
+    bool fCompression       = false;
+    int32_t nMaxOpenFiles   = 64;
+
+    CLevelDBOptions() {}
+
+    // half of the budget for the block cache, a quarter per write buffer (up to two are held in memory)
+    explicit CLevelDBOptions(size_t nCacheSize) :
+        nBlockCacheSize(nCacheSize / 2), nWriteBufferSize(nCacheSize / 4) {}
+
+    string ToString() const;
+};
+
 class CLevelDBWrapper {
 private:
     // custom environment this database is using (may be NULL in case of default environment)
@@ -172,6 +268,8 @@ private:
 
 public:
     CLevelDBWrapper(const boost::filesystem::path &path, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CLevelDBWrapper(const boost::filesystem::path &path, const CLevelDBOptions &dbOptions, bool fMemory = false,
+                    bool fWipe = false);
     ~CLevelDBWrapper();
 
     template<typename V>
@@ -48,6 +48,7 @@ public:
     bool AddPriceByBlock(const CBlock &block);
     // delete block price point by specific block height.
     bool DeleteBlockFromCache(const CBlock &block);
+    bool DeleteBlockFromCache(const int32_t blockHeight) { return DeleteBlockPricePoint(blockHeight); }
 
     bool CalcBlockMedianPrices(CCacheWrapper &cw, const int32_t blockHeight, PriceMap &medianPrices);
 
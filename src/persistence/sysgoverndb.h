@@ -125,6 +125,12 @@ public:
         proposalsCache.RegisterUndoFunc(undoDataFuncMap);
         secondsCache.RegisterUndoFunc(undoDataFuncMap);
     }
+
+    void RegisterDiscardFunc(DiscardDataFuncMap &discardDataFuncMap) {
+        governersCache.RegisterDiscardFunc(discardDataFuncMap);
+        proposalsCache.RegisterDiscardFunc(discardDataFuncMap);
+        secondsCache.RegisterDiscardFunc(discardDataFuncMap);
+    }
 private:
 /*  CSimpleKVCache          prefixType             value           variable           */
 /*  -------------------- --------------------   -------------   --------------------- */
@@ -124,6 +124,15 @@ public:
         currentBpCountCache.RegisterUndoFunc(undoDataFuncMap);
         newBpCountCache.RegisterUndoFunc(undoDataFuncMap);
     }
+
+    void RegisterDiscardFunc(DiscardDataFuncMap &discardDataFuncMap) {
+        sysParamCache.RegisterDiscardFunc(discardDataFuncMap);
+        minerFeeCache.RegisterDiscardFunc(discardDataFuncMap);
+        cdpParamCache.RegisterDiscardFunc(discardDataFuncMap);
+        cdpInterestParamChangesCache.RegisterDiscardFunc(discardDataFuncMap);
+        currentBpCountCache.RegisterDiscardFunc(discardDataFuncMap);
+        newBpCountCache.RegisterDiscardFunc(discardDataFuncMap);
+    }
     bool SetParam(const SysParamType& key, const uint64_t& value){
         return sysParamCache.SetData(key, CVarIntValue(value)) ;
     }
@@ -21,6 +21,11 @@ bool CTxMemCache::AddBlockTx(const CBlock &block) {
     return true;
 }
 
+bool CTxMemCache::AddBlockTx(const vector<uint256> &blockTxids) {
+    txids.insert(blockTxids.begin(), blockTxids.end());
+    return true;
+}
+
 bool CTxMemCache::RemoveBlockTx(const CBlock &block) {
     for (auto &ptx : block.vptx) {
         txids.erase(ptx->GetHash());
@@ -28,6 +33,13 @@ bool CTxMemCache::RemoveBlockTx(const CBlock &block) {
     return true;
 }
 
+bool CTxMemCache::RemoveBlockTx(const vector<uint256> &blockTxids) {
+    for (const auto &txid : blockTxids) {
+        txids.erase(txid);
+    }
+    return true;
+}
+
 bool CTxMemCache::HaveTx(const uint256 &txid) {
     bool found = txids.count(txid) > 0;
     if (found)
@@ -29,7 +29,9 @@ public:
     bool HaveTx(const uint256 &txid);
 
     bool AddBlockTx(const CBlock &block);
+    bool AddBlockTx(const vector<uint256> &blockTxids);
     bool RemoveBlockTx(const CBlock &block);
+    bool RemoveBlockTx(const vector<uint256> &blockTxids);
 
     void Clear();
     void SetBaseViewPtr(CTxMemCache *pBaseIn) { pBase = pBaseIn; }
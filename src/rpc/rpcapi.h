@@ -155,6 +155,7 @@ extern Value walletpassphrasechange(const json_spirit::Array& params, bool fHelp
 extern Value walletlock(const json_spirit::Array& params, bool fHelp);
 extern Value encryptwallet(const json_spirit::Array& params, bool fHelp);
 extern Value getinfo(const json_spirit::Array& params, bool fHelp);
+extern Value getsigcacheinfo(const json_spirit::Array& params, bool fHelp);
 extern Value getwalletinfo(const json_spirit::Array& params, bool fHelp);
 extern Value getnetworkinfo(const json_spirit::Array& params, bool fHelp);
 
@@ -175,6 +176,7 @@ extern Value getfcoingenesistxinfo(const json_spirit::Array& params, bool fHelp)
 extern Value getblockcount(const json_spirit::Array& params, bool fHelp);
 extern Value getdifficulty(const json_spirit::Array& params, bool fHelp);
 extern Value getrawmempool(const json_spirit::Array& params, bool fHelp);
+extern Value getmempoolinfo(const json_spirit::Array& params, bool fHelp);
 extern Value getblock(const json_spirit::Array& params, bool fHelp);
 extern Value verifychain(const json_spirit::Array& params, bool fHelp);
 extern Value getcontractregid(const json_spirit::Array& params, bool fHelp);
@@ -18,6 +18,7 @@ static const CRPCCommand vRPCCommands[] =
     /* Overall control/query calls */
     { "help",                           &help,                              true,      true,        false   },
     { "getinfo",                        &getinfo,                           true,      false,       false   }, /* uses wallet if enabled */
+    { "getsigcacheinfo",                &getsigcacheinfo,                   true,      true,        false   },
     { "stop",                           &stop,                              true,      true,        false   },
     { "validateaddr",                   &validateaddr,                      true,      true,        false   },
     { "createmulsig",                   &createmulsig,                      true,      true ,       false   },
@@ -37,6 +38,7 @@ static const CRPCCommand vRPCCommands[] =
     { "getblockcount",                  &getblockcount,                     true,      true,        false   },
     { "getblock",                       &getblock,                          true,      false,       false   },
     { "getrawmempool",                  &getrawmempool,                     true,      false,       false   },
+    { "getmempoolinfo",                 &getmempoolinfo,                    true,      false,       false   },
     { "verifychain",                    &verifychain,                       true,      false,       false   },
     { "getblockundo",                   &getblockundo,                      true,      false,       false   },
 
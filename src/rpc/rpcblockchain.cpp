@@ -131,6 +131,10 @@ Value getrawmempool(const Array& params, bool fHelp)
             "    \"time\" : n,             (numeric) local time transaction entered pool in seconds since 1 Jan 1970 "
             "GMT\n"
             "    \"height\" : n,           (numeric) block height when transaction entered pool\n"
+            "    \"ancestorcount\" : n,    (numeric) number of pool transactions of the same sender up to this one\n"
+            "    \"ancestorsize\" : n,     (numeric) size of them\n"
+            "    \"descendantcount\" : n,  (numeric) number of pool transactions of the same sender from this one on\n"
+            "    \"descendantsize\" : n,   (numeric) size of them\n"
             "  }, ...\n"
             "]\n"
             "\nExamples\n" +
@@ -153,6 +157,10 @@ Value getrawmempool(const Array& params, bool fHelp)
             info.push_back(Pair("time",         e.GetTime()));
             info.push_back(Pair("height",       (int)e.GetHeight()));
             info.push_back(Pair("priority",     e.GetPriority()));
+            info.push_back(Pair("ancestorcount",    (int64_t)e.GetCountWithAncestors()));
+            info.push_back(Pair("ancestorsize",     (int64_t)e.GetSizeWithAncestors()));
+            info.push_back(Pair("descendantcount",  (int64_t)e.GetCountWithDescendants()));
+            info.push_back(Pair("descendantsize",   (int64_t)e.GetSizeWithDescendants()));
 
             obj.push_back(Pair(hash.ToString(), info));
         }
@@ -170,6 +178,34 @@ Value getrawmempool(const Array& params, bool fHelp)
     }
 }
 
+Value getmempoolinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getmempoolinfo\n"
+            "\nReturns details on the state of the memory pool.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"size\" : n,             (numeric) number of transactions in the pool\n"
+            "  \"bytes\" : n,            (numeric) sum of the transaction sizes\n"
+            "  \"usage\" : n,            (numeric) memory used by the pool\n"
+            "  \"maxmempool\" : n,       (numeric) memory the pool is kept below\n"
+            "  \"mempoolminfee\" : n,    (numeric) minimum fee per KB in WICC coins for a transaction to be accepted\n"
+            "}\n"
+            "\nExamples\n" +
+            HelpExampleCli("getmempoolinfo", "") + "\nAs json rpc\n" + HelpExampleRpc("getmempoolinfo", ""));
+
+    size_t maxMempool = GetMaxMempoolSize();
+
+    Object obj;
+    obj.push_back(Pair("size",          (int64_t)mempool.Size()));
+    obj.push_back(Pair("bytes",         (int64_t)mempool.GetTotalTxSize()));
+    obj.push_back(Pair("usage",         (int64_t)mempool.DynamicMemoryUsage()));
+    obj.push_back(Pair("maxmempool",    (int64_t)maxMempool));
+    obj.push_back(Pair("mempoolminfee", ValueFromAmount((int64_t)mempool.GetMinFeePerKb(maxMempool))));
+    return obj;
+}
+
 Value getblock(const Array& params, bool fHelp) {
     if (fHelp || params.size() < 1 || params.size() > 2) {
         throw runtime_error(
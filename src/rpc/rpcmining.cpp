@@ -196,6 +196,23 @@ Value getminedblocks(const Array& params, bool fHelp) {
             "    \"blocksize\": n          (numeric) block size (bytes)\n"
             "    \"hash\": xxx             (string) block hash\n"
             "    \"preblockhash\": xxx     (string) pre block hash\n"
+            "    \"pack_stats\": {         (object) how the transactions were packed\n"
+            "      \"pack_time_ms\": n     (numeric) time spent packing, over all the rounds\n"
+            "      \"pack_rounds\": n      (numeric) rounds packing the transactions arrived since, ahead of the slot included\n"
+            "      \"time_used_up\": b     (bool) whether packing stopped as the time ran out\n"
+            "      \"tx_types\": {         (object) the stats by transaction type\n"
+            "        \"type\": {\n"
+            "          \"considered\": n   (numeric) transactions handed out by the priority queue\n"
+            "          \"executed\": n     (numeric) transactions checked and executed\n"
+            "          \"rejected\": n     (numeric) transactions failed or over the block limits\n"
+            "          \"skipped\": n      (numeric) transactions not tried as the type takes longer than the time left\n"
+            "          \"packed\": n       (numeric) transactions packed\n"
+            "          \"check_tx_ms\": n  (numeric) time spent checking the transactions\n"
+            "          \"execute_tx_ms\": n (numeric) time spent executing the transactions\n"
+            "          \"flush_ms\": n     (numeric) time spent flushing the packed transactions\n"
+            "        }, ...\n"
+            "      }\n"
+            "    }\n"
             "  }\n"
             "]\n"
             "\nExamples:\n" +
@@ -221,6 +238,28 @@ Value getminedblocks(const Array& params, bool fHelp) {
         obj.push_back(Pair("block_size",    blockInfo.totalBlockSize));
         obj.push_back(Pair("txid",          blockInfo.hash.ToString()));
         obj.push_back(Pair("preblockhash",  blockInfo.hashPrevBlock.ToString()));
+
+        const BlockPackStats &packStats = blockInfo.packStats;
+        Object txTypesObj;
+        for (const auto &item : packStats.txTypeStats) {
+            const TxTypePackStats &typeStats = item.second;
+            Object typeObj;
+            typeObj.push_back(Pair("considered",    (int64_t)typeStats.considered));
+            typeObj.push_back(Pair("executed",      (int64_t)typeStats.executed));
+            typeObj.push_back(Pair("rejected",      (int64_t)typeStats.rejected));
+            typeObj.push_back(Pair("skipped",       (int64_t)typeStats.skipped));
+            typeObj.push_back(Pair("packed",        (int64_t)typeStats.packed));
+            typeObj.push_back(Pair("check_tx_ms",   typeStats.checkTxUs * 0.001));
+            typeObj.push_back(Pair("execute_tx_ms", typeStats.executeTxUs * 0.001));
+            typeObj.push_back(Pair("flush_ms",      typeStats.flushUs * 0.001));
+            txTypesObj.push_back(Pair(GetTxType(item.first), typeObj));
+        }
+        Object packStatsObj;
+        packStatsObj.push_back(Pair("pack_time_ms", packStats.packTimeUs * 0.001));
+        packStatsObj.push_back(Pair("pack_rounds",  (int64_t)packStats.packRounds));
+        packStatsObj.push_back(Pair("time_used_up", packStats.timeUsedUp));
+        packStatsObj.push_back(Pair("tx_types",     txTypesObj));
+        obj.push_back(Pair("pack_stats",    packStatsObj));
         ret.push_back(obj);
     }
 
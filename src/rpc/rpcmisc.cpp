@@ -147,6 +147,39 @@ Value getinfo(const Array& params, bool fHelp) {
     return obj;
 }
 
+Value getsigcacheinfo(const Array& params, bool fHelp) {
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getsigcacheinfo\n"
+            "\nget the statistics of the signature cache.\n"
+            "\nArguments:\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"hits\": xxxxx,                 (numeric) lookups answered by the cache\n"
+            "  \"misses\": xxxxx,               (numeric) lookups that required a full signature verification\n"
+            "  \"inserts\": xxxxx,              (numeric) verified signatures added to the cache\n"
+            "  \"evictions\": xxxxx,            (numeric) entries dropped to stay within the memory budget\n"
+            "  \"entries\": xxxxx,              (numeric) entries currently in the cache\n"
+            "  \"capacity\": xxxxx,             (numeric) maximum number of entries\n"
+            "  \"bytes\": xxxxx                 (numeric) memory used by the cache entries\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getsigcacheinfo", "") + "\nAs json rpc\n" + HelpExampleRpc("getsigcacheinfo", ""));
+
+    CSignatureCache::Stats stats = signatureCache.GetStats();
+
+    Object obj;
+    obj.push_back(Pair("hits",          stats.hits));
+    obj.push_back(Pair("misses",        stats.misses));
+    obj.push_back(Pair("inserts",       stats.inserts));
+    obj.push_back(Pair("evictions",     stats.evictions));
+    obj.push_back(Pair("entries",       stats.entries));
+    obj.push_back(Pair("capacity",      stats.capacity));
+    obj.push_back(Pair("bytes",         stats.bytes));
+
+    return obj;
+}
+
 Value verifymessage(const Array& params, bool fHelp) {
     if (fHelp || params.size() != 3)
         throw runtime_error(
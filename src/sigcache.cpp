@@ -6,45 +6,131 @@
 
 #include "sigcache.h"
 
-void CSignatureCache::ComputeEntry(uint256& entry, const uint256& sigHash,
+#include "crypto/siphash.h"
+#include "commons/random.h"
+
+#include <algorithm>
+
+void CSignatureCache::Setup(size_t nMaxBytes) {
+    uint256 salt1 = GetRandHash();
+    uint256 salt2 = GetRandHash();
+    size_t nSlots = nMaxBytes / sizeof(Entry) / SHARD_COUNT;
+
+    // entries computed with the old salt would never be hit again, so hold every shard while
+    // the keys change and start over empty
+    for (auto &shard : shards)
+        shard.mtx.lock();
+
+    k0 = salt1.GetUint64(0);
+    k1 = salt1.GetUint64(1);
+    k2 = salt2.GetUint64(0);
+    k3 = salt2.GetUint64(1);
+    for (auto &shard : shards) {
+        shard.slots.assign(nSlots, Entry());
+        shard.nEntries = 0;
+    }
+
+    for (auto &shard : shards)
+        shard.mtx.unlock();
+}
+
+void CSignatureCache::ComputeEntry(Entry& entry, const uint256& sigHash,
                                    const std::vector<unsigned char>& vchSig,
-                                   const CPubKey& pubKey) {
-    CSHA256()
-        .Write(sigHash.begin(), 32)
-        .Write(&pubKey[0], pubKey.size())
-        .Write(&vchSig[0], vchSig.size())
-        .Finalize(entry.begin());
+                                   const CPubKey& pubKey) const {
+    entry.a = CSipHasher(k0, k1)
+                  .Write(sigHash.begin(), 32)
+                  .Write(pubKey.begin(), pubKey.size())
+                  .Write(vchSig.data(), vchSig.size())
+                  .Finalize();
+    entry.b = CSipHasher(k2, k3)
+                  .Write(sigHash.begin(), 32)
+                  .Write(pubKey.begin(), pubKey.size())
+                  .Write(vchSig.data(), vchSig.size())
+                  .Finalize();
+    // the all-zero entry marks an empty slot
+    if (entry.IsNull())
+        entry.b = 1;
 }
 
 bool CSignatureCache::Get(const uint256& sigHash, const std::vector<unsigned char>& vchSig,
                           const CPubKey& pubKey) {
-    uint256 entry;
+    Entry entry;
     ComputeEntry(entry, sigHash, vchSig, pubKey);
-    std::unique_lock<std::mutex> lock(mtx);
-    return setValid.count(entry);
+
+    Shard &shard = GetShard(entry);
+    bool found   = false;
+    {
+        std::unique_lock<std::mutex> lock(shard.mtx);
+        size_t nSlots = shard.slots.size();
+        if (nSlots > 0) {
+            found = shard.slots[(entry.a / SHARD_COUNT) % nSlots] == entry ||
+                    shard.slots[entry.b % nSlots] == entry;
+        }
+    }
+
+    if (found)
+        ++nHits;
+    else
+        ++nMisses;
+
+    return found;
 }
 
 void CSignatureCache::Set(const uint256& sigHash, const std::vector<unsigned char>& vchSig,
                           const CPubKey& pubKey) {
-    static int64_t nMaxCacheSize = SysCfg().GetArg("-maxsigcachesize", 50000);
-    if (nMaxCacheSize <= 0) return;
-
-    uint256 entry;
+    Entry entry;
     ComputeEntry(entry, sigHash, vchSig, pubKey);
 
-    std::unique_lock<std::mutex> lock(mtx);
-
-    while (static_cast<int64_t>(setValid.size()) > nMaxCacheSize) {
-        // Evict a random entry. Random because that helps
-        // foil would-be DoS attackers who might try to pre-generate
-        // and re-use a set of valid signatures just-slightly-greater
-        // than our cache size.
-        UnorderedHashSet::size_type s       = GetRand(setValid.bucket_count());
-        UnorderedHashSet::local_iterator it = setValid.begin(s);
-        if (it != setValid.end(s)) {
-            setValid.erase(*it);
+    Shard &shard = GetShard(entry);
+    std::unique_lock<std::mutex> lock(shard.mtx);
+
+    size_t nSlots = shard.slots.size();
+    if (nSlots == 0)
+        return;
+
+    size_t pos1 = (entry.a / SHARD_COUNT) % nSlots;
+    size_t pos2 = entry.b % nSlots;
+    if (shard.slots[pos1] == entry || shard.slots[pos2] == entry)
+        return;
+
+    ++nInserts;
+    if (shard.slots[pos1].IsNull() || shard.slots[pos2].IsNull()) {
+        shard.slots[shard.slots[pos1].IsNull() ? pos1 : pos2] = entry;
+        ++shard.nEntries;
+        return;
+    }
+
+    // Both slots are taken: displace residents towards their alternate slot. The starting slot
+    // depends on the salted digest, so peers can't steer which entries get pushed out.
+    size_t pos = (entry.b & 1) ? pos1 : pos2;
+    for (uint32_t i = 0; i < MAX_KICKS; i++) {
+        std::swap(entry, shard.slots[pos]);
+        size_t alt1 = (entry.a / SHARD_COUNT) % nSlots;
+        size_t alt2 = entry.b % nSlots;
+        pos         = (pos == alt1) ? alt2 : alt1;
+        if (shard.slots[pos].IsNull()) {
+            shard.slots[pos] = entry;
+            ++shard.nEntries;
+            return;
         }
     }
 
-    setValid.insert(entry);
+    // the entry displaced last is dropped
+    ++nEvictions;
+}
+
+CSignatureCache::Stats CSignatureCache::GetStats() {
+    Stats stats;
+    stats.hits      = nHits;
+    stats.misses    = nMisses;
+    stats.inserts   = nInserts;
+    stats.evictions = nEvictions;
+    for (auto &shard : shards) {
+        std::unique_lock<std::mutex> lock(shard.mtx);
+        stats.entries += shard.nEntries;
+        stats.capacity += shard.slots.size();
+    }
+    stats.bytes = stats.capacity * sizeof(Entry);
+
+    return stats;
 }
@@ -7,38 +7,83 @@
 #ifndef COIN_SIGCACHE_H
 #define COIN_SIGCACHE_H
 
+#include <atomic>
 #include <mutex>
 #include <vector>
 
-#include "config/chainparams.h"
-#include "crypto/sha256.h"
 #include "entities/key.h"
-#include "commons/random.h"
 #include "commons/uint256.h"
-#include "commons/util/util.h"
 
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
  * twice for every transaction (once when accepted into memory pool, and
  * again when accepted into the block chain)
+ *
+ * Entries are 128-bit salted SipHash digests of (signature hash || public key || signature),
+ * stored in a fixed number of independently locked shards so that concurrent validation
+ * threads rarely contend. Each shard is a two-choice cuckoo table whose size is derived from
+ * the configured memory budget, so the cache never grows beyond it: when both candidate slots
+ * of a new entry are taken, a few resident entries are relocated to their alternate slot and,
+ * failing that, the last displaced one is evicted.
  */
 class CSignatureCache {
+public:
+    struct Stats {
+        uint64_t hits      = 0;
+        uint64_t misses    = 0;
+        uint64_t inserts   = 0;
+        uint64_t evictions = 0;
+        uint64_t entries   = 0;
+        uint64_t capacity  = 0;
+        uint64_t bytes     = 0;
+    };
+
 private:
-    //! Entries are SHA256(signature hash || public key || signature):
-    UnorderedHashSet setValid;
-    std::mutex mtx;
+    struct Entry {
+        uint64_t a = 0;
+        uint64_t b = 0;
+
+        bool IsNull() const { return a == 0 && b == 0; }
+        bool operator==(const Entry &other) const { return a == other.a && b == other.b; }
+    };
+
+    struct Shard {
+        std::mutex mtx;
+        std::vector<Entry> slots;
+        uint64_t nEntries = 0;
+    };
+
+    static const uint32_t SHARD_COUNT = 64;
+    //! Number of cuckoo relocations tried before an entry is evicted
+    static const uint32_t MAX_KICKS   = 8;
+
+    Shard shards[SHARD_COUNT];
+    //! SipHash keys, picked at random in Setup() so entries can't be pre-computed by a peer
+    uint64_t k0 = 0, k1 = 0, k2 = 0, k3 = 0;
+
+    std::atomic<uint64_t> nHits{0};
+    std::atomic<uint64_t> nMisses{0};
+    std::atomic<uint64_t> nInserts{0};
+    std::atomic<uint64_t> nEvictions{0};
 
 public:
     CSignatureCache() {}
     ~CSignatureCache() {}
+
+    /** Size the cache to at most nMaxBytes of entries and pick a fresh salt; drops all entries. */
+    void Setup(size_t nMaxBytes);
+
     bool Get(const uint256& sigHash, const std::vector<unsigned char>& vchSig,
              const CPubKey& pubKey);
     void Set(const uint256& sigHash, const std::vector<unsigned char>& vchSig,
              const CPubKey& pubKey);
 
+    Stats GetStats();
+
 private:
-    void ComputeEntry(uint256& entry, const uint256& sigHash,
-                      const std::vector<unsigned char>& vchSig, const CPubKey& pubKey);
+    void ComputeEntry(Entry& entry, const uint256& sigHash,
+                      const std::vector<unsigned char>& vchSig, const CPubKey& pubKey) const;
+    Shard& GetShard(const Entry& entry) { return shards[entry.a % SHARD_COUNT]; }
 };
 
-#endif  // COIN_SIGCACHE_H
\ No newline at end of file
+#endif  // COIN_SIGCACHE_H
@@ -0,0 +1,94 @@
+// Copyright (c) 2017-2019 The WaykiChain Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "p2p/blockencodings.h"
+#include "tx/accountregtx.h"
+#include "tx/blockrewardtx.h"
+#include "tx/txmempool.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+static CBlock BuildBlock(vector<std::shared_ptr<CBaseTx>> &vptxUser) {
+    CBlock block;
+    block.SetHeight(10);
+    block.SetTime(1570000000);
+    block.vptx.push_back(std::make_shared<CBlockRewardTx>(UnsignedCharArray(), 0, 10));
+    for (int32_t i = 1; i <= 3; i++) {
+        auto pTx = std::make_shared<CAccountRegisterTx>(CUserID(CRegID(i, 1)), CUserID(), 10000, 10);
+        vptxUser.push_back(pTx);
+        block.vptx.push_back(pTx);
+    }
+    block.SetMerkleRootHash(block.BuildMerkleTree());
+
+    return block;
+}
+
+BOOST_AUTO_TEST_SUITE(blockencodings_tests)
+
+BOOST_AUTO_TEST_CASE(short_txid)
+{
+    CShortTxId shortTxId(0x123456789abcdef0ULL);
+    BOOST_CHECK_EQUAL(shortTxId.Get(), 0x56789abcdef0ULL);
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << shortTxId;
+    BOOST_CHECK_EQUAL(ss.size(), 6U);
+
+    CShortTxId shortTxId2;
+    ss >> shortTxId2;
+    BOOST_CHECK_EQUAL(shortTxId2.Get(), shortTxId.Get());
+}
+
+BOOST_AUTO_TEST_CASE(rebuild_from_mempool)
+{
+    vector<std::shared_ptr<CBaseTx>> vptxUser;
+    CBlock block = BuildBlock(vptxUser);
+
+    CBlockHeaderAndShortTxIDs cmpctBlock(block);
+    BOOST_CHECK_EQUAL(cmpctBlock.prefilledTxs.size(), 1U);
+    BOOST_CHECK_EQUAL(cmpctBlock.prefilledTxs[0].index, 0U);
+    BOOST_CHECK_EQUAL(cmpctBlock.shortTxIds.size(), 3U);
+
+    // only the first user tx is known locally
+    CTxMemPool pool;
+    pool.memPoolTxs.emplace(vptxUser[0]->GetHash(), CTxMemPoolEntry(vptxUser[0].get(), 0, 10));
+
+    CPartialBlock partialBlock;
+    BOOST_CHECK(partialBlock.InitData(cmpctBlock, pool) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+    BOOST_CHECK(partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(partialBlock.missingIndexes == vector<uint32_t>({2, 3}));
+
+    CBlock rebuilt;
+    BOOST_CHECK(partialBlock.FillBlock(rebuilt, {vptxUser[1], vptxUser[2]}) == READ_STATUS_OK);
+    BOOST_CHECK(rebuilt.GetHash() == block.GetHash());
+    BOOST_CHECK(rebuilt.BuildMerkleTree() == block.GetMerkleRootHash());
+
+    // txs given back in the wrong order don't match the merkle root
+    CPartialBlock partialBlock2;
+    BOOST_CHECK(partialBlock2.InitData(cmpctBlock, pool) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock2.FillBlock(rebuilt, {vptxUser[2], vptxUser[1]}) == READ_STATUS_FAILED);
+
+    // a missing tx left out is invalid
+    CPartialBlock partialBlock3;
+    BOOST_CHECK(partialBlock3.InitData(cmpctBlock, pool) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock3.FillBlock(rebuilt, {vptxUser[1]}) == READ_STATUS_INVALID);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_prefilled_index)
+{
+    vector<std::shared_ptr<CBaseTx>> vptxUser;
+    CBlock block = BuildBlock(vptxUser);
+
+    CBlockHeaderAndShortTxIDs cmpctBlock(block);
+    cmpctBlock.prefilledTxs[0].index = 4;
+
+    CTxMemPool pool;
+    CPartialBlock partialBlock;
+    BOOST_CHECK(partialBlock.InitData(cmpctBlock, pool) == READ_STATUS_INVALID);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
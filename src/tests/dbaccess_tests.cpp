@@ -5,6 +5,7 @@
 #include "main.h"
 
 #include <string>
+#include <thread>
 #include <vector>
 #include <map>
 #include <boost/test/unit_test.hpp>
@@ -60,6 +61,94 @@ BOOST_AUTO_TEST_CASE(dbaccess_test)
 
 }
 
+BOOST_AUTO_TEST_CASE(dbaccess_flush_batch_test)
+{
+    bool isWipe = true;
+    shared_ptr<CDBAccess> pDBAccess = make_shared<CDBAccess>(
+        db_dir, DBNameType::ACCOUNT, false, isWipe);
+    const dbk::PrefixType prefix = dbk::REGID_KEYID;
+    map<string, string> mapData;
+    mapData["regid-1"] = "keyid-1";
+    mapData["regid-2"] = "";
+
+    // nothing reaches the db until the flush batch is committed
+    pDBAccess->BeginFlushBatch();
+    pDBAccess->BatchWrite<string, string>(prefix, mapData);
+    auto pBatch = pDBAccess->EndFlushBatch();
+    BOOST_CHECK(pBatch && pBatch->GetOpCount() == 2);
+    string value1;
+    BOOST_CHECK(!pDBAccess->GetData(prefix, string("regid-1"), value1));
+
+    // journal round trip
+    CDBFlushJournal journal;
+    journal.epoch = 7;
+    pBatch->GetOps(journal.batches[DBNameType::ACCOUNT]);
+    CDataStream ds(SER_DISK, CLIENT_VERSION);
+    ds << journal;
+    CDBFlushJournal journal2;
+    ds >> journal2;
+    BOOST_CHECK(journal2.epoch == 7);
+    BOOST_CHECK(journal2.batches[DBNameType::ACCOUNT].size() == 2);
+
+    CLevelDBBatch replayBatch;
+    replayBatch.AddOps(journal2.batches[DBNameType::ACCOUNT]);
+    BOOST_CHECK(pDBAccess->WriteBatch(replayBatch, true));
+    BOOST_CHECK(pDBAccess->GetData(prefix, string("regid-1"), value1));
+    BOOST_CHECK( value1 == "keyid-1" );
+    string value2;
+    BOOST_CHECK(!pDBAccess->GetData(prefix, string("regid-2"), value2));
+}
+
+BOOST_AUTO_TEST_CASE(dbcache_concurrent_reads_test)
+{
+    const bool isWipe = true;
+    const dbk::PrefixType prefix = dbk::REGID_KEYID;
+    shared_ptr<CDBAccess> pDBAccess = make_shared<CDBAccess>(
+        db_dir, DBNameType::ACCOUNT, false, isWipe);
+
+    typedef CCompositeKVCache<prefix, string, string> CacheType;
+    CacheType cache(pDBAccess.get());
+    cache.SetData("regid-1", "keyid-1");
+    cache.SetData("regid-2", "keyid-2");
+
+    vector<unique_ptr<CacheType>> children;
+    for (int32_t i = 0; i < 4; i++)
+        children.emplace_back(new CacheType(&cache));
+
+    {
+        CConcurrentReads concurrentReads;
+        vector<std::thread> threads;
+        vector<int32_t> hits(children.size(), 0);
+        for (size_t i = 0; i < children.size(); i++) {
+            threads.emplace_back([&, i]() {
+                string value;
+                for (int32_t n = 0; n < 1000; n++) {
+                    if (children[i]->GetData(string("regid-") + to_string(n % 2 + 1), value))
+                        hits[i]++;
+                }
+                children[i]->SetData("regid-1", "keyid-" + to_string(i));
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        for (auto hit : hits)
+            BOOST_CHECK_EQUAL(hit, 1000);
+
+        // range reads are refused
+        map<string, string> elements;
+        BOOST_CHECK_THROW(children[0]->GetAllElements(elements), runtime_error);
+        BOOST_CHECK(CConcurrentReads::TakeRangeReadRefused());
+        BOOST_CHECK(!CConcurrentReads::TakeRangeReadRefused());
+    }
+
+    // each child only wrote its own copy
+    string value;
+    BOOST_CHECK(cache.GetData(string("regid-1"), value) && value == "keyid-1");
+    BOOST_CHECK(children[3]->GetData(string("regid-1"), value) && value == "keyid-3");
+    map<string, string> elements;
+    BOOST_CHECK(children[0]->GetAllElements(elements));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 
@@ -144,6 +233,37 @@ BOOST_AUTO_TEST_CASE(dbcache_scalar_value_Level3_test)
     BOOST_CHECK( value1 == "keyid-1" );
 }
 
+BOOST_AUTO_TEST_CASE(dbcache_missing_key_test)
+{
+    const bool isWipe = true;
+    const dbk::PrefixType prefix = dbk::REGID_KEYID;
+    shared_ptr<CDBAccess> pDBAccess = make_shared<CDBAccess>(
+        db_dir, DBNameType::ACCOUNT, false, isWipe);
+
+    auto pDBCache1 = make_shared< CCompositeKVCache<prefix, string, string> >(pDBAccess.get());
+    auto pDBCache2 = make_shared< CCompositeKVCache<prefix, string, string> >(pDBCache1.get());
+
+    // the miss is remembered by the top level cache
+    string value1;
+    BOOST_CHECK(!pDBCache2->GetData(string("regid-1"), value1));
+    BOOST_CHECK(!pDBCache1->HaveData(string("regid-1")));
+
+    // and forgotten once the key is set from an upper level cache
+    pDBCache2->SetData("regid-1", "keyid-1");
+    pDBCache2->Flush();
+    pDBCache1->Flush();
+    BOOST_CHECK(pDBCache1->GetData(string("regid-1"), value1));
+    BOOST_CHECK( value1 == "keyid-1" );
+
+    // or directly at the top level
+    BOOST_CHECK(!pDBCache1->HaveData(string("regid-2")));
+    pDBCache1->SetData("regid-2", "keyid-2");
+    pDBCache1->Flush();
+    string value2;
+    BOOST_CHECK(pDBCache1->GetData(string("regid-2"), value2));
+    BOOST_CHECK( value2 == "keyid-2" );
+}
+
 template <typename T>
 static uint32_t GetSerSize(const T &t) {
     return ::GetSerializeSize(t, SER_DISK, CLIENT_VERSION);
@@ -174,11 +294,189 @@ BOOST_AUTO_TEST_CASE(dbcache_cache_size_test)
     BOOST_CHECK(pDBCache->GetCacheSize() == 0);
     BOOST_CHECK(GetCacheSerializeSize(*pDBCache) == 0);
 
+    // the flushed values are kept as clean ones, which don't count as data to be flushed
+    BOOST_CHECK(pDBCache->GetCleanDataCount() == 3);
+    pDBCache->Clear();
+    BOOST_CHECK(pDBCache->GetCleanDataCount() == 3);
+
     auto pDBCache2 = make_shared< CCompositeKVCache<prefix, string, string> >(pDBCache.get());
     string value1;
     BOOST_CHECK(pDBCache2->GetData(string("regid-1"), value1));
-    BOOST_CHECK(pDBCache->GetCacheSize() == GetSerSize(make_pair<string, string>("regid-1", "keyid-1")));
+    BOOST_CHECK(pDBCache->GetCacheSize() == 0);
     BOOST_CHECK(!pDBCache2->IsCalcSize() && pDBCache2->GetCacheSize() == 0);
+
+    // a modified value leaves the clean ones
+    pDBCache2->SetData("regid-1", "keyid-1-new");
+    pDBCache2->Flush();
+    BOOST_CHECK(pDBCache->GetCleanDataCount() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(dbcache_clean_data_lru_test)
+{
+    const bool isWipe = true;
+    const dbk::PrefixType prefix = dbk::REGID_KEYID;
+    shared_ptr<CDBAccess> pDBAccess = make_shared<CDBAccess>(
+        db_dir, DBNameType::ACCOUNT, false, isWipe);
+
+    CCompositeKVCache<prefix, string, string> cache(pDBAccess.get());
+    cache.SetData("regid-1", "keyid-1");
+    cache.SetData("regid-2", "keyid-2");
+    cache.SetData("regid-3", "keyid-3");
+    cache.Flush();
+
+    // room for two values only, the least recently used one is evicted
+    uint32_t itemSize = GetSerSize(string("regid-1")) + GetSerSize(string("keyid-1"));
+    CCleanCache &cleanCache = pDBAccess->GetCleanCache();
+    BOOST_CHECK(cleanCache.GetSize() == 3 * itemSize && cleanCache.GetCount() == 3);
+    string value;
+    BOOST_CHECK(cache.GetData(string("regid-1"), value));
+    cleanCache.SetLimit(2 * itemSize);
+    BOOST_CHECK(cache.GetCleanDataCount() == 2 && cleanCache.GetSize() == 2 * itemSize);
+
+    // the evicted value is read from the db again
+    BOOST_CHECK(cache.GetData(string("regid-2"), value) && value == "keyid-2");
+    BOOST_CHECK(cache.GetData(string("regid-1"), value) && value == "keyid-1");
+    BOOST_CHECK(cache.GetCleanDataCount() == 2 && cache.GetCacheSize() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(dbcache_copy_on_write_test)
+{
+    const bool isWipe = true;
+    const dbk::PrefixType prefix = dbk::REGID_KEYID;
+    shared_ptr<CDBAccess> pDBAccess = make_shared<CDBAccess>(
+        db_dir, DBNameType::ACCOUNT, false, isWipe);
+
+    typedef CCompositeKVCache<prefix, string, string> CacheType;
+    CacheType cache(pDBAccess.get());
+    cache.SetData("regid-1", "keyid-1");
+    cache.SetData("regid-2", "keyid-2");
+
+    // the copy shares the data of the source
+    CacheType copy(cache);
+    BOOST_CHECK(cache.GetFrozenMaps().size() == 1 && copy.GetFrozenMaps() == cache.GetFrozenMaps());
+    BOOST_CHECK(cache.GetOwnMapData().empty() && copy.GetOwnMapData().empty());
+    BOOST_CHECK(copy.GetCacheSize() == cache.GetCacheSize());
+
+    // and only the modified data is copied
+    copy.SetData("regid-1", "keyid-1-new");
+    copy.EraseData("regid-2");
+    copy.SetData("regid-3", "keyid-3");
+    BOOST_CHECK(copy.GetOwnMapData().size() == 3 && cache.GetOwnMapData().empty());
+
+    string value;
+    BOOST_CHECK(cache.GetData(string("regid-1"), value) && value == "keyid-1");
+    BOOST_CHECK(cache.HaveData(string("regid-2")) && !cache.HaveData(string("regid-3")));
+    BOOST_CHECK(copy.GetData(string("regid-1"), value) && value == "keyid-1-new");
+    BOOST_CHECK(!copy.HaveData(string("regid-2")) && copy.HaveData(string("regid-3")));
+
+    map<string, string> elements;
+    BOOST_CHECK(copy.GetAllElements(elements));
+    BOOST_CHECK(elements.size() == 2 && elements["regid-1"] == "keyid-1-new");
+
+    // a child doesn't keep the values it reads from its base
+    CacheType child(&copy);
+    BOOST_CHECK(child.GetData(string("regid-3"), value) && value == "keyid-3");
+    BOOST_CHECK(child.GetOwnMapData().empty());
+
+    cache.Flush();
+    BOOST_CHECK(cache.GetFrozenMaps().empty() && cache.GetCacheSize() == 0);
+    BOOST_CHECK(pDBAccess->GetData(prefix, string("regid-2"), value) && value == "keyid-2");
+    BOOST_CHECK(copy.GetData(string("regid-1"), value) && value == "keyid-1-new");
+}
+
+BOOST_AUTO_TEST_CASE(dbcache_read_log_and_discard_test)
+{
+    const bool isWipe = true;
+    const dbk::PrefixType prefix = dbk::REGID_KEYID;
+    shared_ptr<CDBAccess> pDBAccess = make_shared<CDBAccess>(
+        db_dir, DBNameType::ACCOUNT, false, isWipe);
+
+    typedef CCompositeKVCache<prefix, string, string> CacheType;
+    CacheType cache(pDBAccess.get());
+    cache.SetData("regid-1", "keyid-1");
+    cache.SetData("regid-2", "keyid-2");
+
+    CacheType child(&cache);
+    CDBOpLogMap dbOpLogMap;
+    CDbKeySet readKeys, writeKeys;
+    dbOpLogMap.SetReadKeys(&readKeys);
+    child.SetDbOpLogMap(&dbOpLogMap);
+
+    string value;
+    BOOST_CHECK(child.GetData(string("regid-1"), value));
+    child.SetData("regid-2", "keyid-2-new");
+    child.SetDbOpLogMap(nullptr);
+    writeKeys.AddWrites(dbOpLogMap);
+
+    CDbKeySet keys1, keys2;
+    CDataStream ssKey1(SER_DISK, CLIENT_VERSION), ssKey2(SER_DISK, CLIENT_VERSION);
+    ssKey1 << string("regid-1");
+    ssKey2 << string("regid-2");
+    const string &keyPrefix = dbk::GetKeyPrefix(prefix);
+    keys1.Add(keyPrefix, ssKey1.str());
+    keys2.Add(keyPrefix, ssKey2.str());
+    BOOST_CHECK(readKeys.Intersects(keys1) && !readKeys.Intersects(keys2));
+    BOOST_CHECK(writeKeys.Intersects(keys2) && !writeKeys.Intersects(keys1));
+
+    // a range read touches every key of the prefix
+    CDbKeySet rangeKeys;
+    rangeKeys.Add(keyPrefix, "");
+    BOOST_CHECK(rangeKeys.Intersects(keys1) && keys2.Intersects(rangeKeys));
+
+    // the discarded value is read from the base again
+    child.DiscardData(ssKey2.str());
+    BOOST_CHECK(child.GetOwnMapData().empty() && child.GetCacheSize() == 0);
+    BOOST_CHECK(child.GetData(string("regid-2"), value) && value == "keyid-2");
+}
+
+BOOST_AUTO_TEST_CASE(dbcache_concurrent_reads_test)
+{
+    const bool isWipe = true;
+    const dbk::PrefixType prefix = dbk::REGID_KEYID;
+    shared_ptr<CDBAccess> pDBAccess = make_shared<CDBAccess>(
+        db_dir, DBNameType::ACCOUNT, false, isWipe);
+
+    typedef CCompositeKVCache<prefix, string, string> CacheType;
+    CacheType cache(pDBAccess.get());
+    cache.SetData("regid-1", "keyid-1");
+    cache.SetData("regid-2", "keyid-2");
+
+    vector<unique_ptr<CacheType>> children;
+    for (int32_t i = 0; i < 4; i++)
+        children.emplace_back(new CacheType(&cache));
+
+    {
+        CConcurrentReads concurrentReads;
+        vector<std::thread> threads;
+        vector<int32_t> hits(children.size(), 0);
+        for (size_t i = 0; i < children.size(); i++) {
+            threads.emplace_back([&, i]() {
+                string value;
+                for (int32_t n = 0; n < 1000; n++) {
+                    if (children[i]->GetData(string("regid-") + to_string(n % 2 + 1), value))
+                        hits[i]++;
+                }
+                children[i]->SetData("regid-1", "keyid-" + to_string(i));
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        for (auto hit : hits)
+            BOOST_CHECK_EQUAL(hit, 1000);
+
+        // range reads are refused
+        map<string, string> elements;
+        BOOST_CHECK_THROW(children[0]->GetAllElements(elements), runtime_error);
+        BOOST_CHECK(CConcurrentReads::TakeRangeReadRefused());
+        BOOST_CHECK(!CConcurrentReads::TakeRangeReadRefused());
+    }
+
+    // each child only wrote its own copy
+    string value;
+    BOOST_CHECK(cache.GetData(string("regid-1"), value) && value == "keyid-1");
+    BOOST_CHECK(children[3]->GetData(string("regid-1"), value) && value == "keyid-3");
+    map<string, string> elements;
+    BOOST_CHECK(children[0]->GetAllElements(elements));
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,80 @@
+// Copyright (c) 2017-2019 The WaykiChain Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "p2p/headerchain.h"
+#include "persistence/block.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+static CBlockHeader NextHeader(const CHeaderChain &chain) {
+    CBlockHeader header;
+    header.SetPrevBlockHash(chain.GetLastHash());
+    header.SetHeight(chain.GetHeight() + 1);
+    header.SetTime(chain.GetLastTime() + 3);
+    return header;
+}
+
+BOOST_AUTO_TEST_SUITE(headerchain_tests)
+
+BOOST_AUTO_TEST_CASE(append_and_prune)
+{
+    uint256 baseHash = uint256S("1");
+    CHeaderChain chain;
+    chain.Reset(baseHash, 100, 1570000000);
+    BOOST_CHECK(chain.IsEmpty());
+    BOOST_CHECK(chain.GetLastHash() == baseHash);
+
+    vector<uint256> vHashes;
+    for (int32_t i = 0; i < 5; i++) {
+        CBlockHeader header = NextHeader(chain);
+        BOOST_CHECK(chain.Append(header));
+        vHashes.push_back(header.GetHash());
+    }
+    BOOST_CHECK_EQUAL(chain.Size(), 5U);
+    BOOST_CHECK_EQUAL(chain.GetHeight(), 105);
+    BOOST_CHECK(chain.GetHash(103) == vHashes[2]);
+    BOOST_CHECK(chain.Contains(vHashes[4], 105));
+    BOOST_CHECK(!chain.Contains(vHashes[4], 104));
+    BOOST_CHECK(chain.GetHash(106).IsNull());
+
+    // a header not following the last one
+    CBlockHeader header = NextHeader(chain);
+    header.SetHeight(107);
+    BOOST_CHECK(!chain.Append(header));
+    header.SetHeight(106);
+    header.SetPrevBlockHash(vHashes[3]);
+    BOOST_CHECK(!chain.Append(header));
+
+    // the tip moved along the header chain
+    BOOST_CHECK(chain.Prune(vHashes[1], 102, 1570000006));
+    BOOST_CHECK_EQUAL(chain.GetBaseHeight(), 102);
+    BOOST_CHECK_EQUAL(chain.Size(), 3U);
+    BOOST_CHECK(chain.GetHash(103) == vHashes[2]);
+    BOOST_CHECK(chain.GetHash(101).IsNull());
+
+    // the tip went past the last header
+    uint256 tipHash = uint256S("2");
+    BOOST_CHECK(chain.Prune(tipHash, 110, 1570000030));
+    BOOST_CHECK(chain.IsEmpty());
+    BOOST_CHECK(chain.GetLastHash() == tipHash);
+}
+
+BOOST_AUTO_TEST_CASE(prune_off_the_chain)
+{
+    CHeaderChain chain;
+    chain.Reset(uint256S("1"), 100, 1570000000);
+    BOOST_CHECK(chain.Append(NextHeader(chain)));
+    BOOST_CHECK(chain.Append(NextHeader(chain)));
+
+    // a tip of another branch starts the header chain over from it
+    uint256 forkHash = uint256S("3");
+    BOOST_CHECK(!chain.Prune(forkHash, 101, 1570000003));
+    BOOST_CHECK(chain.IsEmpty());
+    BOOST_CHECK_EQUAL(chain.GetBaseHeight(), 101);
+    BOOST_CHECK(chain.GetLastHash() == forkHash);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
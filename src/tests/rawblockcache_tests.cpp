@@ -0,0 +1,42 @@
+// Copyright (c) 2017-2019 The WaykiChain Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "p2p/rawblockcache.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+static std::shared_ptr<const CSerializeData> MakeMessage(size_t size, char fill) {
+    return std::make_shared<CSerializeData>(size, fill);
+}
+
+BOOST_AUTO_TEST_SUITE(rawblockcache_tests)
+
+BOOST_AUTO_TEST_CASE(lru_eviction)
+{
+    CRawBlockCache cache(300);
+    uint256 hash1 = uint256S("1");
+    uint256 hash2 = uint256S("2");
+    uint256 hash3 = uint256S("3");
+
+    cache.Add(hash1, MakeMessage(100, 'a'));
+    cache.Add(hash2, MakeMessage(100, 'b'));
+    BOOST_CHECK(cache.Get(hash1) != nullptr);
+    BOOST_CHECK_EQUAL(cache.Get(hash2)->front(), 'b');
+
+    // hash1 was served more recently than hash2, which is dropped first
+    cache.Get(hash1);
+    cache.Add(hash3, MakeMessage(150, 'c'));
+    BOOST_CHECK(cache.Get(hash1) != nullptr);
+    BOOST_CHECK(cache.Get(hash2) == nullptr);
+    BOOST_CHECK(cache.Get(hash3) != nullptr);
+
+    // a message over the whole budget is not kept
+    cache.Add(hash2, MakeMessage(301, 'd'));
+    BOOST_CHECK(cache.Get(hash2) == nullptr);
+    BOOST_CHECK(cache.Get(hash1) != nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -61,7 +61,7 @@ bool CLuaContractDeployTx::CheckTx(CTxExecuteContext &context) {
     }
 
     if (GetFeatureForkVersion(context.height) >= MAJOR_VER_R2) {
-        int32_t txSize  = ::GetSerializeSize(GetNewInstance(), SER_NETWORK, PROTOCOL_VERSION);
+        int32_t txSize  = GetSerializedSize() + 1;
         double feePerKb = double(llFees - llFuel) / txSize * 1000.0;
         if (feePerKb < MIN_RELAY_TX_FEE) {
             uint64_t minFee = ceil(double(MIN_RELAY_TX_FEE) * txSize / 1000.0 + llFuel);
@@ -314,7 +314,7 @@ bool CUniversalContractDeployTx::CheckTx(CTxExecuteContext &context) {
                         llFees, llFuel), REJECT_INVALID, "fee-too-small-to-cover-fuel");
     }
 
-    int32_t txSize  = ::GetSerializeSize(GetNewInstance(), SER_NETWORK, PROTOCOL_VERSION);
+    int32_t txSize  = GetSerializedSize() + 1;
     double feePerKb = double(llFees - llFuel) / txSize * 1000.0;
     if (feePerKb < MIN_RELAY_TX_FEE) {
         uint64_t minFee = ceil(double(MIN_RELAY_TX_FEE) * txSize / 1000.0 + llFuel);
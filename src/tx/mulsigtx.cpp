@@ -307,4 +307,16 @@ bool CMulsigTx::GetInvolvedKeyIds(CCacheWrapper &cw, set<CKeyID> &keyIds) {
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+void CMulsigTx::GetSignatureChecks(CCacheWrapper &cw, CSignatureBatch &batch) const {
+    uint256 sighash = GetHash();
+    CAccount account;
+    for (const auto &item : signaturePairs) {
+        if (item.signature.empty() || !CheckSignatureSize(item.signature))
+            continue;
+
+        if (cw.accountCache.GetAccount(item.regid, account) && account.owner_pubkey.IsValid())
+            batch.Add(sighash, item.signature, account.owner_pubkey);
+    }
+}
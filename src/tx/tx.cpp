@@ -39,6 +39,27 @@ string GetTxType(const TxType txType) {
         return "";
 }
 
+bool IsConcurrentTxType(const TxType txType) {
+    switch (txType) {
+        case BCOIN_TRANSFER_TX:
+        case UCOIN_TRANSFER_TX:
+        case UCOIN_TRANSFER_MTX:
+        case UCOIN_STAKE_TX:
+        case DELEGATE_VOTE_TX:
+        case PRICE_FEED_TX:
+        case DEX_LIMIT_BUY_ORDER_TX:
+        case DEX_LIMIT_SELL_ORDER_TX:
+        case DEX_MARKET_BUY_ORDER_TX:
+        case DEX_MARKET_SELL_ORDER_TX:
+        case DEX_CANCEL_ORDER_TX:
+        case DEX_ORDER_TX:
+        case DEX_OPERATOR_ORDER_TX:
+            return true;
+        default:
+            return false;
+    }
+}
+
 bool GetTxMinFee(const TxType nTxType, int height, const TokenSymbol &symbol, uint64_t &feeOut) {
     if (pCdMan->pSysParamCache->GetMinerFee(nTxType, symbol, feeOut))
         return true ;
@@ -144,6 +165,25 @@ bool CBaseTx::GetInvolvedKeyIds(CCacheWrapper &cw, set<CKeyID> &keyIds) {
     return AddInvolvedKeyIds({txUid}, cw, keyIds);
 }
 
+void CBaseTx::GetSignatureChecks(CCacheWrapper &cw, CSignatureBatch &batch) const {
+    if (!CheckSignatureSize(signature))
+        return;
+
+    CPubKey pubKey;
+    if (txUid.is<CPubKey>()) {
+        pubKey = txUid.get<CPubKey>();
+    } else {
+        CAccount account;
+        if (!cw.accountCache.GetAccount(txUid, account))
+            return;
+
+        pubKey = account.owner_pubkey;
+    }
+
+    if (pubKey.IsValid())
+        batch.Add(GetHash(), signature, pubKey);
+}
+
 bool CBaseTx::AddInvolvedKeyIds(vector<CUserID> uids, CCacheWrapper &cw, set<CKeyID> &keyIds) {
     for (auto uid : uids) {
         CKeyID keyId;
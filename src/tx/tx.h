@@ -55,6 +55,10 @@ class CValidationState;
 
 string GetTxType(const TxType txType);
 bool GetTxMinFee(const TxType nTxType, int height, const TokenSymbol &symbol, uint64_t &feeOut);
+// Whether the execution of a tx of the type depends on nothing but the block context and the state it
+// reads through its cache, so that it may be executed concurrently with other txs. The others (e.g.
+// contracts, or txs using their index in the block) must be executed in turn.
+bool IsConcurrentTxType(const TxType txType);
 
 inline const string& GetTxTypeName(TxType txType) {
     auto it = kTxFeeTable.find(txType);
@@ -112,27 +116,29 @@ public:
     uint64_t nRunStep;     //!< only in memory
     int32_t nFuelRate;     //!< only in memory
     mutable TxID sigHash;  //!< only in memory
+    mutable uint32_t nSerializedSize;           //!< only in memory
+    std::shared_ptr<const CDataStream> spRawTx;  //!< only in memory, the bytes the tx was received in
 
 public:
     CBaseTx(int32_t nVersionIn, TxType nTxTypeIn, CUserID txUidIn, int32_t nValidHeightIn, uint64_t llFeesIn) :
         nVersion(nVersionIn), nTxType(nTxTypeIn), txUid(txUidIn), valid_height(nValidHeightIn),
-        fee_symbol(SYMB::WICC), llFees(llFeesIn), nRunStep(0), nFuelRate(0) {}
+        fee_symbol(SYMB::WICC), llFees(llFeesIn), nRunStep(0), nFuelRate(0), nSerializedSize(0) {}
 
     CBaseTx(TxType nTxTypeIn, CUserID txUidIn, int32_t nValidHeightIn, TokenSymbol feeSymbolIn, uint64_t llFeesIn) :
         nVersion(CURRENT_VERSION), nTxType(nTxTypeIn), txUid(txUidIn), valid_height(nValidHeightIn),
-        fee_symbol(feeSymbolIn), llFees(llFeesIn), nRunStep(0), nFuelRate(0) {}
+        fee_symbol(feeSymbolIn), llFees(llFeesIn), nRunStep(0), nFuelRate(0), nSerializedSize(0) {}
 
     CBaseTx(TxType nTxTypeIn, CUserID txUidIn, int32_t nValidHeightIn, uint64_t llFeesIn) :
         nVersion(CURRENT_VERSION), nTxType(nTxTypeIn), txUid(txUidIn), valid_height(nValidHeightIn),
-        fee_symbol(SYMB::WICC), llFees(llFeesIn), nRunStep(0), nFuelRate(0) {}
+        fee_symbol(SYMB::WICC), llFees(llFeesIn), nRunStep(0), nFuelRate(0), nSerializedSize(0) {}
 
     CBaseTx(int32_t nVersionIn, TxType nTxTypeIn) :
         nVersion(nVersionIn), nTxType(nTxTypeIn), valid_height(0), fee_symbol(SYMB::WICC), llFees(0), nRunStep(0),
-        nFuelRate(0) {}
+        nFuelRate(0), nSerializedSize(0) {}
 
     CBaseTx(TxType nTxTypeIn) :
         nVersion(CURRENT_VERSION), nTxType(nTxTypeIn), valid_height(0), fee_symbol(SYMB::WICC), llFees(0), nRunStep(0),
-        nFuelRate(0) {}
+        nFuelRate(0), nSerializedSize(0) {}
 
     virtual ~CBaseTx() {}
 
@@ -149,9 +155,24 @@ public:
 
     virtual uint32_t GetSerializeSize(int32_t nType, int32_t nVersion) const { return 0; }
 
+    // Serialized size of the tx without its type byte, cached like the hash: recalculate it after
+    // changing a tx whose size was already taken.
+    uint32_t GetSerializedSize(bool recalculate = false) const {
+        if (recalculate || nSerializedSize == 0)
+            nSerializedSize = (spRawTx && !recalculate) ? spRawTx->size() - 1
+                                                        : GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION);
+        return nSerializedSize;
+    }
+
+    // Keep the network bytes of a received tx (type byte included) to relay and serve it as is.
+    void SetRawTx(std::shared_ptr<const CDataStream> spRawTxIn) {
+        spRawTx         = spRawTxIn;
+        nSerializedSize = 0;
+    }
+
     virtual uint64_t GetFuel(int32_t height, uint32_t nFuelRate);
     virtual double GetPriority() const {
-        return TRANSACTION_PRIORITY_CEILING / GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION);
+        return TRANSACTION_PRIORITY_CEILING / GetSerializedSize();
     }
     virtual void SerializeForHash(CHashWriter &hw) const = 0;
     virtual std::shared_ptr<CBaseTx> GetNewInstance() const           = 0;
@@ -159,6 +180,9 @@ public:
     virtual Object ToJson(const CAccountDBCache &accountCache) const;
 
     virtual bool GetInvolvedKeyIds(CCacheWrapper &cw, set<CKeyID> &keyIds);
+    // Collect the signature verifications of this tx which can be run ahead of CheckTx() in parallel.
+    // Best effort only: anything unresolvable here is left to CheckTx().
+    virtual void GetSignatureChecks(CCacheWrapper &cw, CSignatureBatch &batch) const;
 
     virtual bool CheckTx(CTxExecuteContext &context)   = 0;
     virtual bool ExecuteTx(CTxExecuteContext &context) = 0;
@@ -4,37 +4,110 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "txmempool.h"
+#include "commons/memusage.h"
 #include "commons/uint256.h"
 #include "main.h"
 #include "persistence/txdb.h"
 #include "tx/tx.h"
 #include "miner/miner.h"
 
+#include <cmath>
+
 using namespace std;
 
+TxPriority::TxPriority(const double priorityIn, const double feePerKbIn, const std::shared_ptr<CBaseTx> &baseTxIn)
+    : priority(priorityIn), feePerKb(feePerKbIn), baseTx(baseTxIn), txid(baseTxIn->GetHash()) {}
+
 CTxMemPoolEntry::CTxMemPoolEntry() {
     nTxSize   = 0;
     dPriority = 0.0;
+    dFeePerKb = 0.0;
 
     nTime   = 0;
     height = 0;
+
+    nSequence = 0;
+    fStale    = false;
+
+    nCountWithAncestors   = 0;
+    nSizeWithAncestors    = 0;
+    dFeesWithAncestors    = 0.0;
+    nCountWithDescendants = 0;
+    nSizeWithDescendants  = 0;
+    dFeesWithDescendants  = 0.0;
+    dScore                = 0.0;
+    dEvictScore           = 0.0;
+
+    nUsageSize = 0;
 }
 
 CTxMemPoolEntry::CTxMemPoolEntry(CBaseTx *pBaseTx, int64_t time, uint32_t height) : nTime(time), height(height) {
     pTx       = pBaseTx->GetNewInstance();
     nFees     = pTx->GetFees();
-    nTxSize   = ::GetSerializeSize(*pTx, SER_NETWORK, PROTOCOL_VERSION);
+    nTxSize   = pTx->GetSerializedSize();
     dPriority = pTx->GetPriority();
+    dFeePerKb = 0.0;
+    nSequence = 0;
+    fStale    = false;
+
+    nCountWithAncestors   = 1;
+    nSizeWithAncestors    = nTxSize;
+    dFeesWithAncestors    = 0.0;
+    nCountWithDescendants = 1;
+    nSizeWithDescendants  = nTxSize;
+    dFeesWithDescendants  = 0.0;
+    dScore                = 0.0;
+    dEvictScore           = 0.0;
+
+    UpdateUsageSize();
+}
+
+void CTxMemPoolEntry::UpdateUsageSize() {
+    // the tx object is estimated from its serialized size, as its scripts and vectors account for
+    // most of its heap memory, plus the bytes it was received in when kept for relay
+    nUsageSize = memusage::DynamicUsage(pTx) + memusage::MallocUsage(nTxSize) + readKeys.DynamicMemoryUsage() +
+                 writeKeys.DynamicMemoryUsage();
+    if (pTx->spRawTx)
+        nUsageSize += memusage::MallocUsage(sizeof(CDataStream)) + memusage::MallocUsage(pTx->spRawTx->size());
+}
+
+void CTxMemPoolEntry::UpdateFeePerKb(int32_t height, uint32_t fuelRate) {
+    // the fuel is known once the tx has been executed
+    dFeePerKb = double(std::get<1>(nFees) - pTx->GetFuel(height, fuelRate)) / nTxSize * 1000.0;
+}
+
+void CTxMemPoolEntry::SetExecuted(CDbKeySet &readKeysIn, CDbKeySet &writeKeysIn, uint64_t sequence) {
+    std::swap(readKeys, readKeysIn);
+    std::swap(writeKeys, writeKeysIn);
+    nSequence = sequence;
+    fStale    = false;
+    UpdateUsageSize();
 }
 
-CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry &other) {
-    this->pTx       = other.pTx->GetNewInstance();
-    this->nFees     = other.nFees;
-    this->nTxSize   = other.nTxSize;
-    this->dPriority = other.dPriority;
+void CTxMemPoolEntry::UpdateAncestorState(uint64_t count, uint64_t size, double fees) {
+    nCountWithAncestors = count;
+    nSizeWithAncestors  = size;
+    dFeesWithAncestors  = fees;
+}
+
+void CTxMemPoolEntry::UpdateDescendantState(uint64_t count, uint64_t size, double fees) {
+    nCountWithDescendants = count;
+    nSizeWithDescendants  = size;
+    dFeesWithDescendants  = fees;
+}
+
+double CTxMemPoolEntry::GetAncestorScore() const {
+    if (nSizeWithAncestors == 0)
+        return dFeePerKb;
+
+    return std::min(dFeePerKb, dFeesWithAncestors / nSizeWithAncestors * 1000.0);
+}
+
+double CTxMemPoolEntry::GetDescendantScore() const {
+    if (nSizeWithDescendants == 0)
+        return dFeePerKb;
 
-    this->nTime  = other.nTime;
-    this->height = other.height;
+    return std::max(dFeePerKb, dFeesWithDescendants / nSizeWithDescendants * 1000.0);
 }
 
 CTxMemPool::CTxMemPool() {
@@ -42,29 +115,133 @@ CTxMemPool::CTxMemPool() {
     // accepting transactions becomes O(N^2) where N is the number
     // of transactions in the pool
     fSanityCheck         = false;
+    lastRollingFeeUpdate = GetTime();
+}
+
+// the entry gets into the priority index once UpdateSenderChains() has scored its chain
+void CTxMemPool::AddToIndexes(const CTxMemPoolEntry &entry) {
+    const auto &pTx = entry.GetTransaction();
+    string sender   = pTx->txUid.ToString();
+    timeIndex.emplace(entry.GetTime(), pTx->GetHash());
+    senderIndex[sender][entry.GetSequence()] = pTx->GetHash();
+    changedSenders.insert(sender);
+
+    totalTxSize += entry.GetTxSize();
+    cachedInnerUsage += entry.DynamicMemoryUsage();
+    nTransactionsUpdated++;
+}
+
+void CTxMemPool::RemoveFromIndexes(const CTxMemPoolEntry &entry) {
+    const auto &pTx = entry.GetTransaction();
+    priorityIndex.erase(entry.GetTxPriority());
+    evictionIndex.erase(make_pair(entry.GetEvictScore(), pTx->GetHash()));
+    timeIndex.erase(make_pair(entry.GetTime(), pTx->GetHash()));
+    totalTxSize -= entry.GetTxSize();
+    cachedInnerUsage -= entry.DynamicMemoryUsage();
+
+    string sender = pTx->txUid.ToString();
+    auto senderIt = senderIndex.find(sender);
+    if (senderIt != senderIndex.end()) {
+        senderIt->second.erase(entry.GetSequence());
+        if (senderIt->second.empty()) {
+            senderIndex.erase(senderIt);
+            changedSenders.erase(sender);
+        } else {
+            changedSenders.insert(sender);
+        }
+    }
+}
+
+void CTxMemPool::UpdateSenderChains() {
+    for (const auto &sender : changedSenders) {
+        auto senderIt = senderIndex.find(sender);
+        if (senderIt == senderIndex.end())
+            continue;
+
+        vector<CTxMemPoolEntry *> chain;
+        chain.reserve(senderIt->second.size());
+        for (const auto &item : senderIt->second)
+            chain.push_back(&memPoolTxs.find(item.second)->second);
+
+        uint64_t count = 0;
+        uint64_t size  = 0;
+        double fees    = 0.0;
+        for (auto pEntry : chain) {
+            fees += pEntry->GetNetFees();
+            size += pEntry->GetTxSize();
+            pEntry->UpdateAncestorState(++count, size, fees);
+
+            priorityIndex.erase(pEntry->GetTxPriority());
+            pEntry->SetScore(pEntry->GetAncestorScore());
+            priorityIndex.insert(pEntry->GetTxPriority());
+        }
+
+        count = 0;
+        size  = 0;
+        fees  = 0.0;
+        for (auto it = chain.rbegin(); it != chain.rend(); it++) {
+            fees += (*it)->GetNetFees();
+            size += (*it)->GetTxSize();
+            (*it)->UpdateDescendantState(++count, size, fees);
+
+            uint256 txid = (*it)->GetTransaction()->GetHash();
+            evictionIndex.erase(make_pair((*it)->GetEvictScore(), txid));
+            (*it)->SetEvictScore((*it)->GetDescendantScore());
+            evictionIndex.emplace((*it)->GetEvictScore(), txid);
+        }
+    }
+    changedSenders.clear();
+}
+
+map<uint256, CTxMemPoolEntry>::iterator CTxMemPool::EraseEntry(map<uint256, CTxMemPoolEntry>::iterator it) {
+    // the writes of a stale tx are already dropped from the pool state
+    if (!it->second.IsStale())
+        removedKeys.Add(it->second.GetWriteKeys());
+    RemoveFromIndexes(it->second);
+    return memPoolTxs.erase(it);
 }
 
 void CTxMemPool::Remove(CBaseTx *pBaseTx, list<std::shared_ptr<CBaseTx> > &removed, bool fRecursive) {
     // Remove transaction from memory pool
     LOCK(cs);
     uint256 txid = pBaseTx->GetHash();
-    if (memPoolTxs.count(txid)) {
-        removed.push_front(std::shared_ptr<CBaseTx>(memPoolTxs[txid].GetTransaction()));
-        memPoolTxs.erase(txid);
+    auto it = memPoolTxs.find(txid);
+    if (it != memPoolTxs.end()) {
+        removed.push_front(std::shared_ptr<CBaseTx>(it->second.GetTransaction()));
+        EraseEntry(it);
         EraseTransaction(txid);
+        UpdateSenderChains();
     }
 }
 
+void CTxMemPool::Erase(const vector<std::shared_ptr<CBaseTx>> &txs) {
+    LOCK(cs);
+    for (const auto &pTx : txs) {
+        auto it = memPoolTxs.find(pTx->GetHash());
+        if (it != memPoolTxs.end())
+            EraseEntry(it);
+    }
+    UpdateSenderChains();
+    blockSinceLastRollingFeeBump = true;
+}
+
 bool CTxMemPool::AddUnchecked(const uint256 &txid, const CTxMemPoolEntry &entry, CValidationState &state) {
     // Add to memory pool without checking anything.
     // Used by main.cpp AcceptToMemoryPool(), which DOES
     // all the appropriate checks.
     LOCK(cs);
     {
-        if (!CheckTxInMemPool(txid, entry, state))
+        CDbKeySet readKeys, writeKeys;
+        if (!CheckTxInMemPool(txid, entry, state, true, &readKeys, &writeKeys))
             return false;
 
-        memPoolTxs.insert(make_pair(txid, entry));
+        auto ret = memPoolTxs.emplace(txid, entry);
+        if (ret.second) {
+            ret.first->second.SetExecuted(readKeys, writeKeys, ++nSequence);
+            ret.first->second.UpdateFeePerKb(chainActive.Height() + 1, GetElementForBurn(chainActive.Tip()));
+            AddToIndexes(ret.first->second);
+            UpdateSenderChains();
+        }
     }
     return true;
 }
@@ -80,7 +257,7 @@ void CTxMemPool::QueryHash(vector<uint256> &txids) {
 }
 
 bool CTxMemPool::CheckTxInMemPool(const uint256 &txid, const CTxMemPoolEntry &memPoolEntry, CValidationState &state,
-                                  bool bExecute) {
+                                  bool bExecute, CDbKeySet *pReadKeys, CDbKeySet *pWriteKeys) {
     // is it within valid height
     static int validHeight = SysCfg().GetTxCacheHeight();
     if (!memPoolEntry.GetTransaction()->IsValidHeight(chainActive.Height(), validHeight))
@@ -94,6 +271,12 @@ bool CTxMemPool::CheckTxInMemPool(const uint256 &txid, const CTxMemPoolEntry &me
 
     auto spCW = std::make_shared<CCacheWrapper>(cw.get());
 
+    // the undo op logs give the keys written
+    CDBOpLogMap dbOpLogMap;
+    dbOpLogMap.SetReadKeys(pReadKeys);
+    if (pReadKeys != nullptr || pWriteKeys != nullptr)
+        spCW->SetDbOpLogMap(&dbOpLogMap);
+
     if (bExecute) {
         CBlockIndex *pTip =  chainActive.Tip();
         uint32_t fuelRate  = GetElementForBurn(pTip);
@@ -107,43 +290,228 @@ bool CTxMemPool::CheckTxInMemPool(const uint256 &txid, const CTxMemPoolEntry &me
         }
     }
 
+    spCW->SetDbOpLogMap(nullptr);
+    if (pWriteKeys != nullptr)
+        pWriteKeys->AddWrites(dbOpLogMap);
+
     spCW->Flush();
 
     return true;
 }
 
+bool CTxMemPool::ExecuteEntry(map<uint256, CTxMemPoolEntry>::iterator it, CValidationState &state) {
+    CDbKeySet readKeys, writeKeys;
+    if (!CheckTxInMemPool(it->first, it->second, state, true, &readKeys, &writeKeys))
+        return false;
+
+    // a new sequence moves it to the end of the chain of its sender
+    RemoveFromIndexes(it->second);
+    it->second.SetExecuted(readKeys, writeKeys, ++nSequence);
+    AddToIndexes(it->second);
+    return true;
+}
+
 void CTxMemPool::SetMemPoolCache() {
     cw.reset(new CCacheWrapper(pCdMan));
 }
 
-void CTxMemPool::ReScanMemPoolTx() {
-    cw.reset(new CCacheWrapper(pCdMan));
+void CTxMemPool::InvalidateKeys(const CDbKeySet &changedKeys) {
+    LOCK(cs);
+    CDbKeySet droppedKeys = changedKeys;
+    droppedKeys.Add(removedKeys);
+    removedKeys.Clear();
+    if (droppedKeys.IsEmpty())
+        return;
 
+    // the txs reading a dropped key see another value now, and the keys they wrote are dropped
+    // in turn as they are executed again, so repeat until no more tx is touched
+    vector<CTxMemPoolEntry *> entries;
+    entries.reserve(memPoolTxs.size());
+    for (auto &item : memPoolTxs) {
+        if (!item.second.IsStale())
+            entries.push_back(&item.second);
+    }
+    sort(entries.begin(), entries.end(), [](const CTxMemPoolEntry *a, const CTxMemPoolEntry *b) {
+        return a->GetSequence() < b->GetSequence();
+    });
+
+    bool fTouched = true;
+    while (fTouched) {
+        fTouched = false;
+        for (auto pEntry : entries) {
+            if (pEntry->IsStale() || !pEntry->Touches(droppedKeys))
+                continue;
+
+            pEntry->SetStale();
+            droppedKeys.Add(pEntry->GetWriteKeys());
+            fTouched = true;
+        }
+    }
+
+    cw->DiscardData(droppedKeys);
+}
+
+void CTxMemPool::ReScanMemPoolTx() {
     LOCK(cs);
     CValidationState state;
-    for (map<uint256, CTxMemPoolEntry>::iterator iterTx = memPoolTxs.begin(); iterTx != memPoolTxs.end();) {
-        if (!CheckTxInMemPool(iterTx->first, iterTx->second, state, true)) {
+    int32_t height    = chainActive.Height() + 1;
+    uint32_t fuelRate = GetElementForBurn(chainActive.Tip());
+
+    // the execution rules changed, start over
+    if (GetFeatureForkVersion(height) != GetFeatureForkVersion(nExecHeight)) {
+        cw.reset(new CCacheWrapper(pCdMan));
+        removedKeys.Clear();
+        for (auto &item : memPoolTxs)
+            item.second.SetStale();
+    }
+    nExecHeight = height;
+
+    static int validHeight = SysCfg().GetTxCacheHeight();
+    for (auto iterTx = memPoolTxs.begin(); iterTx != memPoolTxs.end();) {
+        if (!iterTx->second.GetTransaction()->IsValidHeight(chainActive.Height(), validHeight)) {
             uint256 txid = iterTx->first;
-            iterTx       = memPoolTxs.erase(iterTx++);
+            iterTx       = EraseEntry(iterTx);
             EraseTransaction(txid);
             continue;
         }
         ++iterTx;
     }
+    InvalidateKeys(CDbKeySet());
+
+    // execute the stale txs again in their former order
+    vector<pair<uint64_t, uint256>> staleTxs;
+    for (const auto &item : memPoolTxs) {
+        if (item.second.IsStale())
+            staleTxs.emplace_back(item.second.GetSequence(), item.first);
+    }
+    sort(staleTxs.begin(), staleTxs.end());
+
+    for (const auto &staleTx : staleTxs) {
+        auto iterTx = memPoolTxs.find(staleTx.second);
+        if (!ExecuteEntry(iterTx, state)) {
+            EraseEntry(iterTx);
+            EraseTransaction(staleTx.second);
+        }
+    }
+    // the stale txs failed to execute wrote nothing to the pool state
+    removedKeys.Clear();
+
+    // the fuel of the re-execution and the fuel rate of the new tip may change the order
+    for (auto &item : memPoolTxs)
+        item.second.UpdateFeePerKb(height, fuelRate);
+    for (const auto &item : senderIndex)
+        changedSenders.insert(item.first);
+    UpdateSenderChains();
+
+    LogPrint(BCLog::DEBUG, "ReScanMemPoolTx() : executed %u of %u txs again at height %d\n", staleTxs.size(),
+             memPoolTxs.size(), height);
 }
 
 void CTxMemPool::Clear() {
     LOCK(cs);
 
     memPoolTxs.clear();
+    priorityIndex.clear();
+    timeIndex.clear();
+    senderIndex.clear();
+    evictionIndex.clear();
+    changedSenders.clear();
+    removedKeys.Clear();
+    totalTxSize      = 0;
+    cachedInnerUsage = 0;
+    nTransactionsUpdated++;
     cw.reset(new CCacheWrapper(pCdMan));
 }
 
+void CTxMemPool::TrimToSize(size_t sizeLimit) {
+    LOCK(cs);
+    uint32_t nTxsRemoved = 0;
+    double maxFeeRateRemoved = 0.0;
+    while (!evictionIndex.empty() && DynamicMemoryUsage() > sizeLimit) {
+        auto it = memPoolTxs.find(evictionIndex.begin()->second);
+        const CTxMemPoolEntry &entry = it->second;
+
+        // the txs after it in the chain of its sender may depend on it, they go too
+        double removedFeeRate = entry.GetFeesWithDescendants() / entry.GetSizeWithDescendants() * 1000.0 +
+                                INCREMENTAL_RELAY_FEE_PER_KB;
+        if (removedFeeRate > rollingMinimumFeeRate) {
+            rollingMinimumFeeRate        = removedFeeRate;
+            lastRollingFeeUpdate         = GetTime();
+            blockSinceLastRollingFeeBump = false;
+        }
+        maxFeeRateRemoved = std::max(maxFeeRateRemoved, removedFeeRate);
+
+        vector<uint256> txids;
+        const auto &chain = senderIndex[entry.GetTransaction()->txUid.ToString()];
+        for (auto chainIt = chain.find(entry.GetSequence()); chainIt != chain.end(); chainIt++)
+            txids.push_back(chainIt->second);
+
+        for (const auto &txid : txids) {
+            EraseEntry(memPoolTxs.find(txid));
+            EraseTransaction(txid);
+        }
+        nTxsRemoved += txids.size();
+        UpdateSenderChains();
+    }
+
+    if (nTxsRemoved > 0) {
+        // the txs executed on top of the evicted ones are executed again by the next rescan
+        InvalidateKeys(CDbKeySet());
+        LogPrint(BCLog::INFO, "TrimToSize() : removed %u txs, rolling minimum fee bumped to %.0f per KB\n",
+                 nTxsRemoved, maxFeeRateRemoved);
+    }
+}
+
+double CTxMemPool::GetMinFeePerKb(size_t sizeLimit) {
+    LOCK(cs);
+    if (!blockSinceLastRollingFeeBump || rollingMinimumFeeRate == 0)
+        return rollingMinimumFeeRate;
+
+    int64_t time = GetTime();
+    if (time > lastRollingFeeUpdate + 10) {
+        // decay faster when the pool has plenty of room again
+        double halflife = ROLLING_FEE_HALFLIFE;
+        size_t usage    = DynamicMemoryUsage();
+        if (usage < sizeLimit / 4)
+            halflife /= 4;
+        else if (usage < sizeLimit / 2)
+            halflife /= 2;
+
+        rollingMinimumFeeRate = rollingMinimumFeeRate / pow(2.0, (time - lastRollingFeeUpdate) / halflife);
+        lastRollingFeeUpdate  = time;
+
+        if (rollingMinimumFeeRate < INCREMENTAL_RELAY_FEE_PER_KB / 2) {
+            rollingMinimumFeeRate = 0;
+            return 0;
+        }
+    }
+    return std::max(rollingMinimumFeeRate, (double)INCREMENTAL_RELAY_FEE_PER_KB);
+}
+
+size_t CTxMemPool::DynamicMemoryUsage() const {
+    LOCK(cs);
+    // the chains of the senders are small maps, their node overhead is counted per tx
+    return memusage::DynamicUsage(memPoolTxs) + memusage::DynamicUsage(priorityIndex) +
+           memusage::DynamicUsage(timeIndex) + memusage::DynamicUsage(evictionIndex) +
+           memusage::DynamicUsage(senderIndex) +
+           memusage::IncrementalDynamicUsage(map<uint64_t, uint256>()) * memPoolTxs.size() + cachedInnerUsage;
+}
+
+uint64_t CTxMemPool::GetTotalTxSize() const {
+    LOCK(cs);
+    return totalTxSize;
+}
+
 uint64_t CTxMemPool::Size() {
     LOCK(cs);
     return memPoolTxs.size();
 }
 
+uint64_t CTxMemPool::GetTransactionsUpdated() const {
+    LOCK(cs);
+    return nTransactionsUpdated;
+}
+
 bool CTxMemPool::Exists(const uint256 txid) {
     LOCK(cs);
     return ((memPoolTxs.count(txid) != 0));
@@ -14,6 +14,7 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <set>
 
 using namespace std;
 
@@ -21,6 +22,30 @@ class CValidationState;
 class CBaseTx;
 class uint256;
 
+/*
+ * Packing order of the txs: the priority band first (price feed txs above the price median tx,
+ * above all others), then the fee per KB net of the fuel, then the txid to keep the order total.
+ */
+struct TxPriority {
+    double priority;
+    double feePerKb;
+    std::shared_ptr<CBaseTx> baseTx;
+    uint256 txid;
+
+    TxPriority(const double priorityIn, const double feePerKbIn, const std::shared_ptr<CBaseTx> &baseTxIn);
+
+    // priorities less than TRANSACTION_PRIORITY_CEILING apart share a band
+    int64_t GetPriorityBand() const { return (int64_t)(priority / TRANSACTION_PRIORITY_CEILING); }
+
+    bool operator<(const TxPriority &other) const {
+        if (GetPriorityBand() != other.GetPriorityBand())
+            return GetPriorityBand() < other.GetPriorityBand();
+        if (feePerKb != other.feePerKb)
+            return feePerKb < other.feePerKb;
+        return txid < other.txid;
+    }
+};
+
 /*
  * CTxMemPool stores these:
  */
@@ -30,23 +55,76 @@ private:
     std::pair<TokenSymbol, uint64_t> nFees;  // Cached to avoid expensive parent-transaction lookups
     uint32_t nTxSize;                     // Cached to avoid recomputing tx size
     double dPriority;                     // Cached to avoid recomputing priority
+    double dFeePerKb;                     // Fee per KB net of the fuel, as of the last execution in the pool
 
     int64_t nTime;     // Local time when entering the mempool
     uint32_t height;  // Chain height when entering the mempool
 
+    // what the last execution in the pool read and wrote, and its order among the executions
+    CDbKeySet readKeys;
+    CDbKeySet writeKeys;
+    uint64_t nSequence;
+    bool fStale;       // its writes were dropped from the pool state, it has to be executed again
+
+    // The txs of a txUid form a chain in the order they are executed in the pool, each one may
+    // depend on the ones before. The aggregates include the entry itself, fees are net of the fuel.
+    uint64_t nCountWithAncestors;
+    uint64_t nSizeWithAncestors;
+    double dFeesWithAncestors;
+    uint64_t nCountWithDescendants;
+    uint64_t nSizeWithDescendants;
+    double dFeesWithDescendants;
+    double dScore;     // fee per KB the priority index orders it by
+    double dEvictScore; // fee per KB the eviction index orders it by
+
+    size_t nUsageSize;  // heap memory held by the tx and the key sets
+
 public:
+    // copies share the tx, which is never modified once in the pool
     CTxMemPoolEntry(CBaseTx *ptx, int64_t time, uint32_t height);
     CTxMemPoolEntry();
-    CTxMemPoolEntry(const CTxMemPoolEntry &other);
 
     std::shared_ptr<CBaseTx> GetTransaction() const { return pTx; }
 
     inline std::pair<TokenSymbol, uint64_t> GetFees() const { return nFees; }
     inline uint32_t GetTxSize() const { return nTxSize; }
     inline double GetPriority() const { return dPriority; }
+    inline double GetFeePerKb() const { return dFeePerKb; }
+    void UpdateFeePerKb(int32_t height, uint32_t fuelRate);
+    inline double GetNetFees() const { return dFeePerKb * nTxSize / 1000.0; }
+    TxPriority GetTxPriority() const { return TxPriority(dPriority, dScore, pTx); }
 
     inline int64_t GetTime() const { return nTime; }
     inline uint32_t GetHeight() const { return height; }
+
+    void SetExecuted(CDbKeySet &readKeysIn, CDbKeySet &writeKeysIn, uint64_t sequence);
+    inline const CDbKeySet& GetWriteKeys() const { return writeKeys; }
+    inline uint64_t GetSequence() const { return nSequence; }
+    // whether the last execution read or wrote any of the keys
+    bool Touches(const CDbKeySet &keys) const { return readKeys.Intersects(keys) || writeKeys.Intersects(keys); }
+    inline bool IsStale() const { return fStale; }
+    inline void SetStale() { fStale = true; }
+
+    inline uint64_t GetCountWithAncestors() const { return nCountWithAncestors; }
+    inline uint64_t GetSizeWithAncestors() const { return nSizeWithAncestors; }
+    inline double GetFeesWithAncestors() const { return dFeesWithAncestors; }
+    inline uint64_t GetCountWithDescendants() const { return nCountWithDescendants; }
+    inline uint64_t GetSizeWithDescendants() const { return nSizeWithDescendants; }
+    inline double GetFeesWithDescendants() const { return dFeesWithDescendants; }
+    void UpdateAncestorState(uint64_t count, uint64_t size, double fees);
+    void UpdateDescendantState(uint64_t count, uint64_t size, double fees);
+    // the lower of its own fee per KB and the one of the chain up to it, which has to be packed first
+    double GetAncestorScore() const;
+    inline void SetScore(double score) { dScore = score; }
+    // the higher of its own fee per KB and the one of the chain from it on, which goes with it
+    double GetDescendantScore() const;
+    inline double GetEvictScore() const { return dEvictScore; }
+    inline void SetEvictScore(double score) { dEvictScore = score; }
+
+    inline size_t DynamicMemoryUsage() const { return nUsageSize; }
+
+private:
+    void UpdateUsageSize();
 };
 
 /*
@@ -58,10 +136,15 @@ public:
  * are added to the pool: if a new transaction double-spends
  * an input of a transaction in the pool, it is dropped,
  * as are non-standard transactions.
+ *
+ * The txs are executed one after the other on top of the chain state in cw. When the chain
+ * state changes, only the txs which touched the changed keys, and the txs which touched
+ * the keys those wrote, are executed again.
  */
 class CTxMemPool {
 public:
     mutable CCriticalSection cs;
+    // txs by txid, read-only outside of CTxMemPool which keeps the indexes below in step with it
     map<uint256, CTxMemPoolEntry > memPoolTxs;
     std::shared_ptr<CCacheWrapper> cw;
 
@@ -72,19 +155,72 @@ public:
     void SetSanityCheck(bool fSanityCheckIn) { fSanityCheck = fSanityCheckIn; }
     bool AddUnchecked(const uint256 &txid, const CTxMemPoolEntry &entry, CValidationState &state);
     void Remove(CBaseTx *pBaseTx, list<std::shared_ptr<CBaseTx> > &removed, bool fRecursive = false);
+    // drop the txs confirmed in a block
+    void Erase(const vector<std::shared_ptr<CBaseTx>> &txs);
     void QueryHash(vector<uint256> &txids);
     bool CheckTxInMemPool(const uint256 &txid, const CTxMemPoolEntry &entry, CValidationState &state,
-                          bool bExecute = true);
+                          bool bExecute = true, CDbKeySet *pReadKeys = nullptr, CDbKeySet *pWriteKeys = nullptr);
     void SetMemPoolCache();
+    // drop the pool state depending on the keys changed by a connected or disconnected block
+    void InvalidateKeys(const CDbKeySet &changedKeys);
+    // execute the invalidated txs again, on top of the new tip
     void ReScanMemPoolTx();
     void Clear();
 
+    // evict the txs of the lowest fee per KB, with the txs of their sender after them, until the
+    // pool uses at most sizeLimit bytes of memory
+    void TrimToSize(size_t sizeLimit);
+    // the fee per KB a tx has to pay to get into the pool, it rises when txs are evicted and
+    // decays back as blocks make room
+    double GetMinFeePerKb(size_t sizeLimit);
+    size_t DynamicMemoryUsage() const;
+    uint64_t GetTotalTxSize() const;
+
     uint64_t Size();
     bool Exists(const uint256 txid);
+    // counts the txs added to and removed from the pool, to tell when a block template is outdated
+    uint64_t GetTransactionsUpdated() const;
     std::shared_ptr<CBaseTx> Lookup(const uint256 txid) const;
 
+    // the following must be called with cs held
+    const set<TxPriority>& GetPriorityIndex() const { return priorityIndex; }
+    const set<pair<int64_t, uint256>>& GetTimeIndex() const { return timeIndex; }
+    const map<string, map<uint64_t, uint256>>& GetSenderIndex() const { return senderIndex; }
+
 private:
     bool fSanityCheck; // Normally false, true if -checkmempool or -regtest
+
+    // packing order, the block producer walks it from the end
+    set<TxPriority> priorityIndex;
+    // (entry time, txid)
+    set<pair<int64_t, uint256>> timeIndex;
+    // chains of txids by txUid, in the order of their execution in the pool
+    map<string, map<uint64_t, uint256>> senderIndex;
+    // (eviction score, txid), the lowest is evicted first when the pool is full
+    set<pair<double, uint256>> evictionIndex;
+    // txUids whose chain changed, their aggregates and priorities are updated by UpdateSenderChains()
+    set<string> changedSenders;
+
+    uint64_t totalTxSize = 0;       // serialized size of the txs
+    uint64_t cachedInnerUsage = 0;  // sum of the DynamicMemoryUsage() of the entries
+    // minimum fee per KB raised by the evictions, see GetMinFeePerKb()
+    double rollingMinimumFeeRate = 0.0;
+    int64_t lastRollingFeeUpdate = 0;
+    bool blockSinceLastRollingFeeBump = false;
+
+    // sequence of the last execution in the pool
+    uint64_t nSequence = 0;
+    uint64_t nTransactionsUpdated = 0;
+    // keys written by the txs removed since the last invalidation
+    CDbKeySet removedKeys;
+    // height the txs were last executed for
+    int32_t nExecHeight = 0;
+
+    void AddToIndexes(const CTxMemPoolEntry &entry);
+    void RemoveFromIndexes(const CTxMemPoolEntry &entry);
+    map<uint256, CTxMemPoolEntry>::iterator EraseEntry(map<uint256, CTxMemPoolEntry>::iterator it);
+    void UpdateSenderChains();
+    bool ExecuteEntry(map<uint256, CTxMemPoolEntry>::iterator it, CValidationState &state);
 };
 
 